@@ -7,16 +7,410 @@
 
 #include <fstream>
 #include <string.h>
+#include <stdlib.h>
+#include <charconv>
+#include <thread>
+#include <atomic>
+#include <filesystem>
+#include <stdint.h>
+#include <ctype.h>
+#include <math.h>
+
+#if defined(_WIN32)
+#include <vector>
+#include <process.h>
+#define getpid  _getpid
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #include "BVH.h"
 
 using namespace  std;
 
 
+//
+//  BVHファイルの解析の補助クラス・関数
+//
+namespace
+{
+
+//
+//  ファイル全体の読み込み（POSIX ではメモリマップ、それ以外は一括読み込み）
+//
+class  BVHFileImage
+{
+  public:
+	const char *  data;
+	size_t  size;
+
+  private:
+#if defined(_WIN32)
+	vector< char >  buffer;
+#else
+	void *  mapped;
+#endif
+
+  public:
+	BVHFileImage()
+	{
+		data = NULL;
+		size = 0;
+#if !defined(_WIN32)
+		mapped = NULL;
+#endif
+	}
+	~BVHFileImage() { Close(); }
+
+	// ファイルのオープン
+	bool  Open( const char * file_name )
+	{
+		Close();
+#if defined(_WIN32)
+		ifstream  file( file_name, ios::in | ios::binary );
+		if ( !file.is_open() )
+			return  false;
+		file.seekg( 0, ios::end );
+		buffer.resize( (size_t) file.tellg() );
+		file.seekg( 0, ios::beg );
+		if ( !buffer.empty() )
+			file.read( &buffer.front(), buffer.size() );
+		data = buffer.empty() ? "" : &buffer.front();
+		size = buffer.size();
+		return  true;
+#else
+		int  fd = open( file_name, O_RDONLY );
+		if ( fd < 0 )
+			return  false;
+		struct stat  st;
+		if ( fstat( fd, &st ) != 0 )
+		{
+			close( fd );
+			return  false;
+		}
+		size = (size_t) st.st_size;
+		if ( size > 0 )
+		{
+			mapped = mmap( NULL, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+			if ( mapped == MAP_FAILED )
+			{
+				mapped = NULL;
+				size = 0;
+				close( fd );
+				return  false;
+			}
+			madvise( mapped, size, MADV_SEQUENTIAL );
+			data = (const char *) mapped;
+		}
+		else
+			data = "";
+		close( fd );
+		return  true;
+#endif
+	}
+
+	// ファイルのクローズ
+	void  Close()
+	{
+#if defined(_WIN32)
+		buffer.clear();
+#else
+		if ( mapped )
+			munmap( mapped, size );
+		mapped = NULL;
+#endif
+		data = NULL;
+		size = 0;
+	}
+};
+
+
+// 区切り文字の判定（旧実装の strtok の区切り文字 " :,\t" と行末の '\r'）
+inline bool  IsSeparator( char c )
+{
+	return  ( c == ' ' ) || ( c == ':' ) || ( c == ',' ) || ( c == '\t' ) || ( c == '\r' );
+}
+
+
+//
+//  行・トークンの切り出し（ファイルの内容をコピーせずに位置だけを返す）
+//
+class  BVHTokenizer
+{
+  public:
+	const char *  next_line;  // 次の行の先頭
+	const char *  end;        // ファイルの終端
+	const char *  cur;        // 現在の行の読み込み位置
+	const char *  line_end;   // 現在の行の終端
+
+  public:
+	BVHTokenizer( const char * begin, const char * e )
+	{
+		next_line = begin;
+		end = e;
+		cur = line_end = begin;
+	}
+
+	// ファイルの最後まで読んだかどうか
+	bool  IsEnd() const { return  next_line >= end; }
+
+	// 次の行へ進む（ファイルの最後なら false）
+	bool  NextLine()
+	{
+		if ( next_line >= end )
+			return  false;
+		cur = next_line;
+		const char *  nl = (const char *) memchr( cur, '\n', end - cur );
+		line_end = nl ? nl : end;
+		next_line = nl ? nl + 1 : end;
+		return  true;
+	}
+
+	// 現在の行から次のトークンを取得（無ければ false）
+	bool  NextToken( const char * & token, size_t & length )
+	{
+		while ( ( cur < line_end ) && IsSeparator( *cur ) )
+			cur ++;
+		if ( cur >= line_end )
+			return  false;
+		token = cur;
+		while ( ( cur < line_end ) && !IsSeparator( *cur ) )
+			cur ++;
+		length = cur - token;
+		return  true;
+	}
+
+	// 現在の行の残りを取得（前後の空白を除く）
+	string  RestOfLine()
+	{
+		while ( ( cur < line_end ) && ( ( *cur == ' ' ) || ( *cur == '\t' ) ) )
+			cur ++;
+		const char *  last = line_end;
+		while ( ( last > cur ) && ( ( last[ -1 ] == ' ' ) || ( last[ -1 ] == '\t' ) || ( last[ -1 ] == '\r' ) ) )
+			last --;
+		string  rest( cur, last );
+		cur = line_end;
+		return  rest;
+	}
+
+	// 現在の行から次の数値を取得（無ければ false、数値でなければ atof と同様に 0）
+	bool  NextNumber( double & value )
+	{
+		const char *  token;
+		size_t  length;
+		if ( !NextToken( token, length ) )
+			return  false;
+		value = ParseNumber( token, token + length );
+		return  true;
+	}
+
+	// 数値の変換（std::from_chars による、ロケールに依存しない変換）
+	static double  ParseNumber( const char * first, const char * last )
+	{
+		double  value = 0.0;
+		if ( ( first < last ) && ( *first == '+' ) )
+			first ++;
+		from_chars_result  r = from_chars( first, last, value );
+		if ( r.ec == errc::result_out_of_range )
+			return  strtod( string( first, last ).c_str(), NULL );
+		if ( r.ec != errc() )
+			return  0.0;
+		return  value;
+	}
+};
+
+
+// トークンと文字列の比較
+inline bool  TokenEquals( const char * token, size_t length, const char * str )
+{
+	return  ( strlen( str ) == length ) && ( memcmp( token, str, length ) == 0 );
+}
+
+
+//
+//  モーションデータの解析
+//  （１行が１フレーム、空行は読み飛ばす。並列に解析する場合は行の先頭で分割した範囲ごとに呼び出す）
+//
+
+// 範囲内のフレーム数（空行以外の行数）を数える
+int  CountMotionLines( const char * begin, const char * end )
+{
+	int  count = 0;
+	const char *  cur = begin;
+	while ( cur < end )
+	{
+		const char *  nl = (const char *) memchr( cur, '\n', end - cur );
+		const char *  line_end = nl ? nl : end;
+		while ( ( cur < line_end ) && IsSeparator( *cur ) )
+			cur ++;
+		if ( cur < line_end )
+			count ++;
+		cur = nl ? nl + 1 : end;
+	}
+	return  count;
+}
+
+// 範囲の先頭から指定フレーム数を解析（行やチャンネルの値が足りなければ false）
+bool  ParseMotionLines( const char * begin, const char * end, int num_frames, int num_channel, double * motion )
+{
+	BVHTokenizer  tok( begin, end );
+	const char *  token;
+	size_t  length;
+
+	for ( int i=0; i<num_frames; i++ )
+	{
+		do
+		{
+			if ( !tok.NextLine() )  return  false;
+		}
+		while ( !tok.NextToken( token, length ) );
+
+		double *  frame = motion + (size_t) i * num_channel;
+		frame[ 0 ] = BVHTokenizer::ParseNumber( token, token + length );
+		for ( int j=1; j<num_channel; j++ )
+		{
+			if ( !tok.NextNumber( frame[ j ] ) )
+				return  false;
+		}
+	}
+	return  true;
+}
+
+// 範囲の次の行の先頭を取得
+inline const char *  NextLineHead( const char * p, const char * end )
+{
+	const char *  nl = (const char *) memchr( p, '\n', end - p );
+	return  nl ? nl + 1 : end;
+}
+
+// 関数を [0, num) の各番号について別スレッドで実行
+template< class FUNC >
+void  RunParallel( int num, FUNC func )
+{
+	vector< thread >  workers;
+	workers.reserve( num - 1 );
+	for ( int k=1; k<num; k++ )
+		workers.push_back( thread( func, k ) );
+	func( 0 );
+	for ( size_t k=0; k<workers.size(); k++ )
+		workers[ k ].join();
+}
+
+// ロード時のモーションデータ解析のスレッド数の既定値（0 の場合はハードウェアのスレッド数、複数のスレッドから読み書きされる）
+static std::atomic< int >  num_load_threads( 0 );
+
+// １スレッドあたりの最小のデータ量（これより小さいファイルは分割しない）
+const size_t  min_chunk_bytes = 1024 * 1024;
+
+
+//
+//  セーブの補助関数
+//
+
+// 出力バッファをファイルに書き出すデータ量
+const size_t  save_buffer_bytes = 1024 * 1024;
+
+// 実数を固定小数点形式（小数点以下６桁、旧実装の ios::fixed + precision(6) と同じ書式）で追加
+inline void  AppendFixed( string & out, double value )
+{
+	char  buf[ 128 ];
+	to_chars_result  r = to_chars( buf, buf + sizeof( buf ), value, chars_format::fixed, 6 );
+	if ( r.ec != errc() )
+	{
+		out += "0.000000";
+		return;
+	}
+	out.append( buf, r.ptr - buf );
+}
+
+// 整数を追加
+inline void  AppendInt( string & out, long long value )
+{
+	char  buf[ 32 ];
+	to_chars_result  r = to_chars( buf, buf + sizeof( buf ), value );
+	out.append( buf, r.ptr - buf );
+}
+
+
+//
+//  バイナリキャッシュ（.bvhc）の補助関数
+//
+
+// ファイルの識別子と形式のバージョン（形式を変更したらバージョンを上げる）
+const char  cache_magic[ 4 ] = { 'B', 'V', 'H', 'C' };
+const uint32_t  cache_version = 1;
+
+// 元ファイルのサイズ・更新時刻を取得
+bool  GetSourceStamp( const char * file_name, uint64_t & size, int64_t & mtime )
+{
+	error_code  ec;
+	filesystem::path  path( file_name );
+	size = (uint64_t) filesystem::file_size( path, ec );
+	if ( ec )  return  false;
+	mtime = (int64_t) filesystem::last_write_time( path, ec ).time_since_epoch().count();
+	if ( ec )  return  false;
+	return  true;
+}
+
+// バイナリデータの書き出し（バッファに追加）
+class  CacheWriter
+{
+  public:
+	string  buffer;
+
+  public:
+	template< class T >
+	void  Put( const T & v ) { buffer.append( (const char *) &v, sizeof( T ) ); }
+	void  PutString( const string & s ) { Put( (uint32_t) s.size() );  buffer.append( s ); }
+};
+
+// バイナリデータの読み込み（範囲外の読み込みは失敗）
+class  CacheReader
+{
+  public:
+	const char *  cur;
+	const char *  end;
+
+  public:
+	CacheReader( const char * begin, size_t size ) { cur = begin;  end = begin + size; }
+
+	template< class T >
+	bool  Get( T & v )
+	{
+		if ( (size_t)( end - cur ) < sizeof( T ) )  return  false;
+		memcpy( &v, cur, sizeof( T ) );
+		cur += sizeof( T );
+		return  true;
+	}
+	bool  GetString( string & s )
+	{
+		uint32_t  n;
+		if ( !Get( n ) || ( (size_t)( end - cur ) < n ) )  return  false;
+		s.assign( cur, n );
+		cur += n;
+		return  true;
+	}
+	bool  GetArray( void * p, size_t bytes )
+	{
+		if ( (size_t)( end - cur ) < bytes )  return  false;
+		memcpy( p, cur, bytes );
+		cur += bytes;
+		return  true;
+	}
+};
+
+} // namespace
+
+
 // コントラクタ
 BVH::BVH()
 {
 	motion = NULL;
+	stream = NULL;
+	save_stream = NULL;
 	Clear();
 }
 
@@ -24,6 +418,8 @@ BVH::BVH()
 BVH::BVH( const char * bvh_file_name )
 {
 	motion = NULL;
+	stream = NULL;
+	save_stream = NULL;
 	Clear();
 
 	Load( bvh_file_name );
@@ -46,6 +442,8 @@ void  BVH::Clear()
 		delete  joints[ i ];
 	if ( motion != NULL )
 		delete  motion;
+	CloseStream();
+	EndSave();
 
 	is_load_success = false;
 	
@@ -137,9 +535,415 @@ void  BVH::SetMotion( int n_frame, double inter, const double * mo )
 
 
 //
-//  BVHファイルのロード
+//  ファイル名・動作名の設定
+//
+void  BVH::SetFileName( const char * bvh_file_name )
+{
+	file_name = bvh_file_name;
+	const char *  mn_first = bvh_file_name;
+	const char *  mn_last = bvh_file_name + strlen( bvh_file_name );
+	if ( strrchr( bvh_file_name, '\\' ) != NULL )
+		mn_first = strrchr( bvh_file_name, '\\' ) + 1;
+	else if ( strrchr( bvh_file_name, '/' ) != NULL )
+		mn_first = strrchr( bvh_file_name, '/' ) + 1;
+	if ( strrchr( bvh_file_name, '.' ) != NULL )
+		mn_last = strrchr( bvh_file_name, '.' );
+	if ( mn_last < mn_first )
+		mn_last = bvh_file_name + strlen( bvh_file_name );
+	motion_name.assign( mn_first, mn_last );
+}
+
+
+//
+//  BVHファイルのロード（ファイルをメモリにマップして解析）
+//
+void  BVH::Load( const char * bvh_file_name, int num_threads )
+{
+	BVHFileImage  image;
+	const char *  motion_begin;
+	int       i, j;
+
+	// 初期化
+	Clear();
+
+	// ファイルの情報（ファイル名・動作名）の設定
+	SetFileName( bvh_file_name );
+
+	// ファイルのオープン
+	if ( !image.Open( bvh_file_name ) )  return; // ファイルが開けなかったら終了
+
+	// 階層情報・フレーム数・フレーム間隔の読み込み
+	if ( !LoadHeader( image.data, image.data + image.size, motion_begin ) )  return;
+
+	motion = new double[ (size_t) num_frame * num_channel ];
+
+	// モーションデータの読み込み（行の長さの制限なし、空行は読み飛ばす）
+	const char *  motion_end = image.data + image.size;
+
+	// 分割数の決定（データ量が少なければ分割しない）
+	if ( num_threads <= 0 )
+		num_threads = num_load_threads.load();
+	if ( num_threads <= 0 )
+		num_threads = (int) thread::hardware_concurrency();
+	size_t  max_chunks = ( motion_end - motion_begin ) / min_chunk_bytes;
+	if ( (size_t) num_threads > max_chunks )
+		num_threads = (int) max_chunks;
+	if ( num_threads > num_frame )
+		num_threads = num_frame;
+
+	// １スレッドで先頭から順に解析
+	if ( num_threads <= 1 )
+	{
+		if ( !ParseMotionLines( motion_begin, motion_end, num_frame, num_channel, motion ) )
+			return;
+	}
+	// 行の先頭で範囲を分割して並列に解析
+	//（各範囲のフレーム数を数えてから開始フレーム番号を決めるため、結果は１スレッドの場合と同一）
+	else
+	{
+		vector< const char * >  chunk_begin( num_threads + 1 );
+		vector< int >  chunk_lines( num_threads ), chunk_frame( num_threads + 1 );
+		vector< char >  chunk_ok( num_threads );
+		size_t  motion_bytes = motion_end - motion_begin;
+		chunk_begin[ 0 ] = motion_begin;
+		chunk_begin[ num_threads ] = motion_end;
+		for ( i=1; i<num_threads; i++ )
+		{
+			const char *  p = motion_begin + motion_bytes * i / num_threads;
+			chunk_begin[ i ] = ( p[ -1 ] == '\n' ) ? p : NextLineHead( p, motion_end );
+			if ( chunk_begin[ i ] < chunk_begin[ i - 1 ] )
+				chunk_begin[ i ] = chunk_begin[ i - 1 ];
+		}
+
+		// 各範囲のフレーム数
+		RunParallel( num_threads, [&]( int k ) {
+			chunk_lines[ k ] = CountMotionLines( chunk_begin[ k ], chunk_begin[ k + 1 ] );
+		} );
+
+		// 各範囲の開始フレーム番号（ファイル中の余分な行は読み込まない）
+		chunk_frame[ 0 ] = 0;
+		for ( i=0; i<num_threads; i++ )
+		{
+			j = chunk_frame[ i ] + chunk_lines[ i ];
+			chunk_frame[ i + 1 ] = ( j < num_frame ) ? j : num_frame;
+		}
+		if ( chunk_frame[ num_threads ] < num_frame )  return;
+
+		// 各範囲のモーションデータの解析
+		RunParallel( num_threads, [&]( int k ) {
+			int  n = chunk_frame[ k + 1 ] - chunk_frame[ k ];
+			chunk_ok[ k ] = ParseMotionLines( chunk_begin[ k ], chunk_begin[ k + 1 ], n, num_channel, 
+				motion + (size_t) chunk_frame[ k ] * num_channel );
+		} );
+		for ( i=0; i<num_threads; i++ )
+			if ( !chunk_ok[ i ] )  return;
+	}
+
+	// ロードの成功
+	is_load_success = true;
+}
+
+
+//
+//  階層情報・フレーム数・フレーム間隔の読み込み（Load・OpenStream の共通処理）
+//  （モーションデータの開始位置を motion_begin に返す）
+//
+bool  BVH::LoadHeader( const char * begin, const char * end, const char * & motion_begin )
+{
+	const char *  token;
+	size_t    length;
+	vector< Joint * >   joint_stack;
+	Joint *   joint = NULL;
+	Joint *   new_joint = NULL;
+	bool      is_site = false;
+	double    x, y ,z;
+	double    value;
+	bool      found;
+	int       i;
+	BVHTokenizer  tok( begin, end );
+
+	// 階層情報の読み込み
+	while ( tok.NextLine() )
+	{
+		// 先頭の単語を取得（空行の場合は次の行へ）
+		if ( !tok.NextToken( token, length ) )  continue;
+
+		// 関節ブロックの開始
+		if ( TokenEquals( token, length, "{" ) )
+		{
+			// 現在の関節をスタックに積む
+			joint_stack.push_back( joint );
+			joint = new_joint;
+			continue;
+		}
+		// 関節ブロックの終了
+		if ( TokenEquals( token, length, "}" ) )
+		{
+			// 現在の関節をスタックから取り出す
+			if ( joint_stack.empty() )  return  false;
+			joint = joint_stack.back();
+			joint_stack.pop_back();
+			is_site = false;
+			continue;
+		}
+
+		// 関節情報の開始
+		if ( TokenEquals( token, length, "ROOT" ) || TokenEquals( token, length, "JOINT" ) )
+		{
+			// 関節データの作成
+			new_joint = new Joint();
+			new_joint->index = joints.size();
+			new_joint->parent = joint;
+			new_joint->has_site = false;
+			new_joint->offset[0] = 0.0;  new_joint->offset[1] = 0.0;  new_joint->offset[2] = 0.0;
+			new_joint->site[0] = 0.0;  new_joint->site[1] = 0.0;  new_joint->site[2] = 0.0;
+			joints.push_back( new_joint );
+			if ( joint )
+				joint->children.push_back( new_joint );
+
+			// 関節名の読み込み
+			new_joint->name = tok.RestOfLine();
+
+			// インデックスへ追加
+			joint_index[ new_joint->name ] = new_joint;
+			continue;
+		}
+
+		// 末端情報の開始
+		if ( TokenEquals( token, length, "End" ) )
+		{
+			new_joint = joint;
+			is_site = true;
+			continue;
+		}
+
+		// 関節のオフセット or 末端位置の情報
+		if ( TokenEquals( token, length, "OFFSET" ) )
+		{
+			if ( !joint )  return  false;
+
+			// 座標値を読み込み
+			x = tok.NextNumber( value ) ? value : 0.0;
+			y = tok.NextNumber( value ) ? value : 0.0;
+			z = tok.NextNumber( value ) ? value : 0.0;
+
+			// 関節のオフセットに座標値を設定
+			if ( is_site )
+			{
+				joint->has_site = true;
+				joint->site[0] = x;
+				joint->site[1] = y;
+				joint->site[2] = z;
+			}
+			else
+			// 末端位置に座標値を設定
+			{
+				joint->offset[0] = x;
+				joint->offset[1] = y;
+				joint->offset[2] = z;
+			}
+			continue;
+		}
+
+		// 関節のチャンネル情報
+		if ( TokenEquals( token, length, "CHANNELS" ) )
+		{
+			if ( !joint )  return  false;
+
+			// チャンネル数を読み込み
+			joint->channels.resize( tok.NextNumber( value ) ? (int) value : 0 );
+
+			// チャンネル情報を読み込み
+			for ( i=0; i<joint->channels.size(); i++ )
+			{
+				// チャンネルの作成
+				Channel *  channel = new Channel();
+				channel->joint = joint;
+				channel->index = channels.size();
+				channels.push_back( channel );
+				joint->channels[ i ] = channel;
+
+				// チャンネルの種類の判定
+				if ( !tok.NextToken( token, length ) )
+					return  false;
+				if ( TokenEquals( token, length, "Xrotation" ) )
+					channel->type = X_ROTATION;
+				else if ( TokenEquals( token, length, "Yrotation" ) )
+					channel->type = Y_ROTATION;
+				else if ( TokenEquals( token, length, "Zrotation" ) )
+					channel->type = Z_ROTATION;
+				else if ( TokenEquals( token, length, "Xposition" ) )
+					channel->type = X_POSITION;
+				else if ( TokenEquals( token, length, "Yposition" ) )
+					channel->type = Y_POSITION;
+				else if ( TokenEquals( token, length, "Zposition" ) )
+					channel->type = Z_POSITION;
+			}
+			continue;
+		}
+
+		// Motionデータのセクションへ移る
+		if ( TokenEquals( token, length, "MOTION" ) )
+			break;
+	}
+
+	// モーション情報の読み込み（フレーム数）
+	found = false;
+	while ( !found && tok.NextLine() )
+		found = tok.NextToken( token, length ) && TokenEquals( token, length, "Frames" );
+	if ( !found || !tok.NextNumber( value ) )  return  false;
+	num_frame = (int) value;
+
+	// モーション情報の読み込み（フレーム間隔）
+	found = false;
+	while ( !found && tok.NextLine() )
+		found = tok.NextToken( token, length ) && TokenEquals( token, length, "Frame" ) &&
+		        tok.NextToken( token, length ) && TokenEquals( token, length, "Time" );
+	if ( !found || !tok.NextNumber( value ) )  return  false;
+	interval = value;
+	num_channel = channels.size();
+
+	// モーションデータの開始位置
+	motion_begin = tok.next_line;
+	return  true;
+}
+
+
+//
+//  ストリーミング読み込みの状態
 //
-void  BVH::Load( const char * bvh_file_name )
+struct  BVH::StreamState
+{
+	// 入力ファイル
+	ifstream  file;
+
+	// 入力バッファ
+	vector< char >  buffer;
+
+	// 読み込み中の行（同じ領域を再利用）
+	string  line;
+
+	// 読み込んだフレーム数
+	int  frame_count;
+};
+
+
+//
+//  ストリーミング読み込みの開始
+//  （階層情報・フレーム数・フレーム間隔のみを読み込み、モーションデータは ReadFrame で１フレームずつ取得）
+//
+bool  BVH::OpenStream( const char * bvh_file_name )
+{
+	const char *  motion_begin;
+	string  header;
+
+	// 初期化
+	Clear();
+
+	// ファイルの情報（ファイル名・動作名）の設定
+	SetFileName( bvh_file_name );
+
+	// ファイルのオープン（入力バッファは固定サイズ）
+	stream = new StreamState();
+	stream->buffer.resize( 1024 * 1024 );
+	stream->file.rdbuf()->pubsetbuf( &stream->buffer.front(), stream->buffer.size() );
+	stream->file.open( bvh_file_name, ios::in | ios::binary );
+	stream->frame_count = 0;
+	if ( !stream->file.is_open() )
+	{
+		CloseStream();
+		return  false;
+	}
+
+	// "Frame Time" の行までを読み込み
+	while ( getline( stream->file, stream->line ) )
+	{
+		header += stream->line;
+		header += '\n';
+
+		const char *  p = stream->line.c_str();
+		while ( IsSeparator( *p ) )
+			p ++;
+		if ( strncmp( p, "Frame", 5 ) == 0 )
+		{
+			p += 5;
+			if ( !IsSeparator( *p ) )
+				continue;
+			while ( IsSeparator( *p ) )
+				p ++;
+			if ( strncmp( p, "Time", 4 ) == 0 )
+				break;
+		}
+	}
+
+	// 階層情報・フレーム数・フレーム間隔の解析
+	if ( !LoadHeader( header.data(), header.data() + header.size(), motion_begin ) )
+	{
+		CloseStream();
+		return  false;
+	}
+
+	// ロードの成功（モーションデータは持たない）
+	is_load_success = true;
+	return  true;
+}
+
+
+//
+//  ストリーミング読み込みで次のフレームのモーションデータを取得（[チャンネル番号] の配列に格納）
+//  （全フレームを読み込んだ後や、値が足りない行があれば false）
+//
+bool  BVH::ReadFrame( double * frame_data )
+{
+	if ( !stream || ( stream->frame_count >= num_frame ) )
+		return  false;
+
+	// 空行を読み飛ばして１行を解析
+	while ( getline( stream->file, stream->line ) )
+	{
+		const char *  begin = stream->line.data();
+		const char *  end = begin + stream->line.size();
+		if ( CountMotionLines( begin, end ) == 0 )
+			continue;
+		if ( !ParseMotionLines( begin, end, 1, num_channel, frame_data ) )
+			break;
+		stream->frame_count ++;
+		return  true;
+	}
+	return  false;
+}
+
+
+//
+//  ストリーミング読み込みの終了
+//
+void  BVH::CloseStream()
+{
+	if ( stream )
+		delete  stream;
+	stream = NULL;
+}
+
+
+
+//
+//  ロード時のモーションデータ解析のスレッド数の取得・設定（0 の場合はハードウェアのスレッド数）
+//
+int  BVH::GetNumLoadThreads()
+{
+	return  num_load_threads;
+}
+
+void  BVH::SetNumLoadThreads( int n )
+{
+	num_load_threads = ( n > 0 ) ? n : 0;
+}
+
+
+//
+//  BVHファイルのロード（旧実装：ifstream + strtok + atof、1行 4KB まで。比較・検証用）
+//
+void  BVH::LoadByStream( const char * bvh_file_name )
 {
 	#define  BUFFER_LENGTH  1024*4
 
@@ -158,18 +962,7 @@ void  BVH::Load( const char * bvh_file_name )
 	Clear();
 
 	// ファイルの情報（ファイル名・動作名）の設定
-	file_name = bvh_file_name;
-	const char *  mn_first = bvh_file_name;
-	const char *  mn_last = bvh_file_name + strlen( bvh_file_name );
-	if ( strrchr( bvh_file_name, '\\' ) != NULL )
-		mn_first = strrchr( bvh_file_name, '\\' ) + 1;
-	else if ( strrchr( bvh_file_name, '/' ) != NULL )
-		mn_first = strrchr( bvh_file_name, '/' ) + 1;
-	if ( strrchr( bvh_file_name, '.' ) != NULL )
-		mn_last = strrchr( bvh_file_name, '.' );
-	if ( mn_last < mn_first )
-		mn_last = bvh_file_name + strlen( bvh_file_name );
-	motion_name.assign( mn_first, mn_last );
+	SetFileName( bvh_file_name );
 
 	// ファイルのオープン
 	file.open( bvh_file_name, ios::in );
@@ -368,54 +1161,132 @@ bvh_error:
 
 
 //
-//  セーブ
+//  セーブ（モーションデータ全体をストリーミングセーブで出力）
 //
 void  BVH::Save( const char * bvh_file_name )
 {
-	int  i, j;
+	if ( !BeginSave( bvh_file_name, num_frame, interval ) )
+		return;
+	for ( int i=0; i<num_frame; i++ )
+		SaveFrame( motion + (size_t) i * num_channel );
+	EndSave();
+}
+
+
+//
+//  ストリーミングセーブの状態
+//
+struct  BVH::SaveState
+{
+	// 出力ファイル
 	ofstream  file;
 
+	// 出力バッファ（一定量たまったらまとめて書き出す）
+	string  buffer;
+
 	// モーションデータを出力するチャンネルの順番
-	vector< int >   channel_order;
+	vector< int >  channel_order;
 
-	// ファイルのオープン
-	file.open( bvh_file_name, ios::out );
-	if ( file.is_open() == 0 )  return; // ファイルが開けなかったら終了
+	// 出力するフレーム数・出力したフレーム数
+	int  num_frames;
+	int  frame_count;
 
-	// 出力フォーマットの設定
-	file.flags( ios::showpoint | ios::fixed );
-	file.precision( 6 );
-//	int  value_widht = 11;
+	// 書き出しに失敗したかどうか
+	bool  failed;
 
-	// 階層構造の出力
-	file << "HIERARCHY" << endl;
-	OutputHierarchy( file, joints[ 0 ], 0, channel_order );
+	// バッファの書き出し
+	void  Flush()
+	{
+		if ( !buffer.empty() )
+			file.write( buffer.data(), buffer.size() );
+		if ( !file )
+			failed = true;
+		buffer.clear();
+	}
+};
 
-	// モーションデータの出力
-	file << "MOTION" << endl;
-	file << "Frames: " << num_frame << endl;
-	file << "Frame Time: " << interval << endl;
-	for ( i=0; i<num_frame; i++ )
+
+//
+//  ストリーミングセーブの開始（このBVHの階層構造とフレーム数・フレーム間隔を出力）
+//  （モーションデータは SaveFrame で１フレームずつ [チャンネル番号] の配列で渡し、EndSave で終了する）
+//
+bool  BVH::BeginSave( const char * bvh_file_name, int n_frame, double inter )
+{
+	EndSave();
+	if ( joints.empty() )
+		return  false;
+
+	// ファイルのオープン
+	save_stream = new SaveState();
+	save_stream->file.open( bvh_file_name, ios::out | ios::trunc );
+	if ( !save_stream->file.is_open() )
 	{
-		for ( j=0; j<channel_order.size(); j++ )
-		{
-			// 数値を固定幅で出力する場合は文字幅を設定
-//			if ( value_widht > 0 )
-//				file.width( value_widht );
+		delete  save_stream;
+		save_stream = NULL;
+		return  false;
+	}
+	save_stream->buffer.reserve( save_buffer_bytes + 64 * 1024 );
+	save_stream->num_frames = n_frame;
+	save_stream->frame_count = 0;
+	save_stream->failed = false;
 
-			// モーションデータを出力
-			file << GetMotion( i, channel_order[ j ] );
+	// 階層構造の出力
+	string &  out = save_stream->buffer;
+	out += "HIERARCHY\n";
+	OutputHierarchy( out, joints[ 0 ], 0, save_stream->channel_order );
+
+	// モーションデータの情報の出力
+	out += "MOTION\n";
+	out += "Frames: ";
+	AppendInt( out, n_frame );
+	out += "\nFrame Time: ";
+	AppendFixed( out, inter );
+	out += '\n';
+	return  true;
+}
 
-			// 空白か行末記号を出力
-			if ( j != channel_order.size() - 1 )
-				file << "  ";
-			else
-				file << endl;
-		}
+
+//
+//  ストリーミングセーブで１フレームのモーションデータを出力
+//
+bool  BVH::SaveFrame( const double * frame_data )
+{
+	if ( !save_stream || save_stream->failed )
+		return  false;
+
+	// 数値を固定小数点形式（小数点以下６桁）で出力、値の間は空白２つ
+	string &  out = save_stream->buffer;
+	const vector< int > &  order = save_stream->channel_order;
+	for ( int j=0; j<order.size(); j++ )
+	{
+		if ( j != 0 )
+			out += "  ";
+		AppendFixed( out, frame_data[ order[ j ] ] );
 	}
+	out += '\n';
+	save_stream->frame_count ++;
 
-	// ファイルのクローズ
-	file.close();
+	// バッファが一定量を超えたら書き出し
+	if ( out.size() >= save_buffer_bytes )
+		save_stream->Flush();
+	return  !save_stream->failed;
+}
+
+
+//
+//  ストリーミングセーブの終了（出力したフレーム数が BeginSave で指定した数と異なる場合や書き出しに失敗した場合は false）
+//
+bool  BVH::EndSave()
+{
+	if ( !save_stream )
+		return  false;
+
+	save_stream->Flush();
+	save_stream->file.close();
+	bool  success = !save_stream->failed && ( save_stream->frame_count == save_stream->num_frames );
+	delete  save_stream;
+	save_stream = NULL;
+	return  success;
 }
 
 
@@ -425,7 +1296,7 @@ void  BVH::Save( const char * bvh_file_name )
 
 // 階層構造を再帰的に出力
 void  BVH::OutputHierarchy( 
-	ofstream & file, const Joint * joint, int indent_level, vector< int > & channel_list )
+	string & out, const Joint * joint, int indent_level, vector< int > & channel_list )
 {
 	int  i;
 	string  indent, space;
@@ -437,45 +1308,47 @@ void  BVH::OutputHierarchy(
 
 	// 関節名（ルート名）の出力
 	if ( joint->parent )
-		file << indent << "JOINT" << space << joint->name << endl;
+		out += indent + "JOINT" + space + joint->name + "\n";
 	else
-		file << indent << "ROOT" << space << joint->name << endl;
+		out += indent + "ROOT" + space + joint->name + "\n";
 
 	// 関節ブロックの開始
-	file << indent << "{" << endl;
+	out += indent + "{\n";
 	indent_level ++;
 	indent.assign( indent_level * 4, ' ' );
 
 	// オフセット位置の出力
-	file << indent << "OFFSET" << space;
-	file << joint->offset[0] << space;
-	file << joint->offset[1] << space;
-	file << joint->offset[2] << endl;
+	out += indent + "OFFSET" + space;
+	AppendFixed( out, joint->offset[0] );  out += space;
+	AppendFixed( out, joint->offset[1] );  out += space;
+	AppendFixed( out, joint->offset[2] );  out += "\n";
 
 	// チャンネル情報の出力
-	file << indent << "CHANNELS"  << space << joint->channels.size() << space;
+	out += indent + "CHANNELS" + space;
+	AppendInt( out, joint->channels.size() );
+	out += space;
 	for ( i=0; i<joint->channels.size(); i++ )
 	{
 		channel = joint->channels[ i ];
 		switch ( channel->type )
 		{
 		  case X_ROTATION:
-			file << "Xrotation";  break;
+			out += "Xrotation";  break;
 		  case Y_ROTATION:
-			file << "Yrotation";  break;
+			out += "Yrotation";  break;
 		  case Z_ROTATION:
-			file << "Zrotation";  break;
+			out += "Zrotation";  break;
 		  case X_POSITION:
-			file << "Xposition";  break;
+			out += "Xposition";  break;
 		  case Y_POSITION:
-			file << "Yposition";  break;
+			out += "Yposition";  break;
 		  case Z_POSITION:
-			file << "Zposition";  break;
+			out += "Zposition";  break;
 		}
 		if ( i != joint->channels.size() - 1 )
-			file << space;
+			out += space;
 		else
-			file << endl;
+			out += "\n";
 
 		// 出力チャンネルのリストに追加
 		channel_list.push_back( channel->index );
@@ -484,34 +1357,263 @@ void  BVH::OutputHierarchy(
 	// 末端位置の情報を出力
 	if ( joint->has_site )
 	{
-		file << indent << "End Site" << endl;
-		file << indent << "{" << endl;
+		out += indent + "End Site\n";
+		out += indent + "{\n";
 
 		indent_level ++;
 		indent.assign( indent_level * 4, ' ' );
 
 		// オフセット位置の出力
-		file << indent << "OFFSET" << space;
-		file << joint->site[0] << space;
-		file << joint->site[1] << space;
-		file << joint->site[2] << endl;
+		out += indent + "OFFSET" + space;
+		AppendFixed( out, joint->site[0] );  out += space;
+		AppendFixed( out, joint->site[1] );  out += space;
+		AppendFixed( out, joint->site[2] );  out += "\n";
 
 		indent_level --;
 		indent.assign( indent_level * 4, ' ' );
 
-		file << indent << "}" << endl;
+		out += indent + "}\n";
 	}
 
 	// 全ての子関節を再帰的に出力
 	for ( i=0; i<joint->children.size(); i++ )
 	{
-		OutputHierarchy( file, joint->children[ i ], indent_level, channel_list );
+		OutputHierarchy( out, joint->children[ i ], indent_level, channel_list );
 	}
 
 	// 関節ブロックの終了
 	indent_level --;
 	indent.assign( indent_level * 4, ' ' );
-	file << indent << "}" << endl;
+	out += indent + "}\n";
+}
+
+//
+//  階層構造が同じかどうかを判定（オフセット・末端位置は offset_tolerance までの差を許容）
+//
+bool  BVH::HasSameHierarchy( const BVH & bvh, double offset_tolerance ) const
+{
+	int  i, j;
+
+	if ( ( joints.size() != bvh.joints.size() ) || ( channels.size() != bvh.channels.size() ) )
+		return  false;
+
+	for ( i=0; i<joints.size(); i++ )
+	{
+		const Joint *  a = joints[ i ];
+		const Joint *  b = bvh.joints[ i ];
+		if ( a->name != b->name )
+			return  false;
+		if ( ( a->parent ? a->parent->index : -1 ) != ( b->parent ? b->parent->index : -1 ) )
+			return  false;
+		if ( ( a->has_site != b->has_site ) || ( a->channels.size() != b->channels.size() ) )
+			return  false;
+		for ( j=0; j<3; j++ )
+		{
+			if ( fabs( a->offset[ j ] - b->offset[ j ] ) > offset_tolerance )
+				return  false;
+			if ( a->has_site && ( fabs( a->site[ j ] - b->site[ j ] ) > offset_tolerance ) )
+				return  false;
+		}
+		for ( j=0; j<a->channels.size(); j++ )
+		{
+			if ( ( a->channels[ j ]->index != b->channels[ j ]->index ) || ( a->channels[ j ]->type != b->channels[ j ]->type ) )
+				return  false;
+		}
+	}
+	return  true;
+}
+
+
+//
+//  バイナリキャッシュ（.bvhc）のファイル名を取得（.bvh → .bvhc）
+//
+string  BVH::GetCacheFileName( const char * bvh_file_name )
+{
+	string  name = bvh_file_name;
+	string  ext = ( name.size() >= 4 ) ? name.substr( name.size() - 4 ) : "";
+	for ( int i=0; i<ext.size(); i++ )
+		ext[ i ] = tolower( ext[ i ] );
+	if ( ext == ".bvh" )
+		return  name + "c";
+	return  name + ".bvhc";
+}
+
+
+//
+//  バイナリキャッシュ（.bvhc）の書き出し
+//  （キャッシュには元ファイルのパス・サイズ・更新時刻と、階層構造・チャンネル構成・float のモーションデータを保存）
+//
+bool  BVH::SaveCache( const char * cache_file_name, const char * bvh_file_name ) const
+{
+	int  i, j;
+	uint64_t  src_size;
+	int64_t  src_mtime;
+	CacheWriter  out;
+
+	if ( !is_load_success || !motion || !GetSourceStamp( bvh_file_name, src_size, src_mtime ) )
+		return  false;
+
+	// ヘッダ（元ファイルの情報）
+	out.buffer.append( cache_magic, 4 );
+	out.Put( cache_version );
+	out.PutString( bvh_file_name );
+	out.Put( src_size );
+	out.Put( src_mtime );
+	out.PutString( motion_name );
+
+	// 関節の階層構造
+	out.Put( (int32_t) joints.size() );
+	for ( i=0; i<joints.size(); i++ )
+	{
+		const Joint *  joint = joints[ i ];
+		out.PutString( joint->name );
+		out.Put( (int32_t)( joint->parent ? joint->parent->index : -1 ) );
+		for ( j=0; j<3; j++ )
+			out.Put( joint->offset[ j ] );
+		out.Put( (uint8_t) joint->has_site );
+		for ( j=0; j<3; j++ )
+			out.Put( joint->site[ j ] );
+	}
+
+	// チャンネル構成（チャンネル番号順、各関節のチャンネルはファイル中の順番に並ぶ）
+	out.Put( (int32_t) channels.size() );
+	for ( i=0; i<channels.size(); i++ )
+	{
+		out.Put( (int32_t) channels[ i ]->joint->index );
+		out.Put( (int32_t) channels[ i ]->type );
+	}
+
+	// モーションデータ（[フレーム番号][チャンネル番号] の float 配列）
+	out.Put( (int32_t) num_frame );
+	out.Put( interval );
+	size_t  num_values = (size_t) num_frame * num_channel;
+	size_t  offset = out.buffer.size();
+	out.buffer.resize( offset + num_values * sizeof( float ) );
+	float *  values = (float *) &out.buffer[ offset ];
+	for ( size_t k=0; k<num_values; k++ )
+		values[ k ] = (float) motion[ k ];
+
+	// 一時ファイルに書き出してから置き換え（書き出し中のキャッシュを他のプロセスが読まないように）
+	// 一時ファイル名はプロセス番号・プロセス内の通し番号で区別（同じキャッシュを複数のプロセス・スレッドが同時に作成しても混ざらないように）
+	static atomic< unsigned >  num_tmp_files( 0 );
+	string  tmp_file_name = string( cache_file_name ) + "." + to_string( (long) getpid() ) + "." + to_string( num_tmp_files.fetch_add( 1 ) ) + ".tmp";
+	ofstream  file( tmp_file_name.c_str(), ios::out | ios::binary | ios::trunc );
+	if ( !file.is_open() )  return  false;
+	file.write( out.buffer.data(), out.buffer.size() );
+	file.close();
+	if ( !file )
+	{
+		remove( tmp_file_name.c_str() );
+		return  false;
+	}
+	error_code  ec;
+	filesystem::rename( tmp_file_name, cache_file_name, ec );
+	if ( ec )
+	{
+		remove( tmp_file_name.c_str() );
+		return  false;
+	}
+	return  true;
+}
+
+
+//
+//  バイナリキャッシュ（.bvhc）の読み込み
+//  （元ファイルのパス・サイズ・更新時刻が一致しなければ読み込まずに false を返す）
+//
+bool  BVH::LoadCache( const char * cache_file_name, const char * bvh_file_name )
+{
+	int  i, j;
+	BVHFileImage  image;
+	uint32_t  version;
+	string  src_name;
+	uint64_t  src_size, cur_size;
+	int64_t  src_mtime, cur_mtime;
+	int32_t  n, index, type;
+	uint8_t  has_site;
+
+	// 初期化
+	Clear();
+
+	// 元ファイルの確認
+	if ( !GetSourceStamp( bvh_file_name, cur_size, cur_mtime ) )  return  false;
+	if ( !image.Open( cache_file_name ) )  return  false;
+	CacheReader  in( image.data, image.size );
+
+	// ヘッダ（元ファイルの情報）
+	if ( ( image.size < 4 ) || ( memcmp( image.data, cache_magic, 4 ) != 0 ) )  return  false;
+	in.cur += 4;
+	if ( !in.Get( version ) || ( version != cache_version ) )  return  false;
+	if ( !in.GetString( src_name ) || ( src_name != bvh_file_name ) )  return  false;
+	if ( !in.Get( src_size ) || !in.Get( src_mtime ) || ( src_size != cur_size ) || ( src_mtime != cur_mtime ) )
+		return  false;
+
+	// ファイルの情報（ファイル名・動作名）の設定
+	file_name = bvh_file_name;
+	if ( !in.GetString( motion_name ) )  goto cache_error;
+
+	// 関節の階層構造
+	if ( !in.Get( n ) || ( n <= 0 ) )  goto cache_error;
+	for ( i=0; i<n; i++ )
+	{
+		Joint *  joint = new Joint();
+		joint->index = i;
+		joint->parent = NULL;
+		joints.push_back( joint );
+		if ( !in.GetString( joint->name ) || !in.Get( index ) || ( index >= i ) )  goto cache_error;
+		if ( index >= 0 )
+		{
+			joint->parent = joints[ index ];
+			joint->parent->children.push_back( joint );
+		}
+		for ( j=0; j<3; j++ )
+			if ( !in.Get( joint->offset[ j ] ) )  goto cache_error;
+		if ( !in.Get( has_site ) )  goto cache_error;
+		joint->has_site = ( has_site != 0 );
+		for ( j=0; j<3; j++ )
+			if ( !in.Get( joint->site[ j ] ) )  goto cache_error;
+		joint_index[ joint->name ] = joint;
+	}
+
+	// チャンネル構成
+	if ( !in.Get( n ) || ( n < 0 ) )  goto cache_error;
+	for ( i=0; i<n; i++ )
+	{
+		Channel *  channel = new Channel();
+		channel->index = i;
+		channels.push_back( channel );
+		if ( !in.Get( index ) || !in.Get( type ) )  goto cache_error;
+		if ( ( index < 0 ) || ( index >= joints.size() ) || ( type < X_ROTATION ) || ( type > Z_POSITION ) )
+			goto cache_error;
+		channel->joint = joints[ index ];
+		channel->type = (ChannelEnum) type;
+		channel->joint->channels.push_back( channel );
+	}
+	num_channel = channels.size();
+
+	// モーションデータ
+	if ( !in.Get( n ) || ( n < 0 ) || !in.Get( interval ) )  goto cache_error;
+	num_frame = n;
+	{
+		size_t  num_values = (size_t) num_frame * num_channel;
+		if ( (size_t)( in.end - in.cur ) != num_values * sizeof( float ) )  goto cache_error;
+		motion = new double[ num_values ];
+		const float *  values = (const float *) in.cur;
+		for ( size_t k=0; k<num_values; k++ )
+		{
+			float  v;
+			memcpy( &v, values + k, sizeof( float ) );
+			motion[ k ] = v;
+		}
+	}
+
+	// ロードの成功
+	is_load_success = true;
+	return  true;
+
+cache_error:
+	Clear();
+	return  false;
 }
 
 
@@ -91,6 +91,14 @@ class  BVH
 	double  interval;    // フレーム間の時間間隔
 	double *  motion;      // [フレーム番号][チャンネル番号]
 
+	/*  ストリーミング読み込みの情報  */
+	struct  StreamState;
+	StreamState *  stream;  // 読み込み中のファイル（ストリーミング読み込み中以外は NULL）
+
+	/*  ストリーミングセーブの情報  */
+	struct  SaveState;
+	SaveState *  save_stream;  // 書き出し中のファイル（ストリーミングセーブ中以外は NULL）
+
 
   public:
 	// コンストラクタ・デストラクタ
@@ -113,12 +121,46 @@ class  BVH
 	// 動作データの設定
 	void  SetMotion( int n_frame, double interval, const double * mo = NULL );
 
-	// BVHファイルのロード
-	void  Load( const char * bvh_file_name );
+	// BVHファイルのロード（ファイルをメモリにマップして解析）
+	//（num_threads はモーションデータ解析のスレッド数、0 の場合は SetNumLoadThreads の設定）
+	void  Load( const char * bvh_file_name, int num_threads = 0 );
+
+	// BVHファイルのロード（旧実装：ifstream + strtok + atof、1行 4KB まで。比較・検証用）
+	void  LoadByStream( const char * bvh_file_name );
 
-	// BVHファイルのセーブ
+	// ストリーミング読み込み（階層情報・フレーム数・フレーム間隔のみを読み込み、モーションデータは持たない）
+	//（ReadFrame で先頭から１フレームずつ [チャンネル番号] の配列に取得、メモリ使用量はフレーム数によらず一定）
+	bool  OpenStream( const char * bvh_file_name );
+	bool  ReadFrame( double * frame_data );
+	void  CloseStream();
+	bool  IsStreamOpen() const { return  stream != NULL; }
+
+	// ロード時のモーションデータ解析のスレッド数の既定値の取得・設定（0 の場合はハードウェアのスレッド数）
+	//（全ての BVH で共有、読み込み中の他のスレッドに影響するため、一時的な変更には Load の num_threads を使う）
+	static int  GetNumLoadThreads();
+	static void  SetNumLoadThreads( int n );
+
+	// BVHファイルのセーブ（出力内容は旧実装と同じ、数値の変換は to_chars、書き出しはまとめて行う）
 	void  Save( const char * bvh_file_name );
 
+	// ストリーミングセーブ（このBVHの階層構造で、モーションデータを SaveFrame で１フレームずつ出力）
+	//（モーションデータを持たずに出力できる、EndSave は出力フレーム数が n_frame と異なる場合は false）
+	bool  BeginSave( const char * bvh_file_name, int n_frame, double interval );
+	bool  SaveFrame( const double * frame_data );
+	bool  EndSave();
+	bool  IsSaving() const { return  save_stream != NULL; }
+
+	// バイナリキャッシュ（.bvhc）の読み込み・書き出し
+	//（キャッシュに記録した元ファイルのパス・サイズ・更新時刻が一致する場合のみ読み込む、モーションデータは float で保存）
+	bool  LoadCache( const char * cache_file_name, const char * bvh_file_name );
+	bool  SaveCache( const char * cache_file_name, const char * bvh_file_name ) const;
+
+	// バイナリキャッシュのファイル名を取得（.bvh → .bvhc）
+	static std::string  GetCacheFileName( const char * bvh_file_name );
+
+	// 階層構造（関節名・親子関係・オフセット・末端位置・チャンネル構成）が同じかどうかを判定
+	bool  HasSameHierarchy( const BVH & bvh, double offset_tolerance = 1.0e-4 ) const;
+
   public:
 	/*  データアクセス関数  */
 
@@ -146,15 +188,24 @@ class  BVH
 	int     GetNumFrame() const { return  num_frame; }
 	double  GetInterval() const { return  interval; }
 	double  GetMotion( int f, int c ) const { return  motion[ f*num_channel + c ]; }
+	const double *  GetFrameData( int f ) const { return  motion + (size_t) f * num_channel; }
 
 	// モーションデータの情報の変更
 	void  SetMotion( int f, int c, double v ) { motion[ f*num_channel + c ] = v; }
 
   protected:
+	/*  ロードの補助関数  */
+
+	// ファイル名・動作名の設定
+	void  SetFileName( const char * bvh_file_name );
+
+	// 階層情報・フレーム数・フレーム間隔の読み込み
+	bool  LoadHeader( const char * begin, const char * end, const char * & motion_begin );
+
 	/*  セーブの補助関数  */
 	
 	// 階層構造を再帰的に出力
-	void  OutputHierarchy( std::ofstream & file, const Joint * joint, int indent_level,
+	void  OutputHierarchy( std::string & out, const Joint * joint, int indent_level,
 		std::vector< int > & channel_list );
   
   public:
@@ -12,6 +12,7 @@
 #include <limits>
 #include <cmath>
 #include <algorithm>
+#include <functional>
 
 // ユーザ提供ライブラリ
 #define NOMINMAX
@@ -53,6 +54,27 @@
 //   4) 速度ノルム v を [v_min, v_max] にクランプし、Δtから補間率を決めて P ← interp(P, Q)
 //   5) 終了条件（Gに十分近い）で停止。目標が非停止なら、停止可になるまで延長。
 //
+// * 遷移グラフ（TrainOptions::build_graph のとき Build 時に作成、GenerateOptions::use_planner で使用）
+//   - 作成は全スプラットの組の FK 距離の計算（スプラット数の2乗）のため既定では作成しない
+//   - 辺：mean→next_pose の最近傍スプラット（データ上の遷移）＋ FK距離の近いスプラット（近傍遷移）
+//   - 重み：遷移の時間[s]（FK距離 / v_norm_ref）。開始・目標の最近傍スプラット間の経路を A* で求め、
+//     経路上の次のスプラットを Q_model として経路に沿って生成する（経路は開始・目標のスプラットの組でキャッシュ）
+//   - 目標表：RegisterGoal で登録した目標姿勢は、全スプラットからの最短時間・次のスプラットを Dijkstra で事前計算し、
+//     その目標への生成では A* の代わりに表を参照（O(1)）
+//
+// * スプラットの集約（Build 時）
+//   - 既定は近傍マージ（merge_radius_m 以内のスプラットを先頭から順に吸収、スプラット数はデータ次第）
+//   - TrainOptions::target_splats > 0 ではミニバッチ k-means（特徴は root 平行移動を除去した関節位置）で最大 target_splats 個にまとめ、
+//     各クラスタのメンバーの重心に最も近いスプラットを代表（k-medoids と同様に実在の姿勢）として、
+//     next_pose はメンバーの mean→next の回転・ルート移動の平均を代表に適用（将来の姿勢も区間ごとに同様）、速度・停止可能性はメンバーから集計
+//
+// * スプラットの階層（Build 時に作成、TrainOptions::build_hierarchy）
+//   - 階層 0 はスプラットそのもの。階層 k は階層 k-1 のクラスタを FK距離 occ_sigma_m·2^k 以内でまとめたもの
+//   - クラスタは代表スプラット（メンバーの関節位置の重心に最も近いスプラット）と被覆半径（代表→メンバーの FK距離の最大値）を持つ
+//   - 最近傍探索は粗い階層から、下限（代表までの距離 − 被覆半径）が暫定の最近傍の距離を超えるクラスタを枝刈りして降りる
+//     （結果は線形走査と同じ、距離を計算するスプラット数はモデルの大きさの対数程度）
+//   - GenerateOptions::draft_level で粗い階層の代表スプラットのみを使った低精度・高速な生成
+//
 // ------------------------------------
 
 // デバッグダンプ設定
@@ -79,6 +101,10 @@ struct GaussianSplat {
     Posture  next_pose;               // 1ステップ先の代表姿勢（学習データから取得）
     bool     has_next = true;         // 学習末尾などで next が無い場合は false
 
+    // 四元数表現（生成時の探索・補間はこちらを使用）
+    QPosture mean_qpose;              // mean_pose と同じ姿勢
+    QPosture next_qpose;              // next_pose と同じ姿勢
+
     // 簡易ガウス（等方、FK距離[m]空間）
     float    occ_sigma_m = 0.05f;     // 占有半径（メートル相当）
 
@@ -88,6 +114,11 @@ struct GaussianSplat {
     float    v_norm_min  = 0.2f;      // 最小速度（生成時のレンジ下限）
     float    v_norm_max  = 1.5f;      // 最大速度（生成時のレンジ上限）
 
+    // 将来の姿勢（TrainOptions::horizon_steps > 0 のとき、next_pose に続く学習データのフレーム、四元数表現のみ）
+    std::vector<QPosture> horizon_qposes;  // horizon_qposes[h] は next_pose の h+1 フレーム先
+    std::vector<float>    horizon_v_norm;  // 直前の姿勢から horizon_qposes[h] への速度（FK距離[m]/s）
+    std::vector<float>    horizon_stopability; // その速度に対する停止可能性（stopability と同じ計算）
+
     // 由来情報（デバッグ用）
     std::string source_motion;
     int         source_frame = -1;
@@ -101,9 +132,26 @@ struct TrainOptions {
     float merge_radius_m    = 0.03f;  // 代表姿勢の近傍マージ半径（FK距離[m]）
     bool  enable_merge      = true;   // 近傍マージの有無
     float stop_v_threshold  = 0.15f;  // v_norm_ref がこの値未満なら「停止可」に寄せる
+    bool  keep_matrix_poses = true;   // false: スプラット姿勢を四元数表現（mean_qpose/next_qpose）のみで保持
+    int   graph_neighbors   = 4;      // 遷移グラフの近傍遷移の辺の数（スプラットごと、FK距離の近い順）
+    float graph_radius_m    = 0.5f;   // 近傍遷移の辺を張る最大のFK距離[m]
+    bool  build_graph       = false;  // 遷移グラフを作成（GenerateOptions::use_planner・GSModel::RegisterGoal に必要、スプラット数の2乗の計算）
+    int   horizon_steps     = 0;      // スプラットに保持する next_pose より先の姿勢の数（0 = next_pose のみ）
+    bool  build_hierarchy   = true;   // スプラットの階層を作成（最近傍探索の枝刈り・GenerateOptions::draft_level）
+    int   target_splats     = 0;      // 1以上：近傍マージの代わりにミニバッチ k-means でスプラットを最大この数にまとめる（0 = 近傍マージ）
+    int   cluster_iters     = 100;    // k-means のミニバッチの反復回数
+    int   cluster_batch     = 1024;   // ミニバッチの大きさ（スプラット数）
+    int   cluster_seed      = 1;      // 初期中心・ミニバッチの乱数の種（スレッド数によらず同じ種なら同じ結果）
+    int   cluster_threads   = 0;      // 割り当ての並列計算のスレッド数（0 = ハードウェアのスレッド数）
     DumpOptions dump;                 // モデル構築時のダンプ
 };
 
+// 候補姿勢のαの探索方式
+enum AlphaSearchMode {
+    ALPHA_SEARCH_GRID   = 0,  // α ∈ {0, 0.25, 0.5, 0.75, 1} を全て評価
+    ALPHA_SEARCH_GOLDEN = 1   // 黄金分割探索（評価回数は alpha_eval_budget まで、dt バックオフ時は前の最良のαから評価）
+};
+
 // 生成オプション（最小）
 struct GenerateOptions {
     float tempo             = 1.0f;   // 全体のテンポ倍率（1.0=学習相当）
@@ -113,11 +161,160 @@ struct GenerateOptions {
     int   max_steps         = 600;    // 安全上限（20秒@30Hz）
     bool  extend_to_stable  = true;   // ゴールが非停止なら安定姿勢まで延長
     float v_floor_mps       = 0.20f; // 最低速度[m/s]（FK距離換算）。パンチ等で進みを確保
+    PostureInterpolationMode interp_mode = POSTURE_INTERP_SLERP; // 候補姿勢の補間方式（NLERPは近似・高速、FAST_SLERPは誤差0.001度以下で高速）
+    float deadline_ms       = 0.0f;   // 生成の制限時間[ms]（0以下=無制限）。残り時間に応じて探索を簡略化し、超過時は途中までの最良の動作を返す
+    AlphaSearchMode alpha_search = ALPHA_SEARCH_GRID; // αの探索方式
+    int   alpha_eval_budget = 3;      // ALPHA_SEARCH_GOLDEN の dt ごとの候補評価数の上限（2以上）
+    bool  batch_candidates  = true;   // ALPHA_SEARCH_GRID の dt ごとの候補をまとめて補間・FK（結果は1つずつ評価した場合と同じ）
+    bool  use_planner       = false;  // 遷移グラフ上の経路（A*）に沿って生成（経路を外れたら再計画、グラフがなければ使用しない）
+    bool  use_horizon       = true;   // スプラットの将来の姿勢（horizon_qposes）があれば、占有半径内に留まる間は近傍スプラットを探索せずに沿って進む
+    int   draft_level       = 0;      // 1以上：スプラットの階層 draft_level のクラスタの代表スプラットのみから近傍を探索（低精度・高速、階層の数を超えれば最も粗い階層）
     DumpOptions dump;                 // 生成時のダンプ
 };
 
+// 生成の終了状態
+enum GenerateStatus {
+    GENERATE_REACHED   = 0,  // 目標に到達（extend_to_stable の延長を含む）
+    GENERATE_MAX_STEPS = 1,  // max_steps に達して終了（未到達）
+    GENERATE_STALLED   = 2,  // 前進できる候補が無く終了（未到達）
+    GENERATE_DEADLINE  = 3,  // 制限時間で打ち切り（目標に最も近づいた姿勢までの動作を返す）
+    GENERATE_CANCELLED = 4   // GenerateStream の出力先が false を返して中止
+};
+
+// 生成結果の逐次出力先（姿勢が得られるたびに時刻と姿勢を受け取る、false を返すと生成を中止）
+typedef std::function<bool(float t, const QPosture& pose)> GenerateSink;
+
+// 生成の結果情報
+struct GenerateResult {
+    GenerateStatus status = GENERATE_REACHED;
+    bool  truncated       = false; // 制限時間で打ち切った（打ち切る前に目標の許容距離内に入っていれば status = REACHED）
+    int   steps           = 0;     // 目標へ向かうステップ数（延長を除く）
+    int   evaluations     = 0;     // 候補姿勢の評価回数の合計（補間3回・FK距離2回が1回）
+    int   max_level       = 0;     // 使用した探索の簡略化段階の最大値（0:通常, 1:αグリッド縮小, 2:+近似最近傍）
+    int   plans           = 0;     // 経路の計画回数（use_planner、キャッシュから得た場合を含む）
+    int   nearest_queries = 0;     // 近傍スプラットの探索回数（延長を含む）
+    float final_dist_goal = 0.0f;  // 最後の姿勢と目標姿勢のFK距離[m]
+    float elapsed_ms      = 0.0f;  // 生成の所要時間[ms]（キャッシュから得た場合は参照の時間）
+    bool  cache_hit       = false; // 生成結果のキャッシュから得た（GSModel::SetResultCache）
+};
+
+// 生成結果のキャッシュの設定（開始・目標姿勢は最近傍スプラットで量子化して鍵とし、同じ鍵の結果のうち
+//   開始・目標姿勢との FK 距離がともに match_m 以内のものを同じ要求の結果とみなす）
+struct GenerateCacheOptions {
+    size_t max_bytes  = 0;        // 使用するメモリの上限[byte]（0 = キャッシュなし、超えたら最も古く参照した結果から破棄）
+    float  match_m    = 0.01f;    // 同じ要求とみなす開始・目標姿勢の FK 距離[m]
+    float  pos_step_m = 0.01f;    // 開始→目標のルート位置の差の量子化の幅[m]
+    float  tempo_step = 0.01f;    // テンポ倍率の量子化の幅
+};
+
+// 生成結果のキャッシュの統計
+struct GenerateCacheStats {
+    long long lookups = 0;        // 参照回数
+    long long hits = 0;
+    long long evictions = 0;      // メモリの上限による破棄の数
+    size_t    entries = 0;
+    size_t    bytes = 0;          // 使用中のメモリ（見積もり）[byte]
+    size_t    max_bytes = 0;
+    float     hit_us_mean = 0.0f; // 参照時間（ヒット時は結果の複製・開始姿勢への変換を含む）[us]
+    float     hit_us_max = 0.0f;
+    float     miss_us_mean = 0.0f;
+};
+
+// 一括FKのレーン数（候補姿勢の数がこれを超える場合は複数回に分けて計算）
+const int GSM_FK_LANES = 8;
+
+// FK距離の作業領域（使い回すと FKDistance・FindNearestSplat でメモリを確保しない）
+struct FKWorkspace {
+    std::vector<Matrix4f> seg_frames;
+    std::vector<Point3f>  joints_a;
+    std::vector<Point3f>  joints_b;
+    std::vector<Point3f>  joints_c;
+
+    // 一括FK（FKDistanceBatch）の作業領域、姿勢を GSM_FK_LANES 個ずつレーンに並べて計算
+    struct Link {
+        int      seg, next_seg, next_joint;  // 親の体節・子の体節・間の関節
+        Vector3f to_joint, from_joint;       // 親の体節→関節・関節→子の体節の平行移動
+    };
+    const Skeleton*    links_body = nullptr;
+    std::vector<Link>  links;        // ルートから末端への計算順（ForwardKinematics の再帰と同じ順）
+    std::vector<float> lane_frames;  // [体節][12 要素][レーン]（回転 3x3・平行移動）
+    std::vector<float> lane_joints;  // [関節][xyz][レーン]
+
+    // スプラットの階層の探索（FindNearestSplat）の作業領域
+    struct LODEntry {
+        float bound;                 // クラスタ内のスプラットとの距離の下限
+        float dist;                  // 代表スプラットとの距離
+        int   level, node;
+    };
+    std::vector<float>    query_joints;  // 探索する姿勢の root 平行移動を除去した関節位置 [関節][xyz]
+    std::vector<LODEntry> lod_heap;      // 未探索のクラスタ（下限の小さい順）
+    long long nearest_evals = 0;         // 最近傍探索で FK 距離を計算したスプラット・クラスタの数（累計）
+};
+
+// 経路計画（A*）の作業領域（使い回すと PlanSplatPath の探索でメモリを確保しない）
+struct PlanWorkspace {
+    std::vector<float> cost, h;    // 開始からの時間・目標までの時間の下限（未計算は負）
+    std::vector<int>   parent;
+    std::vector<char>  closed;
+    std::vector<std::pair<float, int>> open;  // 未探索のスプラット（時間の下限の小さい順のヒープ）
+    FKWorkspace fk;                // ヒューリスティックの FK 距離用
+};
+
+// 生成のロールアウトの状態（ステップ間で保持、GenerateQ と GSModelController で共有）
+struct GenerateRolloutState {
+    QPosture cur;                  // 現在の姿勢
+    QPosture goal;                 // 目標姿勢
+    float    t = 0.0f;             // 現在の時刻[s]
+    int      stagnation_count = 0; // 前進できなかったステップの連続数
+    int      force_goal_steps = 0; // α=1 固定で強制前進する残りステップ数
+    int      goal_sid = -1;        // 目標姿勢の最近傍スプラット
+    bool     goal_stoppable = false;
+    int      prev_sid = -1;        // 直前の近傍スプラット（近似探索用）
+    int      follow_sid = -1;      // 将来の姿勢に沿って進んでいるスプラット（GenerateOptions::use_horizon）
+    int      follow_index = 0;     // その mean(0)・next(1)・horizon(2..) の列の現在の位置
+    int      nearest_queries = 0;  // 近傍スプラットの探索回数
+
+    // 作業領域（初回のみ確保）
+    QPosture p_model, p_goal, candidate, best_pose;
+    std::vector<QPosture> batch;   // 一括評価する候補姿勢（GenerateOptions::batch_candidates）
+    FKWorkspace fk;
+
+    // 計画経路（GenerateOptions::use_planner、目標の変更で破棄）
+    std::vector<int> plan;         // スプラット番号の列（先頭が計画時の現在のスプラット、末尾が goal_sid）
+    std::vector<float> plan_time;  // 経路上の各スプラットから goal_sid までの時間[s]
+    int      plan_index = 0;       // 現在のスプラットの経路上の位置
+    int      plans = 0;            // 計画回数
+    int      landmark = -1;        // goal_sid の目標表の番号（GSModel::RegisterGoal で登録済みの場合、経路計画の代わりに参照）
+    PlanWorkspace planner;         // 経路計画の作業領域（use_planner のとき BeginRollout で確保）
+};
+
+// 生成の1ステップの情報（ダンプ用）
+struct GenerateStepInfo {
+    int         splat_id = -1;
+    float       dist_goal = 0.0f;   // 前進後の目標とのFK距離
+    float       delta_goal = 0.0f;
+    float       alpha = 0.0f;
+    const char* alpha_mode = "";    // "grid" / "golden" / "plan" / "fallback_goal" / "force_goal"
+    float       step_norm = 0.0f;
+    float       dt = 0.0f;
+    float       v_ref = 0.0f;
+    float       v_min = 0.0f;
+    float       v_max = 0.0f;
+    float       used_speed = 0.0f;
+    float       stopability = 0.0f;
+    float       r_model = 0.0f;
+    float       r_goal = 0.0f;
+    int         num_evals = 0;      // 候補姿勢の評価回数
+    bool        dt_backoff = false; // dt をバックオフした
+    bool        force_goal = false; // 強制前進中のステップ
+    bool        trigger_force = false;
+    int         plan_length = 0;    // このステップで経路を計画した場合はその長さ（スプラット数）
+    int         horizon_index = 0;  // 将来の姿勢に沿って進んだ場合の列の位置（0: 近傍スプラットの next_pose へ、h: horizon_qposes[h-1] から先へ）
+};
+
 // 前方宣言
 class GSModelBuilder;
+class GSModelController;
 
 // メインモデル
 class GSModel {
@@ -127,10 +324,25 @@ public:
 
     // スケルトン一致確認（Posture.bodyがHumanBodyのSkeletonと一致か）
     bool IsCompatible(const Posture& p) const;
+    bool IsCompatible(const QPosture& p) const;
 
     // スプラット集合の参照
     const std::vector<GaussianSplat>& GetSplats() const { return splats_; }
 
+    // 内部に保持している HumanBody（生成に渡す姿勢はこの Skeleton で作成する）
+    const HumanBody& GetHumanBody() const { return human_; }
+
+    // FK距離（root平行移動を除去した関節位置のRMSE[m]、生成結果の評価にも使用）
+    float FKDistance(const Posture& a, const Posture& b) const;
+    float FKDistance(const QPosture& a, const QPosture& b) const;
+    float FKDistance(const QPosture& a, const QPosture& b, FKWorkspace& ws) const;
+
+    // num 個の姿勢と2つ（ref_c を指定すれば3つ）の基準姿勢の FK 距離をまとめて計算（dist_a[i] = FKDistance(poses[i], ref_a) と同じ値）
+    //   基準姿勢の FK は1回のみ、各姿勢の FK は姿勢をレーンとしてベクトル化
+    void FKDistanceBatch(const QPosture* const* poses, int num, const QPosture& ref_a, const QPosture& ref_b,
+                         float* dist_a, float* dist_b, FKWorkspace& ws,
+                         const QPosture* ref_c = nullptr, float* dist_c = nullptr) const;
+
     // モデルにHumanBodyを含んでいるので、生成時にHumanBodyは不要
     // 生成：開始姿勢・目標姿勢・テンポ→KeyframeMotion
     KeyframeMotion Generate(const Posture& start,
@@ -139,7 +351,60 @@ public:
 
     KeyframeMotion Generate(const Posture& start,
                             const Posture& goal,
-                            const GenerateOptions& opt) const;
+                            const GenerateOptions& opt,
+                            GenerateResult* result = nullptr) const;
+
+    // 生成（四元数表現の姿勢のまま入出力、行列表現への変換なし）
+    void GenerateQ(const QPosture& start,
+                   const QPosture& goal,
+                   const GenerateOptions& opt,
+                   std::vector<float>& times,
+                   std::vector<QPosture>& poses,
+                   GenerateResult* result = nullptr) const;
+
+    // 生成（姿勢が得られるたびに sink へ出力し、生成結果の全体を保持しない）
+    // 制限時間で打ち切った場合も出力済みの姿勢は取り消さない（GenerateQ は目標に最も近づいた姿勢までに切り詰める）
+    void GenerateStream(const QPosture& start,
+                        const QPosture& goal,
+                        const GenerateOptions& opt,
+                        const GenerateSink& sink,
+                        GenerateResult* result = nullptr) const;
+
+    // 遷移グラフ上の最短時間の経路（A*、スプラット番号の列を path に格納、到達できなければ false）
+    //   結果は (start_sid, goal_sid) ごとにキャッシュ（複数スレッドから呼び出し可）
+    //   作業領域を渡すと探索ではメモリを確保しない（新しい経路のキャッシュへの登録を除く）
+    bool PlanSplatPath(int start_sid, int goal_sid, std::vector<int>& path) const;
+    bool PlanSplatPath(int start_sid, int goal_sid, std::vector<int>& path, PlanWorkspace& ws) const;
+
+    // 遷移グラフの辺の数・経路キャッシュの統計
+    int GetNumGraphEdges() const { return (int)graph_edges_.size(); }
+    void GetPlanCacheStats(long long* hits, long long* misses) const;
+
+    // 最近傍スプラット（スプラットの階層があれば粗い階層から枝刈りしながら探索、結果は全スプラットの線形走査と同じ）
+    //   level > 0 は階層 level のクラスタの代表スプラットのみから探索（GenerateOptions::draft_level）
+    int FindNearestSplat(const QPosture& p, float* out_dist, FKWorkspace& ws, int level = 0) const;
+
+    // スプラットの階層の数（階層 0 はスプラットそのもの、階層を作成していなければ 0）・各階層のクラスタ数
+    int GetNumSplatLevels() const { return (int)lod_.size(); }
+    int GetNumSplatClusters(int level) const { return (int)lod_[level].nodes.size(); }
+
+    // 目標姿勢の登録（全スプラットから目標姿勢の最近傍スプラットまでの遷移グラフ上の最短時間・次のスプラットを
+    //   Dijkstra で求めて目標表として保持、戻り値は目標表の番号、遷移グラフがなければ -1）
+    //   同じスプラットを目標とする生成（use_planner）は経路計画の代わりに目標表を参照する
+    //   生成と並行して呼び出さないこと（学習後・サーバの開始前に登録）
+    int RegisterGoal(const QPosture& goal);
+    int GetNumGoalLandmarks() const { return (int)landmarks_.size(); }
+    int GetGoalLandmarkSplat(int landmark) const { return landmarks_[landmark].goal_sid; }
+
+    // 目標表のスプラット sid から目標のスプラットまでの最短時間[s]（到達できなければ無限大）
+    float GetCostToGo(int landmark, int sid) const { return landmarks_[landmark].cost_to_go[sid]; }
+
+    // 生成結果のキャッシュ（GenerateQ・Generate、LRU、複数スレッドから参照可、モデルの複製間で共有）
+    //   鍵は開始・目標姿勢の最近傍スプラット・開始→目標のルート位置の差とテンポ・結果に影響する GenerateOptions
+    //   結果は開始姿勢のルートの位置・向きに合わせて変換して返す（先頭の姿勢は開始姿勢そのもの）
+    //   ダンプが有効な生成・制限時間で打ち切った結果は対象外。学習後・生成の開始前に設定（max_bytes = 0 で無効）
+    void SetResultCache(const GenerateCacheOptions& opt);
+    GenerateCacheStats GetResultCacheStats() const;
 
     // 一括学習ユーティリティ
     static GSModel Fit(const HumanBody& human,
@@ -153,10 +418,48 @@ public:
 
 private:
     friend class GSModelBuilder;
+    friend class GSModelController;
 
     HumanBody human_;                      // モデル内に保持（Skeleton一貫性の源）
     std::vector<GaussianSplat> splats_;    // スプラット集合
 
+    // 遷移グラフ（スプラット i からの辺は graph_edges_[graph_offsets_[i] .. graph_offsets_[i+1])）
+    struct SplatEdge {
+        int   to = -1;
+        float cost = 0.0f;      // 遷移の時間[s]
+        bool  successor = false; // データ上の遷移（mean→next_pose）
+    };
+    std::vector<int>       graph_offsets_;
+    std::vector<SplatEdge> graph_edges_;
+    float graph_max_speed_ = 0.0f;         // 辺の速度の最大値（A* のヒューリスティック用）
+    struct PlanCache;
+    std::shared_ptr<PlanCache> plan_cache_; // 経路キャッシュ（モデルの複製間で共有）
+
+    // 目標表（RegisterGoal、遷移グラフの作成で破棄）
+    struct GoalLandmark {
+        int goal_sid = -1;
+        std::vector<float> cost_to_go;  // 各スプラットから goal_sid までの最短時間[s]
+        std::vector<int>   next_sid;    // 最短経路上の次のスプラット（goal_sid・到達できないスプラットは -1）
+    };
+    std::vector<GoalLandmark> landmarks_;
+    std::vector<int> splat_landmark_;      // スプラット → そのスプラットを目標とする目標表の番号（なければ -1）
+
+    struct ResultCache;
+    std::shared_ptr<ResultCache> result_cache_; // 生成結果のキャッシュ（SetResultCache）
+
+    // スプラットの階層（lod_[0] はスプラットそのもの、lod_[k] の各クラスタの子は lod_[k-1] の連続した範囲）
+    struct SplatCluster {
+        int   center = -1;        // 代表スプラット
+        float radius = 0.0f;      // 被覆半径[m]（代表スプラット→メンバーのスプラットの FK 距離の最大値）
+        int   first_child = 0;    // 子のクラスタ（lod_[k-1] の first_child .. first_child+num_children）
+        int   num_children = 0;
+    };
+    struct SplatLevel {
+        std::vector<SplatCluster> nodes;
+        std::vector<float> joints;  // 代表スプラットの root 平行移動を除去した関節位置 [クラスタ][関節][xyz]（子の範囲と同じ並び）
+    };
+    std::vector<SplatLevel> lod_;
+
 #if GSM_ENABLE_DUMP
     DumpOptions default_dump_;             // 既定ダンプ設定
 #endif
@@ -164,12 +467,63 @@ private:
     // --- ヘルパ ---
     // FKで全関節ワールド位置を取得（joint配列サイズは body->num_joints）
     void FKJointPositions(const Posture& p, std::vector<Point3f>& joints) const;
+    void FKJointPositions(const QPosture& p, std::vector<Point3f>& joints) const;
 
-    // FK距離（root平行移動を除去）
-    float FKDistance(const Posture& a, const Posture& b) const;
-
-    // 最近傍スプラット探索（線形走査の最小版）
+    // 最近傍スプラット探索（行列表現は線形走査の最小版、四元数表現は階層があれば階層を探索）
     int FindNearestSplat(const Posture& p, float* out_dist = nullptr) const;
+    int FindNearestSplat(const QPosture& p, float* out_dist = nullptr) const;
+
+    // 近似最近傍（hint のスプラットの占有半径内なら全探索を省略）
+    int FindNearestSplatApprox(const QPosture& p, int hint, float* out_dist, FKWorkspace& ws, int level = 0) const;
+
+    // 一括FKの作業領域の確保（骨格の計算順の作成、確保済みなら何もしない）
+    void PrepareFKBatch(FKWorkspace& ws) const;
+
+    // 経路計画の作業領域の確保（スプラット数・辺の数に合わせる、確保済みなら何もしない）
+    void PreparePlanWorkspace(PlanWorkspace& ws) const;
+
+    // 遷移グラフの作成（Build 時）
+    void BuildTransitionGraph(const TrainOptions& opt);
+
+    // スプラットの階層の作成（Build 時）・階層の探索（FindNearestSplat）
+    void BuildSplatHierarchy(const TrainOptions& opt);
+    int FindNearestSplatLOD(const QPosture& p, int level, float* out_dist, FKWorkspace& ws) const;
+
+    // 計画経路に沿った次のスプラット（sid が経路上になければ再計画、目標のスプラットに到達済み・経路なしは -1）
+    //   time_to_go には sid から目標のスプラットまでの時間（目標表があれば再計画せずに表から取得）
+    int FollowPlan(GenerateRolloutState& st, int sid, int* plan_length, float* time_to_go) const;
+
+    // 追従中のスプラットの将来の姿勢に沿った位置の更新（現在の姿勢に最も近い位置まで進め、
+    //   その位置から占有半径を外れた・列の末尾に達した場合は追従をやめて false）
+    bool FollowHorizon(GenerateRolloutState& st) const;
+
+    // ロールアウトの各ステップの近傍スプラット（将来の姿勢に沿って進む間は探索を省略、horizon_index は列の位置）
+    int FindRolloutSplat(GenerateRolloutState& st, const GenerateOptions& opt, int level, int* horizon_index) const;
+
+    // ロールアウト（GenerateQ・GSModelController 共通）
+    //   BeginRollout   : 状態を初期化（作業領域の確保はここでのみ行う）
+    //   RetargetRollout: 目標姿勢を変更（停滞・強制前進のカウンタはリセット）
+    //   StepRollout    : 目標へ1ステップ前進（前進できなければ false、level は探索の簡略化段階）
+    //   ExtendRollout  : 停止可能なスプラットへ向けて1ステップ延長（停止可能になれば false）
+    void BeginRollout(GenerateRolloutState& st, const QPosture& start, const QPosture& goal,
+                      const GenerateOptions& opt) const;
+    void RetargetRollout(GenerateRolloutState& st, const QPosture& goal, const GenerateOptions& opt) const;
+    bool StepRollout(GenerateRolloutState& st, const GenerateOptions& opt, float d_goal, int level,
+                     GenerateStepInfo& info) const;
+    bool ExtendRollout(GenerateRolloutState& st, const GenerateOptions& opt, int level) const;
+
+    // 生成の本体（GenerateQ・GenerateStream 共通、times・poses が指定されていれば全体を格納、sink が指定されていれば逐次出力）
+    void GenerateRollout(const QPosture& start, const QPosture& goal, const GenerateOptions& opt,
+                         const GenerateSink* sink, std::vector<float>* times, std::vector<QPosture>* poses,
+                         GenerateResult* result) const;
+
+    // 終了時の状態（GenerateRollout・GSModelController 共通）
+    //   前進できない・max_steps・制限時間で終えても、返した動作の目標に最も近い姿勢（closest_dist）が許容距離内なら到達
+    static GenerateStatus ResolveStatus(GenerateStatus status, float closest_dist, float goal_th);
+
+    // キャッシュを使った生成（GenerateQ、キャッシュになければ GenerateRollout で生成して登録）
+    void GenerateCached(const QPosture& start, const QPosture& goal, const GenerateOptions& opt,
+                        std::vector<float>& times, std::vector<QPosture>& poses, GenerateResult* result) const;
 
     // 速度ノルムのクランプ
     static float Clamp(float x, float lo, float hi) {
@@ -179,30 +533,31 @@ private:
 #if GSM_ENABLE_DUMP
     // ダンプ
     void DumpModel(const std::string& dir) const;
-    struct StepLog {
-        int         step = 0;
-        int         splat_id = -1;
-        float       t_sec = 0.0f;
-        float       dist_goal = 0.0f;
-        float       delta_goal = 0.0f;
-        float       alpha = 0.0f;
-        std::string alpha_mode;
-        float       step_norm = 0.0f;
-        float       dt = 0.0f;
-        float       v_ref = 0.0f;
-        float       v_min = 0.0f;
-        float       v_max = 0.0f;
-        float       used_speed = 0.0f;
-        float       v_floor = 0.0f;
-        std::string events;
-        float       stopability = 0.0f;
-        float       r_model = 0.0f;
-        float       r_goal = 0.0f;
-    };
+    struct StepLog {
+        int         step = 0;
+        int         splat_id = -1;
+        float       t_sec = 0.0f;
+        float       dist_goal = 0.0f;
+        float       delta_goal = 0.0f;
+        float       alpha = 0.0f;
+        std::string alpha_mode;
+        float       step_norm = 0.0f;
+        float       dt = 0.0f;
+        float       v_ref = 0.0f;
+        float       v_min = 0.0f;
+        float       v_max = 0.0f;
+        float       used_speed = 0.0f;
+        float       v_floor = 0.0f;
+        std::string events;
+        float       stopability = 0.0f;
+        float       r_model = 0.0f;
+        float       r_goal = 0.0f;
+        int         n_eval = 0;
+    };
     void DumpGenerateTrace(const std::string& dir,
                            const std::vector<StepLog>& logs,
                            const std::vector<float>& times,
-                           const std::vector<Posture>& poses,
+                           const std::vector<QPosture>& poses,
                            const GenerateInitLog* init) const;
 #endif
 };
@@ -215,7 +570,16 @@ public:
     // Motionを追加（学習データ）
     void AddMotion(const Motion& m);
 
-    // モデルを構築
+    // 姿勢を1フレームずつ追加（BeginStream → AddFrame … → EndStream）
+    // 全フレームを保持せず、直前の1フレームとの組からその場でスプラットを作成する
+    void BeginStream(const std::string& name, float interval);
+    void AddFrame(const Posture& p);
+    void EndStream();
+
+    // BVHファイルをストリーミングで追加（BVH::OpenStream/ReadFrame で小さな窓ずつ読み込み、メモリ使用量はフレーム数によらず一定）
+    void AddBVHStream(const char* bvh_file_name);
+
+    // モデルを構築（AddMotion 分のスプラットの後にストリーミング分を並べる）
     GSModel Build() const;
 
 private:
@@ -223,9 +587,25 @@ private:
     TrainOptions opt_;
     std::vector<const Motion*> motions_;  // 参照保持（寿命は呼び出し側で確保してください）
 
+    // ストリーミング追加の状態
+    GSModel stream_fk_;                         // FK距離の計算用
+    std::vector<GaussianSplat> stream_splats_;  // 作成済みのスプラット
+    std::vector<int> stream_pending_;           // 将来の姿勢が horizon_steps 個に満たないスプラット
+    Posture stream_prev_;                       // 直前のフレーム
+    int stream_frame_ = -1;                     // 追加済みフレーム数（-1: ストリーム外）
+    std::string stream_name_;
+    float stream_interval_ = 1.0f;
+
     // スプラット作成ヘルパ
+    void AppendSplat(const GSModel& fk, const Posture& cur, const Posture& nxt,
+                     const std::string& name, int frame, float interval,
+                     std::vector<GaussianSplat>& out) const;
     void AppendMotionSplats(const Motion& m, std::vector<GaussianSplat>& out) const;
+    void AppendHorizon(const Posture& p, float v_norm, GaussianSplat& g) const;
 
     // 近傍マージ
     void MergeNearby(std::vector<GaussianSplat>& splats) const;
+
+    // クラスタリングによる集約（TrainOptions::target_splats、関節位置を特徴とするミニバッチ k-means）
+    void ClusterSplats(std::vector<GaussianSplat>& splats) const;
 };
@@ -0,0 +1,250 @@
+﻿/**
+***  キャラクタアニメーションのための人体モデルの表現・基本処理 ライブラリ・サンプルプログラム
+***  Copyright (c) 2015-, Masaki OSHITA (www.oshita-lab.org)
+***  Released under the MIT license http://opensource.org/licenses/mit-license.php
+**/
+
+/**
+***  Gaussian Splatting モデルの常駐サーバ（app_headless --serve）のクライアント
+***
+***  使い方: gsm_client socket_path [オプション]
+***    -n num_requests     生成要求の総数（既定 100）
+***    -c num_clients      並行して接続するクライアント数（既定 4、要求は各クライアントに均等に分配）
+***    --from motion time  開始姿勢（サーバのサンプル動作の番号・時刻、既定 0 0.0）
+***    --to motion time    目標姿勢（既定 0 1.75）
+***    --tempo t           テンポ倍率（既定 1.0）
+***    --interp mode       補間方式 slerp / nlerp / fast（既定 slerp）
+***    --explicit          開始・目標姿勢をサーバから取得し、明示的な姿勢として送信
+***    --layout bvh        骨格・出力の階層構造に使うBVH（既定 motion_rikiya/I25.bvh、サーバと同じ骨格）
+***    --out bvh           最初の生成結果を 30fps のBVHファイルに出力
+***    --stats             終了時にサーバの統計を取得して出力
+***    --shutdown          終了時にサーバを停止
+**/
+
+
+// ライブラリ・クラス定義の読み込み
+#include "SimpleHuman.h"
+#include "BVH.h"
+#include "GSModelServer.h"
+
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+
+using namespace  std;
+
+
+// サンプル動作データのBVHファイルのスケール（app_headless と同じ）
+const float  sample_bvh_scale = 0.025f;
+
+
+//
+//  百分位数の取得
+//
+static float  Percentile( vector< float > values, double q )
+{
+	if ( values.empty() )
+		return  0.0f;
+	size_t  k = min( values.size() - 1, (size_t)( q * values.size() ) );
+	nth_element( values.begin(), values.begin() + k, values.end() );
+	return  values[ k ];
+}
+
+
+//
+//  メイン関数（プログラムはここから開始）
+//
+int  main( int argc, char ** argv )
+{
+	if ( argc < 2 )
+	{
+		cerr << "usage: gsm_client socket_path [-n num_requests] [-c num_clients] [--from motion time] [--to motion time]" << endl;
+		cerr << "       [--tempo t] [--interp slerp|nlerp|fast] [--explicit] [--layout bvh] [--out bvh] [--stats] [--shutdown]" << endl;
+		return  1;
+	}
+
+	// オプションの解析
+	string  socket_path = argv[ 1 ];
+	int  num_requests = 100, num_clients = 4;
+	GSMPoseRef  from, to;
+	to.time = 1.75f;
+	GenerateOptions  gopt;
+	bool  use_explicit = false, print_stats = false, shutdown = false;
+	string  layout_file = "motion_rikiya/I25.bvh", out_file;
+	for ( int i = 2; i < argc; i++ )
+	{
+		string  a = argv[ i ];
+		if ( ( a == "-n" ) && ( i + 1 < argc ) )
+			num_requests = atoi( argv[ ++i ] );
+		else if ( ( a == "-c" ) && ( i + 1 < argc ) )
+			num_clients = max( 1, atoi( argv[ ++i ] ) );
+		else if ( ( a == "--from" ) && ( i + 2 < argc ) )
+		{
+			from.motion = atoi( argv[ ++i ] );
+			from.time = (float) atof( argv[ ++i ] );
+		}
+		else if ( ( a == "--to" ) && ( i + 2 < argc ) )
+		{
+			to.motion = atoi( argv[ ++i ] );
+			to.time = (float) atof( argv[ ++i ] );
+		}
+		else if ( ( a == "--tempo" ) && ( i + 1 < argc ) )
+			gopt.tempo = (float) atof( argv[ ++i ] );
+		else if ( ( a == "--interp" ) && ( i + 1 < argc ) )
+		{
+			string  m = argv[ ++i ];
+			gopt.interp_mode = ( m == "nlerp" ) ? POSTURE_INTERP_NLERP : ( m == "fast" ) ? POSTURE_INTERP_FAST_SLERP : POSTURE_INTERP_SLERP;
+		}
+		else if ( a == "--explicit" )
+			use_explicit = true;
+		else if ( ( a == "--layout" ) && ( i + 1 < argc ) )
+			layout_file = argv[ ++i ];
+		else if ( ( a == "--out" ) && ( i + 1 < argc ) )
+			out_file = argv[ ++i ];
+		else if ( a == "--stats" )
+			print_stats = true;
+		else if ( a == "--shutdown" )
+			shutdown = true;
+		else
+		{
+			cerr << "[CLIENT] unknown option " << a << endl;
+			return  1;
+		}
+	}
+
+	// 骨格モデルの生成（階層構造のみを読み込み）
+	SetBVHScale( sample_bvh_scale );
+	BVH  layout;
+	if ( !layout.OpenStream( layout_file.c_str() ) )
+	{
+		cerr << "[CLIENT] cannot load " << layout_file << endl;
+		return  1;
+	}
+	layout.CloseStream();
+	Skeleton *  body = CoustructBVHSkeleton( &layout );
+
+	// 明示的な姿勢を使う場合は、開始・目標姿勢をサーバから取得
+	QPosture  start( body ), goal( body );
+	if ( use_explicit )
+	{
+		GSModelClient  client;
+		if ( !client.Connect( socket_path ) || ( client.GetPose( from, start ) != GSM_STATUS_OK ) || ( client.GetPose( to, goal ) != GSM_STATUS_OK ) )
+		{
+			cerr << "[CLIENT] cannot get poses from " << socket_path << endl;
+			return  1;
+		}
+	}
+
+	// 各クライアントを並行に実行（クライアントごとに１つの接続で要求を順番に送信）
+	vector< vector< float > >  latencies( num_clients ), generate_us( num_clients );
+	vector< int >  num_errors( num_clients, 0 ), num_keys( num_clients, 0 );
+	vector< float >  first_times;
+	vector< QPosture >  first_poses;
+	auto  t_begin = chrono::steady_clock::now();
+	vector< thread >  threads;
+	for ( int c = 0; c < num_clients; c++ )
+	{
+		threads.push_back( thread( [&, c]()
+		{
+			GSModelClient  client;
+			if ( !client.Connect( socket_path ) )
+			{
+				num_errors[ c ] = num_requests / num_clients + ( c < num_requests % num_clients );
+				return;
+			}
+			vector< float >  times;
+			vector< QPosture >  poses;
+			for ( int r = c; r < num_requests; r += num_clients )
+			{
+				float  g_us = 0.0f;
+				auto  t0 = chrono::steady_clock::now();
+				int  status = use_explicit ? client.Generate( start, goal, gopt, times, poses, &g_us ) :
+					client.Generate( from, to, gopt, body, times, poses, &g_us );
+				auto  t1 = chrono::steady_clock::now();
+				if ( status != GSM_STATUS_OK )
+				{
+					num_errors[ c ]++;
+					if ( !client.IsConnected() && !client.Connect( socket_path ) )
+						return;
+					continue;
+				}
+				latencies[ c ].push_back( chrono::duration< float, micro >( t1 - t0 ).count() );
+				generate_us[ c ].push_back( g_us );
+				num_keys[ c ] = times.size();
+				if ( r == 0 )
+				{
+					first_times = times;
+					first_poses = poses;
+				}
+			}
+		} ) );
+	}
+	for ( int c = 0; c < num_clients; c++ )
+		threads[ c ].join();
+	double  elapsed = chrono::duration< double >( chrono::steady_clock::now() - t_begin ).count();
+
+	// 結果の集計（クライアント側の往復時間）
+	vector< float >  all_latencies, all_generate;
+	int  errors = 0;
+	for ( int c = 0; c < num_clients; c++ )
+	{
+		all_latencies.insert( all_latencies.end(), latencies[ c ].begin(), latencies[ c ].end() );
+		all_generate.insert( all_generate.end(), generate_us[ c ].begin(), generate_us[ c ].end() );
+		errors += num_errors[ c ];
+	}
+	double  sum = 0.0, sum_generate = 0.0;
+	for ( size_t i = 0; i < all_latencies.size(); i++ )
+	{
+		sum += all_latencies[ i ];
+		sum_generate += all_generate[ i ];
+	}
+	int  ok = all_latencies.size();
+	cout << "[CLIENT] requests=" << num_requests << " ok=" << ok << " errors=" << errors << " clients=" << num_clients
+		<< " keys=" << ( first_times.empty() ? 0 : (int) first_times.size() ) << " seconds=" << elapsed
+		<< " req_per_s=" << ( ok / elapsed ) << endl;
+	if ( ok > 0 )
+		cout << "[CLIENT] round_trip_us mean=" << ( sum / ok ) << " p50=" << Percentile( all_latencies, 0.50 )
+			<< " p90=" << Percentile( all_latencies, 0.90 ) << " p99=" << Percentile( all_latencies, 0.99 )
+			<< " max=" << *max_element( all_latencies.begin(), all_latencies.end() )
+			<< " generate_mean=" << ( sum_generate / ok ) << endl;
+
+	// 最初の生成結果をBVHファイルに出力
+	if ( !out_file.empty() && !first_times.empty() )
+	{
+		KeyframeMotion  kf( body, first_times.size() );
+		for ( size_t i = 0; i < first_times.size(); i++ )
+		{
+			kf.key_times[ i ] = first_times[ i ];
+			first_poses[ i ].GetPosture( kf.key_poses[ i ] );
+		}
+		if ( SaveBVHKeyframeMotion( out_file.c_str(), &layout, kf, 30.0f ) )
+			cout << "[CLIENT] saved " << out_file << endl;
+	}
+
+	// サーバの統計の取得・サーバの停止
+	if ( print_stats || shutdown )
+	{
+		GSModelClient  client;
+		GSMServerStats  stats;
+		if ( !client.Connect( socket_path ) )
+		{
+			cerr << "[CLIENT] cannot connect to " << socket_path << endl;
+			return  1;
+		}
+		if ( print_stats && ( client.GetStats( stats ) == GSM_STATUS_OK ) )
+		{
+			cout << "[SERVER] requests=" << stats.num_requests << " errors=" << stats.num_errors
+				<< " active_clients=" << stats.num_active_clients << " connections=" << stats.num_connections << endl;
+			cout << "[SERVER] latency_us mean=" << stats.latency_mean_us << " p50=" << stats.latency_p50_us
+				<< " p90=" << stats.latency_p90_us << " p99=" << stats.latency_p99_us << " max=" << stats.latency_max_us
+				<< " generate_mean=" << stats.generate_mean_us << endl;
+		}
+		if ( shutdown && ( client.Shutdown() == GSM_STATUS_OK ) )
+			cout << "[CLIENT] server stopped" << endl;
+	}
+
+	delete  body;
+	return  ( errors == 0 ) ? 0 : 2;
+}
@@ -0,0 +1,124 @@
+﻿#include "GSModelController.h"
+
+// 延長の最大ステップ数（GenerateQ と同じ、最長 ~4秒）
+static const int max_extend_steps = 120;
+
+GSModelController::GSModelController(const GSModel& model) : model_(model) {
+}
+
+void GSModelController::Begin(const QPosture& start, const QPosture& goal, const GenerateOptions& opt) {
+    if (!model_.IsCompatible(start) || !model_.IsCompatible(goal)) {
+        throw std::runtime_error("GSModelController::Begin: Skeleton mismatch in input Posture.");
+    }
+    if (model_.splats_.empty()) {
+        throw std::runtime_error("GSModelController::Begin: Empty model.");
+    }
+    opt_ = opt;
+    goal_th_ = std::max(1e-4f, opt_.goal_tolerance_m);
+    if (qpose_.body != start.body) qpose_.Init(start.body);
+    model_.BeginRollout(state_, start, goal, opt_);
+    phase_ = PHASE_ROLLOUT;
+    status_ = GENERATE_MAX_STEPS;
+    num_steps_ = 0;
+    num_extend_steps_ = 0;
+    closest_dist_ = std::numeric_limits<float>::infinity();
+}
+
+void GSModelController::Begin(const Posture& start, const Posture& goal, const GenerateOptions& opt) {
+    Begin(QPosture(start), QPosture(goal), opt);
+}
+
+void GSModelController::SetGoal(const QPosture& goal) {
+    if (!model_.IsCompatible(goal)) {
+        throw std::runtime_error("GSModelController::SetGoal: Skeleton mismatch in input Posture.");
+    }
+    if (!state_.cur.body) {
+        throw std::runtime_error("GSModelController::SetGoal: Begin has not been called.");
+    }
+    model_.RetargetRollout(state_, goal, opt_);
+    phase_ = PHASE_ROLLOUT;
+    status_ = GENERATE_MAX_STEPS;
+    num_steps_ = 0;
+    num_extend_steps_ = 0;
+    closest_dist_ = std::numeric_limits<float>::infinity();
+}
+
+void GSModelController::SetGoal(const Posture& goal) {
+    if (!model_.IsCompatible(goal)) {
+        throw std::runtime_error("GSModelController::SetGoal: Skeleton mismatch in input Posture.");
+    }
+    qpose_.SetPosture(goal);
+    SetGoal(qpose_);
+}
+
+bool GSModelController::Step(QPosture& pose, float* time) {
+    bool advanced = false;
+    if (phase_ == PHASE_ROLLOUT) {
+        advanced = StepRollout();
+        if (!advanced && phase_ == PHASE_EXTEND) {
+            advanced = StepExtend();
+        }
+    } else if (phase_ == PHASE_EXTEND) {
+        advanced = StepExtend();
+    }
+    if (state_.cur.body) pose = state_.cur;
+    if (time) *time = state_.t;
+    return advanced;
+}
+
+bool GSModelController::Step(Posture& pose, float* time) {
+    bool advanced = Step(qpose_, time);
+    if (qpose_.body) qpose_.GetPosture(pose);
+    return advanced;
+}
+
+// 目標へ向かう1ステップ（GenerateQ のループ1回分、終了判定を満たせば延長または終了へ移行）
+bool GSModelController::StepRollout() {
+    if (num_steps_ >= opt_.max_steps) {
+        EndRollout();
+        return false;
+    }
+
+    // 終了条件（距離）
+    float d_goal = model_.FKDistance(state_.cur, state_.goal, state_.fk);
+    closest_dist_ = std::min(closest_dist_, d_goal);
+    if (d_goal <= goal_th_ && (state_.goal_stoppable || !opt_.extend_to_stable)) {
+        status_ = GENERATE_REACHED;
+        EndRollout();
+        return false;
+    }
+
+    if (!model_.StepRollout(state_, opt_, d_goal, 0, info_)) {
+        status_ = GENERATE_STALLED;
+        EndRollout();
+        return false;
+    }
+    ++num_steps_;
+    return true;
+}
+
+// 停止可能なスプラットまでの延長の1ステップ
+bool GSModelController::StepExtend() {
+    if (num_extend_steps_ >= max_extend_steps || !model_.ExtendRollout(state_, opt_, 0)) {
+        Finish();
+        return false;
+    }
+    ++num_extend_steps_;
+    return true;
+}
+
+// 目標へ向かうステップの終了（extend_to_stable なら延長へ移行）
+void GSModelController::EndRollout() {
+    if (opt_.extend_to_stable) {
+        phase_ = PHASE_EXTEND;
+    } else {
+        Finish();
+    }
+}
+
+// 生成の終了（前進できない・max_steps で終えても目標の許容範囲内に入っていれば到達とみなす、GenerateQ と同じ）
+void GSModelController::Finish() {
+    float d_goal = model_.FKDistance(state_.cur, state_.goal, state_.fk);
+    status_ = GSModel::ResolveStatus(status_, std::min(closest_dist_, d_goal), goal_th_);
+    phase_ = PHASE_FINISHED;
+}
@@ -0,0 +1,55 @@
+﻿#pragma once
+// GSModelController.h : 1フレームずつ動作を生成するコントローラ（ゲームループなどから毎フレーム呼び出す）
+
+// 依存ライブラリ
+#include "GSModel.h"
+
+// 逐次生成コントローラ
+// GSModel::GenerateQ と同じロールアウトを1ステップずつ進める（同じ入力なら GenerateQ と同じ姿勢列になる）
+// Begin で作業領域を確保し、以降の Step・SetGoal ではメモリを確保しない（スプラット数に比例する近傍探索のみ）
+// （GenerateOptions::use_planner では、経路キャッシュにない経路を計画したステップのみ、キャッシュへの登録でメモリを確保する）
+class GSModelController {
+public:
+    // model はコントローラの使用中は呼び出し側で保持してください（model の既定ダンプは使用しない）
+    explicit GSModelController(const GSModel& model);
+
+    // 生成の開始（現在の姿勢を start、時刻を 0 にする）
+    void Begin(const QPosture& start, const QPosture& goal, const GenerateOptions& opt);
+    void Begin(const Posture& start, const Posture& goal, const GenerateOptions& opt);
+
+    // 目標姿勢の変更（現在の姿勢から新しい目標へ向かう、終了済みなら再開）
+    void SetGoal(const QPosture& goal);
+    void SetGoal(const Posture& goal);
+
+    // 1ステップ進めて新しい姿勢を返す（終了済みなら false、pose には最後の姿勢を返す）
+    // 1ステップの時間は GenerateOptions::dt_seconds（前進できない場合はバックオフした dt）
+    bool Step(QPosture& pose, float* time = nullptr);
+    bool Step(Posture& pose, float* time = nullptr);
+
+    bool IsFinished() const { return phase_ == PHASE_FINISHED; }
+    GenerateStatus GetStatus() const { return status_; } // 終了時の状態（終了前は GENERATE_MAX_STEPS）
+    const QPosture& GetPose() const { return state_.cur; }
+    float GetTime() const { return state_.t; }
+    int GetStepCount() const { return num_steps_; }      // 現在の目標へ向かったステップ数（延長を除く）
+    const GenerateStepInfo& GetStepInfo() const { return info_; } // 直前の目標へ向かうステップの情報
+
+private:
+    enum Phase { PHASE_ROLLOUT, PHASE_EXTEND, PHASE_FINISHED };
+
+    const GSModel& model_;
+    GenerateOptions opt_;
+    GenerateRolloutState state_;
+    GenerateStepInfo info_;
+    QPosture qpose_;          // Posture との変換用
+    Phase phase_ = PHASE_FINISHED;
+    GenerateStatus status_ = GENERATE_MAX_STEPS;
+    int num_steps_ = 0;
+    int num_extend_steps_ = 0;
+    float goal_th_ = 0.0f;
+    float closest_dist_ = 0.0f; // 現在の目標に最も近づいた距離（終了時の状態の判定用）
+
+    bool StepRollout();
+    bool StepExtend();
+    void EndRollout();
+    void Finish();
+};
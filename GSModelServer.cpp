@@ -0,0 +1,535 @@
+﻿#include "GSModelServer.h"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+
+using std::vector;
+using std::string;
+
+namespace {
+
+typedef std::chrono::steady_clock clock_type;
+
+inline float elapsed_us(clock_type::time_point t0, clock_type::time_point t1) {
+    return std::chrono::duration<float, std::micro>(t1 - t0).count();
+}
+
+// 指定バイト数の送受信（EINTR は再試行、切断・失敗・受信のタイムアウトは false）
+bool send_all(int fd, const char* p, size_t n) {
+    while (n > 0) {
+        ssize_t r = ::send(fd, p, n, MSG_NOSIGNAL);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return false;
+        p += r;
+        n -= (size_t)r;
+    }
+    return true;
+}
+
+bool recv_all(int fd, char* p, size_t n) {
+    while (n > 0) {
+        ssize_t r = ::recv(fd, p, n, 0);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return false;
+        p += r;
+        n -= (size_t)r;
+    }
+    return true;
+}
+
+bool make_address(const string& path, sockaddr_un& addr) {
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) return false;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+} // namespace
+
+
+// ---------------- メッセージ ----------------
+
+void GSMMessageWriter::PutPosture(const QPosture& p) {
+    int n = p.body ? p.body->num_joints : 0;
+    Put<uint16_t>((uint16_t)n);
+    Put(p.root_pos.x); Put(p.root_pos.y); Put(p.root_pos.z);
+    Put(p.root_ori.x); Put(p.root_ori.y); Put(p.root_ori.z); Put(p.root_ori.w);
+    for (int j = 0; j < n; ++j) {
+        const Quat4f& q = p.joint_rotations[j];
+        Put(q.x); Put(q.y); Put(q.z); Put(q.w);
+    }
+}
+
+void GSMMessageWriter::PutPoseRef(const GSMPoseRef& ref) {
+    Put<uint8_t>(0);
+    Put<uint16_t>((uint16_t)ref.motion);
+    Put(ref.time);
+}
+
+void GSMMessageWriter::PutExplicitPose(const QPosture& p) {
+    Put<uint8_t>(1);
+    PutPosture(p);
+}
+
+bool GSMMessageReader::GetPosture(QPosture& p) {
+    uint16_t n = 0;
+    if (!Get(n) || !p.body || n != p.body->num_joints) { ok_ = false; return false; }
+    Get(p.root_pos.x); Get(p.root_pos.y); Get(p.root_pos.z);
+    Get(p.root_ori.x); Get(p.root_ori.y); Get(p.root_ori.z); Get(p.root_ori.w);
+    for (int j = 0; j < n; ++j) {
+        Quat4f& q = p.joint_rotations[j];
+        Get(q.x); Get(q.y); Get(q.z); Get(q.w);
+    }
+    return ok_;
+}
+
+bool GSMSendMessage(int fd, uint16_t type, uint16_t status, uint32_t request_id, const string& payload) {
+    char header[16];
+    uint32_t magic = GSM_SERVER_MAGIC;
+    uint32_t bytes = (uint32_t)payload.size();
+    std::memcpy(header + 0, &magic, 4);
+    std::memcpy(header + 4, &type, 2);
+    std::memcpy(header + 6, &status, 2);
+    std::memcpy(header + 8, &request_id, 4);
+    std::memcpy(header + 12, &bytes, 4);
+
+    // 小さいメッセージはヘッダとまとめて１回で送信
+    if (payload.size() <= 4096) {
+        string buf(header, sizeof(header));
+        buf += payload;
+        return send_all(fd, buf.data(), buf.size());
+    }
+    return send_all(fd, header, sizeof(header)) && send_all(fd, payload.data(), payload.size());
+}
+
+bool GSMReceiveMessage(int fd, uint16_t& type, uint16_t& status, uint32_t& request_id, string& payload) {
+    char header[16];
+    if (!recv_all(fd, header, sizeof(header))) return false;
+    uint32_t magic = 0, bytes = 0;
+    std::memcpy(&magic, header + 0, 4);
+    std::memcpy(&type, header + 4, 2);
+    std::memcpy(&status, header + 6, 2);
+    std::memcpy(&request_id, header + 8, 4);
+    std::memcpy(&bytes, header + 12, 4);
+    if (magic != GSM_SERVER_MAGIC || bytes > GSM_SERVER_MAX_PAYLOAD) return false;
+    payload.resize(bytes);
+    return bytes == 0 || recv_all(fd, &payload[0], bytes);
+}
+
+
+// ---------------- サーバ ----------------
+
+GSModelServer::GSModelServer(const GSModel& model, const vector<const Motion*>& motions)
+    : model_(model), motions_(motions) {}
+
+GSModelServer::~GSModelServer() {
+    Stop();
+    for (auto& w : workers_) {
+        if (w.joinable()) w.join();
+    }
+    if (listen_fd_ >= 0) {
+        ::close(listen_fd_);
+        ::unlink(socket_path_.c_str());
+    }
+}
+
+bool GSModelServer::Start(const string& socket_path, int num_threads) {
+    sockaddr_un addr;
+    if (listen_fd_ >= 0 || !make_address(socket_path, addr)) return false;
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return false;
+    ::unlink(socket_path.c_str());
+    if (::bind(fd, (const sockaddr*)&addr, sizeof(addr)) < 0 || ::listen(fd, 64) < 0) {
+        ::close(fd);
+        return false;
+    }
+    listen_fd_ = fd;
+    socket_path_ = socket_path;
+    stopping_ = false;
+
+    if (num_threads <= 0)
+        num_threads = std::max(1, (int)std::thread::hardware_concurrency());
+    for (int i = 0; i < num_threads; ++i)
+        workers_.emplace_back(&GSModelServer::WorkerLoop, this);
+    return true;
+}
+
+void GSModelServer::Run() {
+    while (!stopping_) {
+        int fd = ::accept(listen_fd_, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            break; // Stop で待ち受けを閉じた
+        }
+        // 受信のタイムアウト（要求を送らないクライアントがワーカを占有し続けないようにする）
+        timeval tv;
+        tv.tv_sec = GSM_SERVER_RECV_TIMEOUT_MS / 1000;
+        tv.tv_usec = (GSM_SERVER_RECV_TIMEOUT_MS % 1000) * 1000;
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        std::lock_guard<std::mutex> lock(conn_mutex_);
+        if (stopping_) {
+            ::close(fd);
+            break;
+        }
+        pending_.push_back(fd);
+        ++num_connections_;
+        conn_cv_.notify_one();
+    }
+
+    Stop();
+    for (auto& w : workers_) w.join();
+    workers_.clear();
+}
+
+void GSModelServer::Stop() {
+    std::lock_guard<std::mutex> lock(conn_mutex_);
+    if (stopping_.exchange(true)) return;
+
+    // accept・recv で待っているスレッドを起こす（送信中の応答はそのまま完了させる）
+    if (listen_fd_ >= 0) ::shutdown(listen_fd_, SHUT_RDWR);
+    for (int fd : active_) ::shutdown(fd, SHUT_RD);
+    for (int fd : pending_) ::close(fd);
+    pending_.clear();
+    conn_cv_.notify_all();
+}
+
+void GSModelServer::WorkerLoop() {
+    for (;;) {
+        int fd;
+        {
+            std::unique_lock<std::mutex> lock(conn_mutex_);
+            conn_cv_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+            if (stopping_) return;
+            fd = pending_.front();
+            pending_.pop_front();
+            active_.insert(fd);
+        }
+        ServeConnection(fd);
+        {
+            std::lock_guard<std::mutex> lock(conn_mutex_);
+            active_.erase(fd);
+        }
+        ::close(fd);
+    }
+}
+
+void GSModelServer::ServeConnection(int fd) {
+    string payload, response;
+    uint16_t type = 0, status = 0;
+    uint32_t request_id = 0;
+
+    while (GSMReceiveMessage(fd, type, status, request_id, payload)) {
+        auto t0 = clock_type::now();
+        float generate_us = 0.0f;
+        response.clear();
+        status = HandleRequest(type, payload, response, generate_us);
+        if (status != GSM_STATUS_OK) response.clear();
+        bool sent = GSMSendMessage(fd, type, status, request_id, response);
+        RecordRequest(elapsed_us(t0, clock_type::now()), status, type, generate_us);
+        if (!sent) break;
+        if (type == GSM_REQ_SHUTDOWN && status == GSM_STATUS_OK) {
+            Stop();
+            break;
+        }
+    }
+}
+
+// サンプル動作の参照が有効か（時刻が有限でない・範囲外の場合は、フレーム番号への変換が未定義になるため拒否）
+static bool valid_motion_time(const Motion* motion, float time) {
+    return std::isfinite(time) && time >= 0.0f && time <= motion->num_frames * motion->interval;
+}
+
+bool GSModelServer::ResolvePose(GSMMessageReader& reader, QPosture& p) const {
+    uint8_t kind = 0;
+    if (!reader.Get(kind)) return false;
+    if (kind == 1) return reader.GetPosture(p);
+
+    uint16_t motion = 0;
+    float time = 0.0f;
+    if (kind != 0 || !reader.Get(motion) || !reader.Get(time)) return false;
+    if (motion >= motions_.size() || motions_[motion]->body != p.body) return false;
+    if (!valid_motion_time(motions_[motion], time)) return false;
+    Posture posture(p.body);
+    motions_[motion]->GetPosture(time, posture);
+    p.SetPosture(posture);
+    return true;
+}
+
+uint16_t GSModelServer::HandleRequest(uint16_t type, const string& payload, string& response, float& generate_us) {
+    const Skeleton* body = model_.GetHumanBody().GetSkeleton();
+    GSMMessageReader reader(payload.data(), payload.size());
+    GSMMessageWriter writer;
+
+    switch (type) {
+    case GSM_REQ_GENERATE: {
+        GenerateOptions opt;
+        uint8_t interp_mode = 0, extend_to_stable = 1;
+        reader.Get(opt.tempo);
+        reader.Get(opt.dt_seconds);
+        reader.Get(opt.goal_tolerance_m);
+        reader.Get(opt.max_steps);
+        reader.Get(interp_mode);
+        reader.Get(extend_to_stable);
+        if (!reader.ok() || interp_mode > POSTURE_INTERP_FAST_SLERP) return GSM_STATUS_BAD_REQUEST;
+        if (!std::isfinite(opt.tempo) || !(opt.tempo > 0.0f) || !std::isfinite(opt.dt_seconds) || !(opt.dt_seconds > 0.0f) ||
+            !std::isfinite(opt.goal_tolerance_m) || !(opt.goal_tolerance_m >= 0.0f)) {
+            return GSM_STATUS_BAD_REQUEST;
+        }
+        opt.max_steps = std::max(0, std::min(opt.max_steps, GSM_SERVER_MAX_STEPS));
+        opt.interp_mode = (PostureInterpolationMode)interp_mode;
+        opt.extend_to_stable = (extend_to_stable != 0);
+
+        QPosture start(body), goal(body);
+        if (!ResolvePose(reader, start) || !ResolvePose(reader, goal)) return GSM_STATUS_BAD_POSE;
+        if (!reader.AtEnd()) return GSM_STATUS_BAD_REQUEST;
+
+        vector<float> times;
+        vector<QPosture> poses;
+        auto t0 = clock_type::now();
+        try {
+            model_.GenerateQ(start, goal, opt, times, poses);
+        } catch (const std::exception& e) {
+            std::cerr << "[GSModelServer] " << e.what() << std::endl;
+            return GSM_STATUS_FAILED;
+        }
+        generate_us = elapsed_us(t0, clock_type::now());
+
+        int n = body->num_joints;
+        writer.data.reserve(12 + times.size() * (sizeof(float) * (8 + 4 * n) + 2));
+        writer.Put<uint32_t>((uint32_t)generate_us);
+        writer.Put<uint32_t>((uint32_t)times.size());
+        writer.Put<uint16_t>((uint16_t)n);
+        for (size_t i = 0; i < times.size(); ++i) {
+            writer.Put(times[i]);
+            writer.Put(poses[i].root_pos.x); writer.Put(poses[i].root_pos.y); writer.Put(poses[i].root_pos.z);
+            writer.Put(poses[i].root_ori.x); writer.Put(poses[i].root_ori.y);
+            writer.Put(poses[i].root_ori.z); writer.Put(poses[i].root_ori.w);
+            for (int j = 0; j < n; ++j) {
+                const Quat4f& q = poses[i].joint_rotations[j];
+                writer.Put(q.x); writer.Put(q.y); writer.Put(q.z); writer.Put(q.w);
+            }
+        }
+        break;
+    }
+    case GSM_REQ_POSE: {
+        uint16_t motion = 0;
+        float time = 0.0f;
+        reader.Get(motion);
+        reader.Get(time);
+        if (!reader.ok() || !reader.AtEnd()) return GSM_STATUS_BAD_REQUEST;
+        if (motion >= motions_.size() || motions_[motion]->body != body) return GSM_STATUS_BAD_POSE;
+        if (!valid_motion_time(motions_[motion], time)) return GSM_STATUS_BAD_POSE;
+        Posture posture(body);
+        motions_[motion]->GetPosture(time, posture);
+        writer.PutPosture(QPosture(posture));
+        break;
+    }
+    case GSM_REQ_STATS: {
+        if (!payload.empty()) return GSM_STATUS_BAD_REQUEST;
+        GSMServerStats s = GetStats();
+        writer.Put(s.num_requests);
+        writer.Put(s.num_errors);
+        writer.Put(s.num_active_clients);
+        writer.Put(s.num_connections);
+        writer.Put(s.latency_mean_us);
+        writer.Put(s.latency_p50_us);
+        writer.Put(s.latency_p90_us);
+        writer.Put(s.latency_p99_us);
+        writer.Put(s.latency_max_us);
+        writer.Put(s.generate_mean_us);
+        break;
+    }
+    case GSM_REQ_SHUTDOWN:
+        if (!payload.empty()) return GSM_STATUS_BAD_REQUEST;
+        break;
+    default:
+        return GSM_STATUS_BAD_REQUEST;
+    }
+    response.swap(writer.data);
+    return GSM_STATUS_OK;
+}
+
+void GSModelServer::RecordRequest(float latency_us, uint16_t status, uint16_t type, float generate_us) {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    ++num_requests_;
+    if (status != GSM_STATUS_OK) ++num_errors_;
+    if (type == GSM_REQ_GENERATE && status == GSM_STATUS_OK) {
+        generate_sum_us_ += generate_us;
+        ++num_generates_;
+    }
+    if (latencies_us_.size() < latency_window) {
+        latencies_us_.push_back(latency_us);
+    } else {
+        latencies_us_[latency_next_] = latency_us;
+        latency_next_ = (latency_next_ + 1) % latency_window;
+    }
+}
+
+GSMServerStats GSModelServer::GetStats() const {
+    GSMServerStats s;
+    vector<float> lat;
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        s.num_requests = num_requests_;
+        s.num_errors = num_errors_;
+        s.num_connections = num_connections_;
+        s.generate_mean_us = num_generates_ ? (float)(generate_sum_us_ / num_generates_) : 0.0f;
+        lat = latencies_us_;
+    }
+    {
+        std::lock_guard<std::mutex> lock(conn_mutex_);
+        s.num_active_clients = (uint32_t)active_.size();
+    }
+    if (lat.empty()) return s;
+
+    double sum = 0.0;
+    for (float v : lat) sum += v;
+    s.latency_mean_us = (float)(sum / lat.size());
+    auto percentile = [&lat](double q) {
+        size_t k = std::min(lat.size() - 1, (size_t)(q * lat.size()));
+        std::nth_element(lat.begin(), lat.begin() + k, lat.end());
+        return lat[k];
+    };
+    s.latency_p50_us = percentile(0.50);
+    s.latency_p90_us = percentile(0.90);
+    s.latency_p99_us = percentile(0.99);
+    s.latency_max_us = *std::max_element(lat.begin(), lat.end());
+    return s;
+}
+
+
+// ---------------- クライアント ----------------
+
+bool GSModelClient::Connect(const string& socket_path) {
+    sockaddr_un addr;
+    Close();
+    if (!make_address(socket_path, addr)) return false;
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return false;
+    if (::connect(fd, (const sockaddr*)&addr, sizeof(addr)) < 0) {
+        ::close(fd);
+        return false;
+    }
+    fd_ = fd;
+    return true;
+}
+
+void GSModelClient::Close() {
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+}
+
+int GSModelClient::Call(uint16_t type, const string& payload, string& response) {
+    uint32_t id = next_id_++;
+    uint16_t r_type = 0, r_status = 0;
+    uint32_t r_id = 0;
+    if (fd_ < 0 || !GSMSendMessage(fd_, type, 0, id, payload) ||
+        !GSMReceiveMessage(fd_, r_type, r_status, r_id, response) || r_type != type || r_id != id) {
+        Close();
+        return -1;
+    }
+    return r_status;
+}
+
+static void put_generate_options(GSMMessageWriter& w, const GenerateOptions& opt) {
+    w.Put(opt.tempo);
+    w.Put(opt.dt_seconds);
+    w.Put(opt.goal_tolerance_m);
+    w.Put<int32_t>(opt.max_steps);
+    w.Put<uint8_t>((uint8_t)opt.interp_mode);
+    w.Put<uint8_t>(opt.extend_to_stable ? 1 : 0);
+}
+
+int GSModelClient::Generate(const GSMPoseRef& start, const GSMPoseRef& goal, const GenerateOptions& opt,
+                            const Skeleton* body, vector<float>& times, vector<QPosture>& poses,
+                            float* generate_us) {
+    GSMMessageWriter w;
+    put_generate_options(w, opt);
+    w.PutPoseRef(start);
+    w.PutPoseRef(goal);
+    return Generate(w.data, body, times, poses, generate_us);
+}
+
+int GSModelClient::Generate(const QPosture& start, const QPosture& goal, const GenerateOptions& opt,
+                            vector<float>& times, vector<QPosture>& poses, float* generate_us) {
+    GSMMessageWriter w;
+    put_generate_options(w, opt);
+    w.PutExplicitPose(start);
+    w.PutExplicitPose(goal);
+    return Generate(w.data, start.body, times, poses, generate_us);
+}
+
+int GSModelClient::Generate(const string& payload, const Skeleton* body, vector<float>& times,
+                            vector<QPosture>& poses, float* generate_us) {
+    string response;
+    int status = Call(GSM_REQ_GENERATE, payload, response);
+    if (status != GSM_STATUS_OK) return status;
+
+    GSMMessageReader r(response.data(), response.size());
+    uint32_t g_us = 0, num_keys = 0;
+    uint16_t n = 0;
+    r.Get(g_us);
+    r.Get(num_keys);
+    r.Get(n);
+    if (!r.ok() || !body || n != body->num_joints) return -1;
+    // キー数は残りのバイト数と一致する場合のみ信用する（不正な応答で巨大な確保をしない）
+    if ((uint64_t)num_keys * (32u + 16u * n) != r.Remaining()) return -1;
+    if (generate_us) *generate_us = (float)g_us;
+
+    times.resize(num_keys);
+    poses.resize(num_keys);
+    for (uint32_t i = 0; i < num_keys; ++i) {
+        QPosture& p = poses[i];
+        if (p.body != body) p.Init(body);
+        r.Get(times[i]);
+        r.Get(p.root_pos.x); r.Get(p.root_pos.y); r.Get(p.root_pos.z);
+        r.Get(p.root_ori.x); r.Get(p.root_ori.y); r.Get(p.root_ori.z); r.Get(p.root_ori.w);
+        for (int j = 0; j < n; ++j) {
+            Quat4f& q = p.joint_rotations[j];
+            r.Get(q.x); r.Get(q.y); r.Get(q.z); r.Get(q.w);
+        }
+    }
+    return (r.ok() && r.AtEnd()) ? GSM_STATUS_OK : -1;
+}
+
+int GSModelClient::GetPose(const GSMPoseRef& ref, QPosture& p) {
+    GSMMessageWriter w;
+    w.Put<uint16_t>((uint16_t)ref.motion);
+    w.Put(ref.time);
+    string response;
+    int status = Call(GSM_REQ_POSE, w.data, response);
+    if (status != GSM_STATUS_OK) return status;
+    GSMMessageReader r(response.data(), response.size());
+    return (r.GetPosture(p) && r.AtEnd()) ? GSM_STATUS_OK : -1;
+}
+
+int GSModelClient::GetStats(GSMServerStats& s) {
+    string response;
+    int status = Call(GSM_REQ_STATS, string(), response);
+    if (status != GSM_STATUS_OK) return status;
+    GSMMessageReader r(response.data(), response.size());
+    r.Get(s.num_requests);
+    r.Get(s.num_errors);
+    r.Get(s.num_active_clients);
+    r.Get(s.num_connections);
+    r.Get(s.latency_mean_us);
+    r.Get(s.latency_p50_us);
+    r.Get(s.latency_p90_us);
+    r.Get(s.latency_p99_us);
+    r.Get(s.latency_max_us);
+    r.Get(s.generate_mean_us);
+    return (r.ok() && r.AtEnd()) ? GSM_STATUS_OK : -1;
+}
+
+int GSModelClient::Shutdown() {
+    string response;
+    return Call(GSM_REQ_SHUTDOWN, string(), response);
+}
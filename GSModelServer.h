@@ -0,0 +1,205 @@
+﻿#pragma once
+// GSModelServer.h : 学習済み GSModel を常駐させて Generate を提供するサーバ（Unixドメインソケット）
+
+// 依存ライブラリ
+#include <vector>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <set>
+#include <cstdint>
+#include <cstring>
+
+#include "GSModel.h"
+
+// -------------- プロトコル --------------
+//
+// * 要求・応答ともに 16 バイトのヘッダ＋ペイロード（数値はホストのバイトオーダ、float は IEEE754）
+//   - magic(u32) type(u16) status(u16) request_id(u32) payload_bytes(u32)
+//   - 応答の type・request_id は要求と同じ、status は GSMServerStatus
+//   - １つの接続で複数の要求を順番に送ってよい（応答は要求の順番に返る）
+//   - 接続は GSM_SERVER_RECV_TIMEOUT_MS 以上受信がなければ（要求の間の待ちを含む）サーバから閉じられる
+//     閉じられた後の要求は失敗するので、クライアントは接続し直すこと
+//
+// * 姿勢（GSMPoseRef / 明示的な姿勢）
+//   - kind(u8) = 0: サーバが保持するサンプル動作の参照  motion(u16) time(f32)
+//   - kind(u8) = 1: 明示的な姿勢  num_joints(u16) root_pos(f32x3) root_ori(f32x4) joint_rotations(f32x4 x num_joints)
+//
+// * GSM_REQ_GENERATE
+//   - 要求: tempo(f32) dt_seconds(f32) goal_tolerance_m(f32) max_steps(i32) interp_mode(u8) extend_to_stable(u8)
+//           開始姿勢 目標姿勢
+//     tempo・dt_seconds は正、goal_tolerance_m は 0 以上の有限の値、max_steps は GSM_SERVER_MAX_STEPS までに制限
+//     サンプル動作の参照の time は 0 以上・動作の長さ以下
+//   - 応答: generate_us(u32) num_keys(u32) num_joints(u16)
+//           num_keys 回: time(f32) root_pos(f32x3) root_ori(f32x4) joint_rotations(f32x4 x num_joints)
+// * GSM_REQ_POSE     : 要求: motion(u16) time(f32)  応答: 明示的な姿勢（kind なし）
+// * GSM_REQ_STATS    : 要求: なし  応答: GSMServerStats を順番に（u64 x 2, u32 x 2, f32 x 6）
+// * GSM_REQ_SHUTDOWN : 要求: なし  応答: なし（応答後にサーバを停止）
+//
+// ------------------------------------
+
+const uint32_t GSM_SERVER_MAGIC = 0x51534D47;          // "GMSQ"
+const uint32_t GSM_SERVER_MAX_PAYLOAD = 64u << 20;    // ペイロードの上限（不正な要求の検出用）
+const int32_t  GSM_SERVER_MAX_STEPS = 1200;           // 要求の max_steps の上限（１つの要求がワーカを占有する時間の制限、40秒@30Hz）
+const int      GSM_SERVER_RECV_TIMEOUT_MS = 5000;     // 受信のタイムアウト（待機中の接続がワーカを占有する時間の制限）
+
+enum GSMServerRequestType : uint16_t {
+    GSM_REQ_GENERATE = 1,
+    GSM_REQ_POSE     = 2,
+    GSM_REQ_STATS    = 3,
+    GSM_REQ_SHUTDOWN = 4
+};
+
+enum GSMServerStatus : uint16_t {
+    GSM_STATUS_OK          = 0,
+    GSM_STATUS_BAD_REQUEST = 1,  // 不明な type・ペイロードの長さが不正・生成のオプションが不正
+    GSM_STATUS_BAD_POSE    = 2,  // 姿勢の参照（動作の番号・時刻）が範囲外・関節数の不一致
+    GSM_STATUS_FAILED      = 3   // Generate が例外を送出
+};
+
+// 姿勢の参照（サーバが保持するサンプル動作の motion 番目の動作の time 秒の姿勢）
+struct GSMPoseRef {
+    int   motion = 0;
+    float time = 0.0f;
+};
+
+// サーバの統計（レイテンシは要求の受信完了から応答の送信完了まで、直近の要求のみ）
+struct GSMServerStats {
+    uint64_t num_requests = 0;       // 処理した要求数（全種類）
+    uint64_t num_errors = 0;         // status != OK の応答数
+    uint32_t num_active_clients = 0; // 接続中のクライアント数
+    uint32_t num_connections = 0;    // 累計の接続数
+    float    latency_mean_us = 0.0f;
+    float    latency_p50_us = 0.0f;
+    float    latency_p90_us = 0.0f;
+    float    latency_p99_us = 0.0f;
+    float    latency_max_us = 0.0f;
+    float    generate_mean_us = 0.0f; // Generate のみの平均時間
+};
+
+// メッセージの組み立て・解析（ホストのバイトオーダで詰めて格納）
+class GSMMessageWriter {
+public:
+    std::string data;
+
+    template <class T> void Put(T v) { data.append(reinterpret_cast<const char*>(&v), sizeof(T)); }
+    void PutPosture(const QPosture& p);          // 明示的な姿勢（kind なし）
+    void PutPoseRef(const GSMPoseRef& ref);      // kind = 0
+    void PutExplicitPose(const QPosture& p);     // kind = 1
+};
+
+class GSMMessageReader {
+public:
+    GSMMessageReader(const char* begin, size_t size) : cur_(begin), end_(begin + size) {}
+
+    template <class T> bool Get(T& v) {
+        if ((size_t)(end_ - cur_) < sizeof(T)) { ok_ = false; return false; }
+        std::memcpy(&v, cur_, sizeof(T));
+        cur_ += sizeof(T);
+        return true;
+    }
+    bool GetPosture(QPosture& p);  // p.body の関節数と一致しなければ失敗
+    bool ok() const { return ok_; }
+    bool AtEnd() const { return cur_ == end_; }
+    size_t Remaining() const { return (size_t)(end_ - cur_); }
+
+private:
+    const char* cur_;
+    const char* end_;
+    bool ok_ = true;
+};
+
+// ヘッダ付きのメッセージの送受信（EINTR は再試行、失敗・切断・受信のタイムアウト（SO_RCVTIMEO）は false）
+bool GSMSendMessage(int fd, uint16_t type, uint16_t status, uint32_t request_id, const std::string& payload);
+bool GSMReceiveMessage(int fd, uint16_t& type, uint16_t& status, uint32_t& request_id, std::string& payload);
+
+// サーバ
+// 受け付けた接続をワーカスレッドに割り当て、各ワーカは接続が閉じるまでその接続の要求を処理する
+// （ワーカ数を超える接続は、空いたワーカから順番に処理される）
+// 要求を送らずに接続を保持しているクライアントもワーカを占有するため、同時に処理できる接続はワーカ数まで
+// 待機中の接続は GSM_SERVER_RECV_TIMEOUT_MS で閉じ、後続の接続が待たされる時間をその程度に抑える
+class GSModelServer {
+public:
+    // model・motions はサーバの停止まで呼び出し側で保持してください
+    // 並行して Generate を呼ぶため、model の既定ダンプ（SetDefaultDump）は無効にしておくこと
+    GSModelServer(const GSModel& model, const std::vector<const Motion*>& motions);
+    ~GSModelServer();
+
+    // ソケットを作成して待ち受けを開始（既存のソケットファイルは削除、num_threads が 0 ならハードウェアのスレッド数）
+    bool Start(const std::string& socket_path, int num_threads = 0);
+
+    // 停止まで接続を受け付け（Stop または GSM_REQ_SHUTDOWN で戻る）
+    void Run();
+
+    // 停止（他のスレッドから呼び出し可、処理中の要求は応答してから終了）
+    void Stop();
+
+    GSMServerStats GetStats() const;
+
+private:
+    const GSModel& model_;
+    std::vector<const Motion*> motions_;
+    std::string socket_path_;
+    int listen_fd_ = -1;
+    std::atomic<bool> stopping_{false};
+
+    // ワーカスレッドと接続の待ち行列
+    std::vector<std::thread> workers_;
+    std::deque<int> pending_;
+    std::set<int> active_;
+    mutable std::mutex conn_mutex_;
+    std::condition_variable conn_cv_;
+
+    // 統計（レイテンシは直近 latency_window 件のリングバッファ）
+    static const size_t latency_window = 65536;
+    mutable std::mutex stats_mutex_;
+    std::vector<float> latencies_us_;
+    size_t latency_next_ = 0;
+    uint64_t num_requests_ = 0;
+    uint64_t num_errors_ = 0;
+    uint32_t num_connections_ = 0;
+    double generate_sum_us_ = 0.0;
+    uint64_t num_generates_ = 0;
+
+    void WorkerLoop();
+    void ServeConnection(int fd);
+    uint16_t HandleRequest(uint16_t type, const std::string& payload, std::string& response, float& generate_us);
+    bool ResolvePose(GSMMessageReader& reader, QPosture& p) const;
+    void RecordRequest(float latency_us, uint16_t status, uint16_t type, float generate_us);
+};
+
+// クライアント（１つの接続で要求を順番に送る、スレッドごとに別のインスタンスを使用）
+class GSModelClient {
+public:
+    GSModelClient() {}
+    ~GSModelClient() { Close(); }
+
+    bool Connect(const std::string& socket_path);
+    void Close();
+    bool IsConnected() const { return fd_ >= 0; }
+
+    // 生成（start・goal は GSMPoseRef または明示的な姿勢、戻り値は応答の status、通信の失敗は -1）
+    // poses は body の骨格で初期化される
+    int Generate(const GSMPoseRef& start, const GSMPoseRef& goal, const GenerateOptions& opt,
+                 const Skeleton* body, std::vector<float>& times, std::vector<QPosture>& poses,
+                 float* generate_us = nullptr);
+    int Generate(const QPosture& start, const QPosture& goal, const GenerateOptions& opt,
+                 std::vector<float>& times, std::vector<QPosture>& poses, float* generate_us = nullptr);
+
+    // サンプル動作の姿勢の取得（p.body の骨格で受け取る）
+    int GetPose(const GSMPoseRef& ref, QPosture& p);
+
+    int GetStats(GSMServerStats& stats);
+    int Shutdown();
+
+private:
+    int fd_ = -1;
+    uint32_t next_id_ = 1;
+
+    int Call(uint16_t type, const std::string& payload, std::string& response);
+    int Generate(const std::string& payload, const Skeleton* body, std::vector<float>& times,
+                 std::vector<QPosture>& poses, float* generate_us);
+};
@@ -15,9 +15,22 @@
 #include "BVH.h"
 #include "HumanBody.h"
 
+#include "MotionLibrary.h"
+
 #include "GSModel.h"
+#include "GSModelTest.h"
 //#include "GSModelApp.h"
 
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <set>
+
 using namespace  std;
 
 
@@ -28,6 +41,10 @@ void  SetPrimaryBodyPartsRikiya( HumanBody * hb );
 // ログを出力するディレクトリの設定
 string  gsm_dump_directory( "gs_dump" );
 
+// サンプル動作データのBVHファイルのスケール・階層構造（生成動作のBVH出力に使用）
+const float  sample_bvh_scale = 0.025f;
+string  sample_layout_file;
+
 
 //
 //  ログを出力するディレクトリの設定
@@ -45,33 +62,36 @@ void  LoadSampleMotions( std::vector< const Motion * > & sample_motions, const H
 {
 	// サンプル動作の情報（格闘動作）
 	const int  num_sample_motions = 1;
-        const char *  sample_motion_files[ num_sample_motions ] = {
-                "motion_rikiya/I25.bvh" // パンチ
-        };
+        const char *  sample_motion_files[ num_sample_motions ] = {
+                "motion_rikiya/I25.bvh" // パンチ
+        };
 	const float  sample_motion_keytimes[ num_sample_motions ][ 2 ] = {
 		{ 0.0f, 1.75f } // パンチ
 	};
 
-	Motion *  new_motion = NULL;
+	MotionLibrary  library;
 	const Skeleton *  skeleton = NULL;
 	HumanBody *  human_body = NULL;
 	Posture *  key_posture = NULL;
 
 	// BVHファイルのスケールの一時変更
 	float  bvh_scale_org = GetBVHScale();
-	SetBVHScale( 0.025f );
-
-	// 動作データの読み込みと登録
-	for ( int i = 0; i < num_sample_motions; i++ )
+	SetBVHScale( sample_bvh_scale );
+
+	// 動作データの並列読み込み（全ての動作データで一つ目の動作データの骨格情報を共有）
+	vector< string >  files( sample_motion_files, sample_motion_files + num_sample_motions );
+	LoadMotionLibrary( files, library );
+	skeleton = library.body;
+	if ( library.file_names.size() > 0 )
+		sample_layout_file = library.file_names[ 0 ];
+	for ( int i = 0; i < library.errors.size(); i++ )
+		cerr << "[LoadSampleMotions] skipped " << library.errors[ i ].file_name << ": " << library.errors[ i ].reason << endl;
+
+	// 動作データの登録
+	for ( int k = 0; k < library.motions.size(); k++ )
 	{
-		// 動作データの読み込み
-		new_motion = LoadAndCoustructBVHMotion( sample_motion_files[ i ], skeleton );
-		if ( !new_motion )
-			continue;
-
-		// 一つ目の動作データの骨格情報を記録
-		if ( !skeleton )
-			skeleton = new_motion->body;
+		Motion *  new_motion = library.motions[ k ];
+		int  i = library.file_indices[ k ];
 
 		// サンプル動作データに追加
 		sample_motions.push_back( new_motion );
@@ -124,6 +144,19 @@ void  SetPrimaryBodyPartsRikiya( HumanBody * hb )
 }
 
 
+//
+//  サンプル動作データの学習オプションの設定（TrainGSModel・ベンチマークで共通、ダンプは設定しない）
+//
+void  SetSampleTrainOptions( TrainOptions & topt )
+{
+    topt.sample_stride    = 1;
+    topt.occ_sigma_m      = 0.05f;
+    topt.merge_radius_m   = 0.03f;
+    topt.stop_v_threshold = 0.15f;
+    topt.build_graph      = true;   // ジョブの planner=1 で使用（スプラット数が少ないため常に作成）
+}
+
+
 //
 //  モデルの学習
 //
@@ -134,10 +167,7 @@ GSModel *  TrainGSModel( std::vector< const Motion * > & sample_motions, const H
 
 	// 学習オプション設定
     TrainOptions  topt;
-    topt.sample_stride    = 1;
-    topt.occ_sigma_m      = 0.05f;
-    topt.merge_radius_m   = 0.03f;
-    topt.stop_v_threshold = 0.15f;
+    SetSampleTrainOptions( topt );
     topt.dump.enabled = true;
     topt.dump.out_dir = gsm_dump_directory;
 
@@ -182,3 +212,359 @@ KeyframeMotion *  GenerateTestMotion( int no, const std::vector< Posture * > & s
 
 	return  generated_motion;
 }
+
+
+//
+//  生成動作のBVHファイルへの出力（サンプル動作データと同じ階層構造・チャンネル構成）
+//
+bool  SaveGeneratedMotion( const KeyframeMotion * generated_motion, const char * bvh_file_name, float fps )
+{
+	if ( !generated_motion || sample_layout_file.empty() )
+		return  false;
+
+	// 階層構造のみを読み込み
+	BVH  layout;
+	if ( !layout.OpenStream( sample_layout_file.c_str() ) )
+		return  false;
+	layout.CloseStream();
+
+	// BVHファイルのスケールを一時変更して出力
+	float  bvh_scale_org = GetBVHScale();
+	SetBVHScale( sample_bvh_scale );
+	bool  success = SaveBVHKeyframeMotion( bvh_file_name, &layout, *generated_motion, fps );
+	SetBVHScale( bvh_scale_org );
+
+	return  success;
+}
+
+
+//
+//  動作生成ジョブのオプション（key=value）の設定
+//
+static bool  SetGenerateJobOption( GenerateJob & job, const string & key, const string & value )
+{
+	char *  end = NULL;
+	float  v = strtof( value.c_str(), &end );
+	bool  is_number = !value.empty() && ( *end == '\0' );
+
+	if ( key == "interp" )
+	{
+		if ( value == "slerp" )
+			job.options.interp_mode = POSTURE_INTERP_SLERP;
+		else if ( value == "nlerp" )
+			job.options.interp_mode = POSTURE_INTERP_NLERP;
+		else if ( value == "fast" )
+			job.options.interp_mode = POSTURE_INTERP_FAST_SLERP;
+		else
+			return  false;
+		return  true;
+	}
+	if ( key == "search" )
+	{
+		if ( value == "grid" )
+			job.options.alpha_search = ALPHA_SEARCH_GRID;
+		else if ( value == "golden" )
+			job.options.alpha_search = ALPHA_SEARCH_GOLDEN;
+		else
+			return  false;
+		return  true;
+	}
+	if ( !is_number )
+		return  false;
+	if ( key == "dt" )
+		job.options.dt_seconds = v;
+	else if ( key == "tol" )
+		job.options.goal_tolerance_m = v;
+	else if ( key == "max_steps" )
+		job.options.max_steps = (int) v;
+	else if ( key == "extend" )
+		job.options.extend_to_stable = ( v != 0.0f );
+	else if ( key == "v_floor" )
+		job.options.v_floor_mps = v;
+	else if ( key == "stop_th" )
+		job.options.stopability_th = v;
+	else if ( key == "deadline" )
+		job.options.deadline_ms = v;
+	else if ( key == "budget" )
+		job.options.alpha_eval_budget = (int) v;
+	else if ( key == "planner" )
+		job.options.use_planner = ( v != 0.0f );
+	else if ( key == "draft" )
+		job.options.draft_level = (int) v;
+	else if ( key == "trace" )
+		job.save_trace = ( v != 0.0f );
+	else
+		return  false;
+	return  true;
+}
+
+
+//
+//  動作生成ジョブのマニフェストの読み込み
+//
+bool  LoadGenerateJobs( const char * manifest_file_name, std::vector< GenerateJob > & jobs, std::vector< std::string > & errors )
+{
+	ifstream  file( manifest_file_name );
+	if ( !file.is_open() )
+	{
+		errors.push_back( string( "cannot open " ) + manifest_file_name );
+		return  false;
+	}
+
+	set< string >  names;
+	string  line;
+	int  line_no = 0;
+	jobs.clear();
+	while ( getline( file, line ) )
+	{
+		line_no++;
+		size_t  comment = line.find( '#' );
+		if ( comment != string::npos )
+			line.erase( comment );
+
+		// 必須の項目（ジョブ名・開始姿勢・目標姿勢）
+		istringstream  in( line );
+		GenerateJob  job;
+		string  start_time, goal_time;
+		if ( !( in >> job.name ) )
+			continue;
+		char *  end0 = NULL;
+		char *  end1 = NULL;
+		if ( !( in >> job.start_clip >> start_time >> job.goal_clip >> goal_time ) || 
+		     ( ( job.start_time = strtof( start_time.c_str(), &end0 ) ), *end0 != '\0' ) || 
+		     ( ( job.goal_time = strtof( goal_time.c_str(), &end1 ) ), *end1 != '\0' ) )
+		{
+			errors.push_back( "line " + to_string( line_no ) + ": expected name start_clip start_time goal_clip goal_time" );
+			continue;
+		}
+		if ( ( job.name.find_first_of( "/\\:" ) != string::npos ) || ( job.name == "." ) || ( job.name == ".." ) )
+		{
+			errors.push_back( "line " + to_string( line_no ) + ": job name must not contain path separators or be . or .. : " + job.name );
+			continue;
+		}
+		if ( !names.insert( job.name ).second )
+		{
+			errors.push_back( "line " + to_string( line_no ) + ": duplicate job name " + job.name );
+			continue;
+		}
+
+		// テンポ・オプション
+		job.options.dt_seconds = 1.0f / 30.0f;
+		job.options.goal_tolerance_m = 0.02f;
+		job.options.extend_to_stable = true;
+		string  token;
+		bool  valid = true;
+		while ( valid && ( in >> token ) )
+		{
+			size_t  eq = token.find( '=' );
+			if ( eq == string::npos )
+			{
+				char *  end = NULL;
+				job.options.tempo = strtof( token.c_str(), &end );
+				valid = ( *end == '\0' ) && ( job.options.tempo > 0.0f );
+			}
+			else
+				valid = SetGenerateJobOption( job, token.substr( 0, eq ), token.substr( eq + 1 ) );
+		}
+		if ( !valid )
+		{
+			errors.push_back( "line " + to_string( line_no ) + ": invalid tempo or option " + token );
+			continue;
+		}
+		jobs.push_back( job );
+	}
+	return  true;
+}
+
+
+//
+//  サンプル動作の検索（番号または動作名）
+//
+static const Motion *  FindSampleMotion( const std::vector< const Motion * > & sample_motions, const string & clip )
+{
+	if ( !clip.empty() && ( clip.find_first_not_of( "0123456789" ) == string::npos ) )
+	{
+		int  no = atoi( clip.c_str() );
+		return  ( no < sample_motions.size() ) ? sample_motions[ no ] : NULL;
+	}
+	for ( int i = 0; i < sample_motions.size(); i++ )
+		if ( sample_motions[ i ]->name == clip )
+			return  sample_motions[ i ];
+	return  NULL;
+}
+
+
+//
+//  動作生成ジョブの実行結果
+//
+struct  GenerateJobResult
+{
+	bool  success;
+	string  error;
+	int  num_keys;
+	float  duration;
+	float  start_dist;
+	float  final_dist;
+	bool  reached;
+	GenerateStatus  gen_status;
+	double  generate_ms;
+
+	GenerateJobResult() { success = false; num_keys = 0; duration = 0.0f; start_dist = 0.0f; final_dist = 0.0f; reached = false; gen_status = GENERATE_MAX_STEPS; generate_ms = 0.0; }
+};
+
+
+//
+//  動作生成ジョブの並列実行
+//
+int  RunGenerateJobs( const std::vector< GenerateJob > & jobs, const std::vector< const Motion * > & sample_motions, 
+	const GSModel * gsmodel, const char * out_dir, int num_threads )
+{
+	namespace fs = std::filesystem;
+	if ( !gsmodel )
+		return  jobs.size();
+	const Skeleton *  body = gsmodel->GetHumanBody().GetSkeleton();
+	int  num_jobs = jobs.size();
+	vector< GenerateJobResult >  results( num_jobs );
+
+	// BVHファイルのスケールはスレッド間で共有するため、実行中は固定
+	float  bvh_scale_org = GetBVHScale();
+	SetBVHScale( sample_bvh_scale );
+
+	// スレッド数の決定
+	if ( num_threads <= 0 )
+		num_threads = max( 1, (int) thread::hardware_concurrency() );
+	num_threads = min( num_threads, max( 1, num_jobs ) );
+
+	// スレッドプール（各スレッドが未処理のジョブを順番に取り出して実行）
+	atomic< int >  next_job( 0 );
+	auto  worker = [&]()
+	{
+		// 出力の階層構造（BVH::BeginSave の状態を持つため、スレッドごとに読み込み）
+		BVH  layout;
+		bool  has_layout = !sample_layout_file.empty() && layout.OpenStream( sample_layout_file.c_str() );
+		if ( has_layout )
+			layout.CloseStream();
+
+		int  i;
+		while ( ( i = next_job.fetch_add( 1 ) ) < num_jobs )
+		{
+			const GenerateJob &  job = jobs[ i ];
+			GenerateJobResult &  result = results[ i ];
+
+			// 開始・目標姿勢の取得
+			const Motion *  start_motion = FindSampleMotion( sample_motions, job.start_clip );
+			const Motion *  goal_motion = FindSampleMotion( sample_motions, job.goal_clip );
+			if ( !start_motion || !goal_motion || ( start_motion->body != body ) || ( goal_motion->body != body ) )
+			{
+				result.error = "unknown clip";
+				continue;
+			}
+			Posture  start( body ), goal( body );
+			start_motion->GetPosture( job.start_time, start );
+			goal_motion->GetPosture( job.goal_time, goal );
+
+			// 出力ディレクトリの作成
+			string  job_dir = ( fs::path( out_dir ) / job.name ).string();
+			error_code  ec;
+			fs::create_directories( job_dir, ec );
+			if ( ec )
+			{
+				result.error = "cannot create " + job_dir;
+				continue;
+			}
+
+			// 動作生成
+			GenerateOptions  gopt = job.options;
+			gopt.dump.enabled = job.save_trace;
+			gopt.dump.out_dir = job_dir;
+			KeyframeMotion  kf;
+			GenerateResult  gresult;
+			auto  t0 = chrono::steady_clock::now();
+			try
+			{
+				kf = gsmodel->Generate( start, goal, gopt, &gresult );
+			}
+			catch ( const exception & e )
+			{
+				result.error = e.what();
+				continue;
+			}
+			result.generate_ms = chrono::duration< double, milli >( chrono::steady_clock::now() - t0 ).count();
+			result.gen_status = gresult.status;
+
+			// 評価（目標姿勢との FK 距離）
+			result.num_keys = kf.num_keyframes;
+			result.start_dist = gsmodel->FKDistance( start, goal );
+			if ( kf.num_keyframes > 0 )
+			{
+				result.duration = kf.key_times[ kf.num_keyframes - 1 ] - kf.key_times[ 0 ];
+				result.final_dist = gsmodel->FKDistance( kf.key_poses[ kf.num_keyframes - 1 ], goal );
+			}
+
+			// 到達（生成の終了状態、停止可能な姿勢への延長後の最終姿勢は目標から離れることがあるため final_dist では判定しない）
+			result.reached = ( gresult.status == GENERATE_REACHED );
+
+			// 生成動作のBVHファイルへの出力
+			string  bvh_file = ( fs::path( job_dir ) / "gen_motion.bvh" ).string();
+			if ( !has_layout || !SaveBVHKeyframeMotion( bvh_file.c_str(), &layout, kf, 30.0f ) )
+			{
+				result.error = "cannot save " + bvh_file;
+				continue;
+			}
+			result.success = true;
+		}
+	};
+	auto  t_begin = chrono::steady_clock::now();
+	vector< thread >  workers;
+	for ( int t = 1; t < num_threads; t++ )
+		workers.push_back( thread( worker ) );
+	worker();
+	for ( int t = 0; t < workers.size(); t++ )
+		workers[ t ].join();
+	double  wall_ms = chrono::duration< double, milli >( chrono::steady_clock::now() - t_begin ).count();
+
+	SetBVHScale( bvh_scale_org );
+
+	// 全ジョブの結果の出力
+	string  metrics_file = ( fs::path( out_dir ) / "jobs_metrics.csv" ).string();
+	ofstream  metrics( metrics_file );
+	metrics << "name,status,start_clip,start_time,goal_clip,goal_time,tempo,interp,num_keys,duration_s,start_dist_m,final_dist_m,reached,gen_status,generate_ms,error\n";
+	const char *  interp_names[] = { "slerp", "nlerp", "fast" };
+	const char *  gen_status_names[] = { "reached", "max_steps", "stalled", "deadline", "cancelled" };
+	int  num_failed = 0, num_reached = 0;
+	vector< double >  generate_ms;
+	for ( int i = 0; i < num_jobs; i++ )
+	{
+		const GenerateJob &  job = jobs[ i ];
+		const GenerateJobResult &  r = results[ i ];
+		if ( !r.success )
+			num_failed++;
+		else
+			generate_ms.push_back( r.generate_ms );
+		if ( r.reached )
+			num_reached++;
+		metrics << job.name << "," << ( r.success ? "ok" : "failed" ) << ","
+			<< job.start_clip << "," << job.start_time << "," << job.goal_clip << "," << job.goal_time << ","
+			<< job.options.tempo << "," << interp_names[ job.options.interp_mode ] << ","
+			<< r.num_keys << "," << r.duration << "," << r.start_dist << "," << r.final_dist << ","
+			<< ( r.reached ? 1 : 0 ) << "," << ( r.success ? gen_status_names[ r.gen_status ] : "" ) << ","
+			<< r.generate_ms << ",\"" << r.error << "\"\n";
+	}
+	metrics.close();
+
+	// 概要の出力
+	double  sum_ms = 0.0;
+	for ( int i = 0; i < generate_ms.size(); i++ )
+		sum_ms += generate_ms[ i ];
+	sort( generate_ms.begin(), generate_ms.end() );
+	cout << "[JOBS] jobs=" << num_jobs << " ok=" << ( num_jobs - num_failed ) << " failed=" << num_failed
+		<< " reached=" << num_reached << " threads=" << num_threads << " wall_ms=" << wall_ms << endl;
+	if ( !generate_ms.empty() )
+		cout << "[JOBS] generate_ms mean=" << ( sum_ms / generate_ms.size() )
+			<< " p50=" << generate_ms[ generate_ms.size() / 2 ]
+			<< " p99=" << generate_ms[ min( generate_ms.size() - 1, generate_ms.size() * 99 / 100 ) ]
+			<< " max=" << generate_ms.back() << endl;
+	cout << "[JOBS] metrics=" << metrics_file << endl;
+
+	return  num_failed;
+}
@@ -14,9 +14,9 @@
 
 // ライブラリ・クラス定義の読み込み
 #include "SimpleHuman.h"
+#include "GSModel.h"
 
 class  HumanBody;
-class  GSModel;
 
 
 // ログを出力するディレクトリの設定
@@ -28,11 +28,55 @@ void  LoadSampleMotions( std::vector< const Motion * > & sample_motions, const H
 // 骨格の追加情報の設定（Rikiya）
 void  SetPrimaryBodyPartsRikiya( HumanBody * hb );
 
+// サンプル動作データの学習オプションの設定（TrainGSModel・ベンチマークで共通、ダンプは設定しない）
+void  SetSampleTrainOptions( TrainOptions & topt );
+
 // モデルの学習
 GSModel *  TrainGSModel( std::vector< const Motion * > & sample_motions, const HumanBody * sample_body );
 
 // 動作生成テスト
 KeyframeMotion *  GenerateTestMotion( int no, const std::vector< Posture * > & sample_key_poses, GSModel * gsmodel );
 
+// 生成動作のBVHファイルへの出力（サンプル動作データと同じ階層構造・チャンネル構成、指定フレームレートでサンプリング）
+bool  SaveGeneratedMotion( const KeyframeMotion * generated_motion, const char * bvh_file_name, float fps );
+
+
+//
+//  動作生成ジョブ（開始・目標姿勢はサンプル動作の番号または動作名と時刻で指定）
+//
+struct  GenerateJob
+{
+	// ジョブ名（出力ディレクトリ名）
+	std::string  name;
+
+	// 開始・目標姿勢（サンプル動作の番号または動作名、時刻）
+	std::string  start_clip;
+	float  start_time;
+	std::string  goal_clip;
+	float  goal_time;
+
+	// 動作生成オプション（テンポ・補間方式など）
+	GenerateOptions  options;
+
+	// 生成の過程（gen_trace.csv など）を出力するかどうか
+	bool  save_trace;
+
+	// コンストラクタ
+	GenerateJob() { start_time = 0.0f; goal_time = 0.0f; save_trace = true; }
+};
+
+// 動作生成ジョブのマニフェストの読み込み（空行と # 以降は無視、読めない行は errors に追加）
+//  １行に１ジョブ: name start_clip start_time goal_clip goal_time [tempo] [key=value ...]
+//  name は出力ディレクトリ名に使うため、パスの区切り（/ \ :）を含む名前・. と .. は不可
+//  key: interp (slerp/nlerp/fast), search (grid/golden), budget, dt, tol, max_steps, extend (0/1), v_floor, stop_th, deadline (ms),
+//       planner (0/1), draft (スプラットの階層), trace (0/1)
+bool  LoadGenerateJobs( const char * manifest_file_name, std::vector< GenerateJob > & jobs, std::vector< std::string > & errors );
+
+// 動作生成ジョブの並列実行（num_threads が 0 の場合はハードウェアのスレッド数、戻り値は失敗したジョブ数）
+// 各ジョブの出力は out_dir/name/（gen_motion.bvh、trace が有効なら gen_trace.csv など）、全ジョブの結果は out_dir/jobs_metrics.csv
+// （trace が無効なジョブも既定ダンプを継承しないよう、gsmodel の既定ダンプは無効にしておくこと）
+int  RunGenerateJobs( const std::vector< GenerateJob > & jobs, const std::vector< const Motion * > & sample_motions, 
+	const GSModel * gsmodel, const char * out_dir, int num_threads = 0 );
+
 
 #endif // _GS_MODEL_TEST_H_
@@ -21,14 +21,150 @@
 using namespace  std;
 
 #include <filesystem>
+#include <cstring>
+#include <cstdlib>
+
+#ifndef  _WIN32
+#include "GSModelServer.h"
+#include <thread>
+#include <signal.h>
+#include <pthread.h>
+#endif
+
+
+#ifndef  _WIN32
+
+//
+//  常駐サーバとして動作（モデルを１回だけ学習し、Unixドメインソケットで Generate の要求を処理）
+//  cache_mb > 0 なら生成結果のキャッシュ（GSModel::SetResultCache）を使用
+//
+static int  ServeModel( const char * socket_path, int num_threads, int cache_mb )
+{
+	// サンプル動作データの読み込み・モデルの学習
+	std::vector< const Motion * >  sample_motions;
+	const HumanBody *  sample_body;
+	std::vector< Posture * >  sample_key_poses;
+	LoadSampleMotions( sample_motions, &sample_body, sample_key_poses );
+	GSModel *  gsmodel = TrainGSModel( sample_motions, sample_body );
+	if ( !gsmodel )
+		return  1;
+
+	// 並行して生成するため、生成時のダンプは無効にする
+	gsmodel->SetDefaultDump( DumpOptions() );
+
+	// 生成結果のキャッシュ
+	GenerateCacheOptions  cache_opt;
+	cache_opt.max_bytes = (size_t) max( cache_mb, 0 ) << 20;
+	gsmodel->SetResultCache( cache_opt );
+
+	// SIGINT・SIGTERM はシグナル待ちのスレッドで受け取る（全スレッドで先にブロック）
+	sigset_t  signals;
+	sigemptyset( &signals );
+	sigaddset( &signals, SIGINT );
+	sigaddset( &signals, SIGTERM );
+	pthread_sigmask( SIG_BLOCK, &signals, NULL );
+
+	GSModelServer  server( *gsmodel, sample_motions );
+	if ( !server.Start( socket_path, num_threads ) )
+	{
+		std::cerr << "[SERVER] cannot listen on " << socket_path << std::endl;
+		return  1;
+	}
+	std::cout << "[SERVER] listening on " << socket_path << " splats=" << gsmodel->GetSplats().size() << std::endl;
+
+	std::thread  signal_thread( [&]()
+	{
+		int  sig = 0;
+		sigwait( &signals, &sig );
+		server.Stop();
+	} );
+
+	// 停止（シグナルまたは GSM_REQ_SHUTDOWN）まで要求を処理
+	server.Run();
+	pthread_kill( signal_thread.native_handle(), SIGTERM );
+	signal_thread.join();
+
+	// 統計の出力
+	GSMServerStats  stats = server.GetStats();
+	std::cout << "[SERVER] requests=" << stats.num_requests << " errors=" << stats.num_errors
+		<< " connections=" << stats.num_connections << std::endl;
+	std::cout << "[SERVER] latency_us mean=" << stats.latency_mean_us << " p50=" << stats.latency_p50_us
+		<< " p90=" << stats.latency_p90_us << " p99=" << stats.latency_p99_us << " max=" << stats.latency_max_us
+		<< " generate_mean=" << stats.generate_mean_us << std::endl;
+	if ( cache_mb > 0 )
+	{
+		GenerateCacheStats  cache = gsmodel->GetResultCacheStats();
+		std::cout << "[SERVER] cache lookups=" << cache.lookups << " hits=" << cache.hits
+			<< " hit_rate=" << ( cache.lookups > 0 ? 100.0 * cache.hits / cache.lookups : 0.0 ) << "%"
+			<< " entries=" << cache.entries << " bytes=" << cache.bytes << " evictions=" << cache.evictions
+			<< " hit_us_mean=" << cache.hit_us_mean << " miss_us_mean=" << cache.miss_us_mean << std::endl;
+	}
+
+	delete  gsmodel;
+	return  0;
+}
+
+#endif
+
+
+//
+//  動作生成ジョブの一括実行（モデルを１回だけ学習し、マニフェストの全ジョブを並列に実行）
+//
+static int  RunJobs( const char * manifest_file_name, const char * out_dir, int num_threads )
+{
+	namespace fs = std::filesystem;
+
+	// マニフェストの読み込み
+	std::vector< GenerateJob >  jobs;
+	std::vector< std::string >  errors;
+	bool  loaded = LoadGenerateJobs( manifest_file_name, jobs, errors );
+	for ( int i = 0; i < errors.size(); i++ )
+		std::cerr << "[JOBS] " << manifest_file_name << " " << errors[ i ] << std::endl;
+	if ( !loaded )
+		return  1;
+
+	// サンプル動作データの読み込み・モデルの学習（モデルのダンプは出力ディレクトリに出力）
+	try { 
+		fs::create_directories( out_dir ); 
+	} catch (...) {}
+	SetGSMDumpDirectory( out_dir );
+	std::vector< const Motion * >  sample_motions;
+	const HumanBody *  sample_body;
+	std::vector< Posture * >  sample_key_poses;
+	LoadSampleMotions( sample_motions, &sample_body, sample_key_poses );
+	GSModel *  gsmodel = TrainGSModel( sample_motions, sample_body );
+	if ( !gsmodel )
+		return  1;
+
+	// 生成時のダンプはジョブごとに設定する
+	gsmodel->SetDefaultDump( DumpOptions() );
+
+	int  num_failed = RunGenerateJobs( jobs, sample_motions, gsmodel, out_dir, num_threads );
+
+	delete  gsmodel;
+	return  ( ( num_failed == 0 ) && errors.empty() ) ? 0 : 2;
+}
 
 
 
 //
 //  メイン関数（プログラムはここから開始）
+//  app_headless [dump_dir]                         : 学習・動作生成を１回実行
+//  app_headless --serve socket_path [num_threads] [cache_mb] : 常駐サーバとして動作（クライアントは gsm_client）
+//  app_headless --jobs manifest [out_dir] [num_threads] : 動作生成ジョブの一括実行（LoadGenerateJobs の書式）
 //
 int  main( int argc, char ** argv )
 {
+	if ( ( argc > 2 ) && ( strcmp( argv[ 1 ], "--jobs" ) == 0 ) )
+		return  RunJobs( argv[ 2 ], ( argc > 3 ) ? argv[ 3 ] : "jobs_out", ( argc > 4 ) ? atoi( argv[ 4 ] ) : 0 );
+#ifndef  _WIN32
+	if ( ( argc > 2 ) && ( strcmp( argv[ 1 ], "--serve" ) == 0 ) )
+	{
+		SetGSMDumpDirectory( "gs_dump" );
+		return  ServeModel( argv[ 2 ], ( argc > 3 ) ? atoi( argv[ 3 ] ) : 0, ( argc > 4 ) ? atoi( argv[ 4 ] ) : 0 );
+	}
+#endif
+
 	// 全サンプル動作データ
 	std::vector< const Motion * >  sample_motions;
 	
@@ -66,5 +202,10 @@ int  main( int argc, char ** argv )
 
 	// 動作生成テスト
 	generated_motion = GenerateTestMotion( test_input_no, sample_key_poses, gsmodel );
+
+	// 生成動作のBVHファイルへの出力（動作生成の時間刻みと同じ 30fps）
+	std::string  bvh_file = ( fs::path( dump_dir ) / "gen_motion.bvh" ).string();
+	if ( SaveGeneratedMotion( generated_motion, bvh_file.c_str(), 30.0f ) )
+		std::cout << "[HEADLESS] saved " << bvh_file << std::endl;
 }
 
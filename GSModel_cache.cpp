@@ -0,0 +1,236 @@
+﻿#include "GSModel.h"
+
+#include <list>
+#include <mutex>
+#include <chrono>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+
+using std::vector;
+
+// 生成結果のキャッシュ（LRU、先頭が最後に参照した結果）
+//   登録した結果は変更しないため、参照時はロック中に候補のポインタのみを取得し、FK 距離の確認・結果の複製はロックの外で行う
+struct GSModel::ResultCache {
+    struct Entry {
+        uint64_t         hash = 0;
+        vector<int32_t>  key;         // 鍵（ハッシュの衝突の確認用）
+        QPosture         start;       // 生成時の開始・目標姿勢（FK 距離の確認・ルートの変換に使用）
+        QPosture         goal;
+        vector<float>    times;
+        vector<QPosture> poses;
+        GenerateResult   result;
+        size_t           bytes = 0;
+    };
+    typedef std::shared_ptr<const Entry> EntryPtr;
+    typedef std::list<EntryPtr>::iterator EntryIt;
+    GenerateCacheOptions opt;
+    std::mutex mutex;
+    std::list<EntryPtr> lru;
+    std::unordered_multimap<uint64_t, EntryIt> index;  // 同じ鍵で開始・目標姿勢が異なる結果は複数登録
+    size_t bytes = 0;
+    long long lookups = 0;
+    long long hits = 0;
+    long long evictions = 0;
+    double hit_us_sum = 0.0;
+    float  hit_us_max = 0.0f;
+    double miss_us_sum = 0.0;
+
+    void EraseIndex(const EntryIt& e) {
+        auto range = index.equal_range((*e)->hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == e) {
+                index.erase(it);
+                return;
+            }
+        }
+    }
+
+    // 登録済みの結果を最後に参照した結果にする（参照中に破棄されていれば何もしない）
+    void Touch(const EntryPtr& e) {
+        auto range = index.equal_range(e->hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (*it->second == e) {
+                lru.splice(lru.begin(), lru, it->second);
+                return;
+            }
+        }
+    }
+};
+
+// 量子化（幅 step の格子の番号）
+static inline int32_t quantize(float v, float step) {
+    return (int32_t)std::lround(v / step);
+}
+
+// 浮動小数点数のオプションはビット列をそのまま鍵に使う（設定値なので量子化しない）
+static int32_t float_bits(float v) {
+    int32_t b;
+    std::memcpy(&b, &v, sizeof(b));
+    return b;
+}
+
+// FNV-1a
+static uint64_t hash_key(const vector<int32_t>& key) {
+    uint64_t h = 1469598103934665603ull;
+    for (int32_t v : key) {
+        uint32_t u = (uint32_t)v;
+        for (int b = 0; b < 4; ++b) {
+            h ^= (u >> (8 * b)) & 0xffu;
+            h *= 1099511628211ull;
+        }
+    }
+    return h;
+}
+
+void GSModel::SetResultCache(const GenerateCacheOptions& opt) {
+    if (opt.max_bytes == 0) {
+        result_cache_.reset();
+        return;
+    }
+    result_cache_ = std::make_shared<ResultCache>();
+    result_cache_->opt = opt;
+}
+
+GenerateCacheStats GSModel::GetResultCacheStats() const {
+    GenerateCacheStats stats;
+    if (!result_cache_) return stats;
+    ResultCache& C = *result_cache_;
+    std::lock_guard<std::mutex> lock(C.mutex);
+    stats.lookups = C.lookups;
+    stats.hits = C.hits;
+    stats.evictions = C.evictions;
+    stats.entries = C.lru.size();
+    stats.bytes = C.bytes;
+    stats.max_bytes = C.opt.max_bytes;
+    stats.hit_us_mean = (C.hits > 0) ? float(C.hit_us_sum / C.hits) : 0.0f;
+    stats.hit_us_max = C.hit_us_max;
+    stats.miss_us_mean = (C.lookups > C.hits) ? float(C.miss_us_sum / (C.lookups - C.hits)) : 0.0f;
+    return stats;
+}
+
+void GSModel::GenerateCached(const QPosture& start, const QPosture& goal, const GenerateOptions& opt,
+                             vector<float>& times, vector<QPosture>& poses, GenerateResult* result) const {
+    if (!IsCompatible(start) || !IsCompatible(goal)) {
+        throw std::runtime_error("GSModel::Generate: Skeleton mismatch in input Posture.");
+    }
+    typedef std::chrono::steady_clock clock_type;
+    const clock_type::time_point t_begin = clock_type::now();
+    ResultCache& C = *result_cache_;
+
+    // 鍵（結果に影響しない deadline_ms・batch_candidates・dump は含めない）
+    //   関節回転を格子で量子化すると、わずかな違いでも多数の次元のいずれかが境界を越えて別の鍵になるため、
+    //   姿勢は最近傍スプラットで量子化し、同じ鍵の結果の中から FK 距離で確認する
+    FKWorkspace ws;
+    vector<int32_t> key;
+    key.reserve(16);
+    key.push_back(quantize(opt.tempo, C.opt.tempo_step));
+    key.push_back(float_bits(opt.dt_seconds));
+    key.push_back(float_bits(opt.goal_tolerance_m));
+    key.push_back(float_bits(opt.stopability_th));
+    key.push_back(float_bits(opt.v_floor_mps));
+    key.push_back(opt.max_steps);
+    key.push_back(opt.extend_to_stable);
+    key.push_back(opt.interp_mode);
+    key.push_back(opt.alpha_search);
+    key.push_back(opt.alpha_eval_budget);
+    key.push_back(opt.use_planner);
+    key.push_back(opt.use_horizon);
+    key.push_back(opt.draft_level);
+    key.push_back(FindNearestSplat(start, nullptr, ws));
+    key.push_back(FindNearestSplat(goal, nullptr, ws));
+    key.push_back(quantize(goal.root_pos.x - start.root_pos.x, C.opt.pos_step_m));
+    key.push_back(quantize(goal.root_pos.y - start.root_pos.y, C.opt.pos_step_m));
+    key.push_back(quantize(goal.root_pos.z - start.root_pos.z, C.opt.pos_step_m));
+    const uint64_t hash = hash_key(key);
+
+    // 参照（同じ鍵の結果のうち開始・目標姿勢の FK 距離の和が最小のもの、ヒットすれば結果を複製し、
+    //   生成時の開始姿勢のルートから start のルートへの剛体変換を適用）
+    vector<ResultCache::EntryPtr> candidates;
+    {
+        std::lock_guard<std::mutex> lock(C.mutex);
+        ++C.lookups;
+        auto range = C.index.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) candidates.push_back(*it->second);
+    }
+    ResultCache::EntryPtr best;
+    float best_d = std::numeric_limits<float>::infinity();
+    for (const ResultCache::EntryPtr& E : candidates) {
+        if (E->key != key) continue;
+        float d_start = FKDistance(start, E->start, ws);
+        float d_goal = FKDistance(goal, E->goal, ws);
+        if (d_start <= C.opt.match_m && d_goal <= C.opt.match_m && d_start + d_goal < best_d) {
+            best = E;
+            best_d = d_start + d_goal;
+        }
+    }
+    if (best) {
+        times = best->times;
+        poses = best->poses;
+        if (result) *result = best->result;
+        const Point3f cached_pos = best->start.root_pos;
+        const Quat4f cached_ori = best->start.root_ori;
+        Quat4f q_inv, q_delta;
+        q_inv.inverse(cached_ori);  // Quat4::mulInverse(q1, q2) は自身のノルムで割るため使わない
+        q_delta.mul(start.root_ori, q_inv);
+        Matrix3f r_delta;
+        r_delta.set(q_delta);
+        for (QPosture& p : poses) {
+            Vector3f d(p.root_pos.x - cached_pos.x, p.root_pos.y - cached_pos.y, p.root_pos.z - cached_pos.z);
+            r_delta.transform(&d);
+            p.root_pos.set(start.root_pos.x + d.x, start.root_pos.y + d.y, start.root_pos.z + d.z);
+            Quat4f q = p.root_ori;
+            p.root_ori.mul(q_delta, q);
+            p.root_ori.normalize();
+        }
+        if (!poses.empty()) poses[0] = start;
+
+        float us = std::chrono::duration<float, std::micro>(clock_type::now() - t_begin).count();
+        if (result) {
+            result->cache_hit = true;
+            result->elapsed_ms = us * 1e-3f;
+        }
+        std::lock_guard<std::mutex> lock(C.mutex);
+        C.Touch(best);
+        ++C.hits;
+        C.hit_us_sum += us;
+        C.hit_us_max = std::max(C.hit_us_max, us);
+        return;
+    }
+    {
+        float us = std::chrono::duration<float, std::micro>(clock_type::now() - t_begin).count();
+        std::lock_guard<std::mutex> lock(C.mutex);
+        C.miss_us_sum += us;
+    }
+
+    // 生成して登録（制限時間・中止で打ち切った結果は要求ごとに異なるため登録しない）
+    GenerateResult local;
+    GenerateResult* r = result ? result : &local;
+    GenerateRollout(start, goal, opt, nullptr, &times, &poses, r);
+    r->cache_hit = false;
+    if (r->status == GENERATE_DEADLINE || r->status == GENERATE_CANCELLED || r->truncated) return;
+
+    auto E = std::make_shared<ResultCache::Entry>();
+    E->hash = hash;
+    E->key = std::move(key);
+    E->start = start;
+    E->goal = goal;
+    E->times = times;
+    E->poses = poses;
+    E->result = *r;
+    const size_t pose_bytes = sizeof(QPosture) + sizeof(Quat4f) * human_.GetSkeleton()->num_joints;
+    E->bytes = sizeof(ResultCache::Entry) + sizeof(int32_t) * E->key.size() + sizeof(float) * E->times.size()
+             + pose_bytes * (E->poses.size() + 2) + 8 * sizeof(void*);  // 8 ポインタ分はリスト・索引の節点・共有ポインタの制御領域
+    if (E->bytes > C.opt.max_bytes) return;
+
+    std::lock_guard<std::mutex> lock(C.mutex);
+    while (!C.lru.empty() && C.bytes + E->bytes > C.opt.max_bytes) {
+        C.bytes -= C.lru.back()->bytes;
+        C.EraseIndex(std::prev(C.lru.end()));
+        C.lru.pop_back();
+        ++C.evictions;
+    }
+    C.bytes += E->bytes;
+    C.lru.push_front(std::move(E));
+    C.index.insert(std::make_pair(hash, C.lru.begin()));
+}
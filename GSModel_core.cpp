@@ -2,6 +2,24 @@
 
 using std::vector;
 
+// root平行移動を除去した関節位置のRMSE[m]
+static float joint_rmse(const vector<Point3f>& ja, const Point3f& ra,
+                        const vector<Point3f>& jb, const Point3f& rb) {
+    if (ja.empty() || jb.empty() || ja.size() != jb.size())
+        return std::numeric_limits<float>::infinity();
+
+    double acc = 0.0;
+    for (size_t i = 0; i < ja.size(); ++i) {
+        Vector3f va(ja[i].x - ra.x, ja[i].y - ra.y, ja[i].z - ra.z);
+        Vector3f vb(jb[i].x - rb.x, jb[i].y - rb.y, jb[i].z - rb.z);
+        double dx = double(va.x) - double(vb.x);
+        double dy = double(va.y) - double(vb.y);
+        double dz = double(va.z) - double(vb.z);
+        acc += dx*dx + dy*dy + dz*dz;
+    }
+    return float(std::sqrt(acc / double(ja.size()))); // RMSE[m]
+}
+
 GSModel::GSModel(const HumanBody& human) : human_(human) {
 #if GSM_ENABLE_DUMP
     default_dump_.enabled = false;
@@ -14,6 +32,10 @@ bool GSModel::IsCompatible(const Posture& p) const {
     return (p.body == human_.GetSkeleton()); // HumanBodyのSkeletonと一致かを確認
 }
 
+bool GSModel::IsCompatible(const QPosture& p) const {
+    return (p.body == human_.GetSkeleton());
+}
+
 void GSModel::FKJointPositions(const Posture& p, std::vector<Point3f>& joints) const {
     joints.clear();
     std::vector<Matrix4f> seg_frames;
@@ -22,28 +44,228 @@ void GSModel::FKJointPositions(const Posture& p, std::vector<Point3f>& joints) c
     joints = std::move(joi_pos);
 }
 
+void GSModel::FKJointPositions(const QPosture& p, std::vector<Point3f>& joints) const {
+    joints.clear();
+    std::vector<Matrix4f> seg_frames;
+    std::vector<Point3f>  joi_pos;
+    ForwardKinematics(p, seg_frames, joi_pos); // 四元数表現のままFK
+    joints = std::move(joi_pos);
+}
+
 float GSModel::FKDistance(const Posture& a, const Posture& b) const {
     // スケルトン一貫性（安全策）
     if (a.body != b.body) return std::numeric_limits<float>::infinity();
     std::vector<Point3f> ja, jb;
     FKJointPositions(a, ja);
     FKJointPositions(b, jb);
-    if (ja.empty() || jb.empty() || ja.size() != jb.size())
-        return std::numeric_limits<float>::infinity();
 
     // root平行移動の影響を除去するため、各関節座標からroot_posを減算して比較
-    Vector3f ra(a.root_pos.x, a.root_pos.y, a.root_pos.z);
-    Vector3f rb(b.root_pos.x, b.root_pos.y, b.root_pos.z);
-    double acc = 0.0;
-    for (size_t i = 0; i < ja.size(); ++i) {
-        Vector3f va(ja[i].x - ra.x, ja[i].y - ra.y, ja[i].z - ra.z);
-        Vector3f vb(jb[i].x - rb.x, jb[i].y - rb.y, jb[i].z - rb.z);
-        double dx = double(va.x) - double(vb.x);
-        double dy = double(va.y) - double(vb.y);
-        double dz = double(va.z) - double(vb.z);
-        acc += dx*dx + dy*dy + dz*dz;
+    return joint_rmse(ja, a.root_pos, jb, b.root_pos);
+}
+
+float GSModel::FKDistance(const QPosture& a, const QPosture& b) const {
+    if (a.body != b.body) return std::numeric_limits<float>::infinity();
+    std::vector<Point3f> ja, jb;
+    FKJointPositions(a, ja);
+    FKJointPositions(b, jb);
+    return joint_rmse(ja, a.root_pos, jb, b.root_pos);
+}
+
+float GSModel::FKDistance(const QPosture& a, const QPosture& b, FKWorkspace& ws) const {
+    if (a.body != b.body) return std::numeric_limits<float>::infinity();
+    ForwardKinematics(a, ws.seg_frames, ws.joints_a);
+    ForwardKinematics(b, ws.seg_frames, ws.joints_b);
+    return joint_rmse(ws.joints_a, a.root_pos, ws.joints_b, b.root_pos);
+}
+
+// 一括FKの計算順の作成（ForwardKinematicsIteration と同じ深さ優先の順）
+static void append_fk_links(const Segment* segment, const Segment* prev_segment,
+                            vector<FKWorkspace::Link>& links) {
+    for (int j = 0; j < segment->num_joints; ++j) {
+        const Joint* next_joint = segment->joints[j];
+        const Segment* next_segment = (next_joint->segments[0] != segment) ? next_joint->segments[0]
+                                                                           : next_joint->segments[1];
+        if (next_segment == prev_segment) continue;
+
+        FKWorkspace::Link link;
+        link.seg = segment->index;
+        link.next_seg = next_segment->index;
+        link.next_joint = next_joint->index;
+        segment->joint_positions[j].get(&link.to_joint);
+        next_segment->joint_positions[0].get(&link.from_joint);
+        links.push_back(link);
+        append_fk_links(next_segment, segment, links);
+    }
+}
+
+// レーンごとの四元数→回転行列（Matrix4f::setFromQuat と同じ演算順、R は [9 要素][レーン]）
+static void quat_to_rotation_lanes(const float* qx, const float* qy, const float* qz, const float* qw,
+                                   float (*R)[GSM_FK_LANES]) {
+    for (int k = 0; k < GSM_FK_LANES; ++k) {
+        float x = qx[k], y = qy[k], z = qz[k], w = qw[k];
+        float n = x*x + y*y + z*z + w*w;
+        float s = (n > 0.0) ? (2.0/n) : 0.0;
+
+        float xs = x*s,  ys = y*s,  zs = z*s;
+        float wx = w*xs, wy = w*ys, wz = w*zs;
+        float xx = x*xs, xy = x*ys, xz = x*zs;
+        float yy = y*ys, yz = y*zs, zz = z*zs;
+
+        R[0][k] = 1.0 - (yy + zz); R[1][k] = xy - wz;         R[2][k] = xz + wy;
+        R[3][k] = xy + wz;         R[4][k] = 1.0 - (xx + zz); R[5][k] = yz - wx;
+        R[6][k] = xz - wy;         R[7][k] = yz + wx;         R[8][k] = 1.0 - (xx + yy);
+    }
+}
+
+void GSModel::PrepareFKBatch(FKWorkspace& ws) const {
+    const Skeleton* body = human_.GetSkeleton();
+    if (ws.links_body == body) return;
+    ws.links.clear();
+    ws.links.reserve(body->num_joints);
+    append_fk_links(body->segments[0], nullptr, ws.links);
+    ws.lane_frames.assign(size_t(body->num_segments) * 12 * GSM_FK_LANES, 0.0f);
+    ws.lane_joints.assign(size_t(body->num_joints) * 3 * GSM_FK_LANES, 0.0f);
+    ws.seg_frames.resize(body->num_segments);
+    ws.joints_a.resize(body->num_joints);
+    ws.joints_b.resize(body->num_joints);
+    ws.joints_c.resize(body->num_joints);
+    ws.links_body = body;
+}
+
+void GSModel::FKDistanceBatch(const QPosture* const* poses, int num, const QPosture& ref_a, const QPosture& ref_b,
+                              float* dist_a, float* dist_b, FKWorkspace& ws,
+                              const QPosture* ref_c, float* dist_c) const {
+    const int L = GSM_FK_LANES;
+    PrepareFKBatch(ws);
+    const int num_joints = human_.GetSkeleton()->num_joints;
+
+    // 基準姿勢の関節位置（通常の FK、1回のみ）
+    ForwardKinematics(ref_a, ws.seg_frames, ws.joints_a);
+    ForwardKinematics(ref_b, ws.seg_frames, ws.joints_b);
+    const bool use_c = (ref_c != nullptr) && (dist_c != nullptr);
+    if (use_c) ForwardKinematics(*ref_c, ws.seg_frames, ws.joints_c);
+
+    float qx[L], qy[L], qz[L], qw[L];
+    float R[9][L];
+    float root_x[L], root_y[L], root_z[L];
+    double acc_a[L], acc_b[L], acc_c[L];
+
+    for (int base = 0; base < num; base += L) {
+        // 余ったレーンには最後の姿勢を入れる（結果は使わない）
+        const QPosture* lane[L];
+        for (int k = 0; k < L; ++k)
+            lane[k] = poses[std::min(base + k, num - 1)];
+
+        // ルート体節（ForwardKinematics の set(root_ori, root_pos, 1.0f)、スケール 1 の乗算は省略）
+        float* F0 = &ws.lane_frames[0];
+        for (int k = 0; k < L; ++k) {
+            const Quat4f& q = lane[k]->root_ori;
+            qx[k] = q.x; qy[k] = q.y; qz[k] = q.z; qw[k] = q.w;
+            root_x[k] = lane[k]->root_pos.x;
+            root_y[k] = lane[k]->root_pos.y;
+            root_z[k] = lane[k]->root_pos.z;
+        }
+        quat_to_rotation_lanes(qx, qy, qz, qw, R);
+        for (int e = 0; e < 9; ++e)
+            for (int k = 0; k < L; ++k) F0[e*L + k] = R[e][k];
+        for (int k = 0; k < L; ++k) {
+            F0[9*L + k] = root_x[k];
+            F0[10*L + k] = root_y[k];
+            F0[11*L + k] = root_z[k];
+        }
+
+        // 各関節（ForwardKinematicsIteration と同じ演算順、回転行列の第4行・第4列の 0・1 との演算は省略）
+        for (const FKWorkspace::Link& link : ws.links) {
+            const float* P = &ws.lane_frames[size_t(link.seg) * 12 * L];
+            float* N = &ws.lane_frames[size_t(link.next_seg) * 12 * L];
+            float* J = &ws.lane_joints[size_t(link.next_joint) * 3 * L];
+            for (int k = 0; k < L; ++k) {
+                const Quat4f& q = lane[k]->joint_rotations[link.next_joint];
+                qx[k] = q.x; qy[k] = q.y; qz[k] = q.z; qw[k] = q.w;
+            }
+            quat_to_rotation_lanes(qx, qy, qz, qw, R);
+
+            const float ax = link.to_joint.x, ay = link.to_joint.y, az = link.to_joint.z;
+            const float bx = link.from_joint.x, by = link.from_joint.y, bz = link.from_joint.z;
+            for (int k = 0; k < L; ++k) {
+                const float p00 = P[0*L + k], p01 = P[1*L + k], p02 = P[2*L + k];
+                const float p10 = P[3*L + k], p11 = P[4*L + k], p12 = P[5*L + k];
+                const float p20 = P[6*L + k], p21 = P[7*L + k], p22 = P[8*L + k];
+
+                // 親の体節の座標系から関節の位置へ
+                float tx = P[9*L + k] + ((p00*ax + p01*ay) + p02*az);
+                float ty = P[10*L + k] + ((p10*ax + p11*ay) + p12*az);
+                float tz = P[11*L + k] + ((p20*ax + p21*ay) + p22*az);
+                J[0*L + k] = tx;
+                J[1*L + k] = ty;
+                J[2*L + k] = tz;
+
+                // 関節の回転
+                float n00 = (p00*R[0][k] + p01*R[3][k]) + p02*R[6][k];
+                float n01 = (p00*R[1][k] + p01*R[4][k]) + p02*R[7][k];
+                float n02 = (p00*R[2][k] + p01*R[5][k]) + p02*R[8][k];
+                float n10 = (p10*R[0][k] + p11*R[3][k]) + p12*R[6][k];
+                float n11 = (p10*R[1][k] + p11*R[4][k]) + p12*R[7][k];
+                float n12 = (p10*R[2][k] + p11*R[5][k]) + p12*R[8][k];
+                float n20 = (p20*R[0][k] + p21*R[3][k]) + p22*R[6][k];
+                float n21 = (p20*R[1][k] + p21*R[4][k]) + p22*R[7][k];
+                float n22 = (p20*R[2][k] + p21*R[5][k]) + p22*R[8][k];
+                N[0*L + k] = n00; N[1*L + k] = n01; N[2*L + k] = n02;
+                N[3*L + k] = n10; N[4*L + k] = n11; N[5*L + k] = n12;
+                N[6*L + k] = n20; N[7*L + k] = n21; N[8*L + k] = n22;
+
+                // 関節から子の体節の座標系へ
+                N[9*L + k] = tx - ((n00*bx + n01*by) + n02*bz);
+                N[10*L + k] = ty - ((n10*bx + n11*by) + n12*bz);
+                N[11*L + k] = tz - ((n20*bx + n21*by) + n22*bz);
+            }
+        }
+
+        // root平行移動を除去した関節位置のRMSE（joint_rmse と同じ演算順）
+        for (int k = 0; k < L; ++k) {
+            acc_a[k] = 0.0;
+            acc_b[k] = 0.0;
+            acc_c[k] = 0.0;
+        }
+        for (int i = 0; i < num_joints; ++i) {
+            const float* J = &ws.lane_joints[size_t(i) * 3 * L];
+            const float ax = ws.joints_a[i].x - ref_a.root_pos.x;
+            const float ay = ws.joints_a[i].y - ref_a.root_pos.y;
+            const float az = ws.joints_a[i].z - ref_a.root_pos.z;
+            const float bx = ws.joints_b[i].x - ref_b.root_pos.x;
+            const float by = ws.joints_b[i].y - ref_b.root_pos.y;
+            const float bz = ws.joints_b[i].z - ref_b.root_pos.z;
+            for (int k = 0; k < L; ++k) {
+                float vx = J[0*L + k] - root_x[k];
+                float vy = J[1*L + k] - root_y[k];
+                float vz = J[2*L + k] - root_z[k];
+                double dx = double(vx) - double(ax);
+                double dy = double(vy) - double(ay);
+                double dz = double(vz) - double(az);
+                acc_a[k] += dx*dx + dy*dy + dz*dz;
+                dx = double(vx) - double(bx);
+                dy = double(vy) - double(by);
+                dz = double(vz) - double(bz);
+                acc_b[k] += dx*dx + dy*dy + dz*dz;
+            }
+            if (use_c) {
+                const float cx = ws.joints_c[i].x - ref_c->root_pos.x;
+                const float cy = ws.joints_c[i].y - ref_c->root_pos.y;
+                const float cz = ws.joints_c[i].z - ref_c->root_pos.z;
+                for (int k = 0; k < L; ++k) {
+                    double dx = double(J[0*L + k] - root_x[k]) - double(cx);
+                    double dy = double(J[1*L + k] - root_y[k]) - double(cy);
+                    double dz = double(J[2*L + k] - root_z[k]) - double(cz);
+                    acc_c[k] += dx*dx + dy*dy + dz*dz;
+                }
+            }
+        }
+        for (int k = 0; k < L && base + k < num; ++k) {
+            dist_a[base + k] = float(std::sqrt(acc_a[k] / double(num_joints)));
+            dist_b[base + k] = float(std::sqrt(acc_b[k] / double(num_joints)));
+            if (use_c) dist_c[base + k] = float(std::sqrt(acc_c[k] / double(num_joints)));
+        }
     }
-    return float(std::sqrt(acc / double(ja.size()))); // RMSE[m]
 }
 
 int GSModel::FindNearestSplat(const Posture& p, float* out_dist) const {
@@ -60,6 +282,39 @@ int GSModel::FindNearestSplat(const Posture& p, float* out_dist) const {
     return best;
 }
 
+int GSModel::FindNearestSplat(const QPosture& p, float* out_dist) const {
+    FKWorkspace ws;
+    return FindNearestSplat(p, out_dist, ws);
+}
+
+int GSModel::FindNearestSplat(const QPosture& p, float* out_dist, FKWorkspace& ws, int level) const {
+    if (!lod_.empty()) return FindNearestSplatLOD(p, level, out_dist, ws);
+
+    int best = -1;
+    float best_d = std::numeric_limits<float>::infinity();
+    for (size_t i = 0; i < splats_.size(); ++i) {
+        float d = FKDistance(p, splats_[i].mean_qpose, ws);
+        if (d < best_d) {
+            best_d = d;
+            best = int(i);
+        }
+    }
+    ws.nearest_evals += splats_.size();
+    if (out_dist) *out_dist = best_d;
+    return best;
+}
+
+int GSModel::FindNearestSplatApprox(const QPosture& p, int hint, float* out_dist, FKWorkspace& ws, int level) const {
+    if (hint >= 0 && hint < (int)splats_.size()) {
+        float d = FKDistance(p, splats_[hint].mean_qpose, ws);
+        if (d <= splats_[hint].occ_sigma_m) {
+            if (out_dist) *out_dist = d;
+            return hint;
+        }
+    }
+    return FindNearestSplat(p, out_dist, ws, level);
+}
+
 // 一括Fitユーティリティ
 GSModel GSModel::Fit(const HumanBody& human,
                      const std::vector<const Motion*>& motions,
@@ -23,6 +23,7 @@ void GSModel::DumpModel(const std::string& dir) const {
         std::ofstream ofs(dir + "/model_summary.json");
         ofs << "{\n";
         ofs << "  \"num_splats\": " << splats_.size() << ",\n";
+        ofs << "  \"num_graph_edges\": " << graph_edges_.size() << ",\n";
         ofs << "  \"skeleton_joints\": " << (human_.GetSkeleton() ? human_.GetSkeleton()->num_joints : -1) << "\n";
         ofs << "}\n";
     }
@@ -41,12 +42,24 @@ void GSModel::DumpModel(const std::string& dir) const {
                 << (s.has_next ? 1 : 0) << "\n";
         }
     }
+    // 遷移グラフ
+    {
+        std::ofstream ofs(dir + "/splat_graph.csv");
+        ofs << "from,to,kind,cost_s\n";
+        for (size_t i = 0; i + 1 < graph_offsets_.size(); ++i) {
+            for (int e = graph_offsets_[i]; e < graph_offsets_[i + 1]; ++e) {
+                ofs << i << "," << graph_edges_[e].to << ","
+                    << (graph_edges_[e].successor ? "successor" : "neighbor") << ","
+                    << graph_edges_[e].cost << "\n";
+            }
+        }
+    }
 }
 
 void GSModel::DumpGenerateTrace(const std::string& dir,
                                 const std::vector<StepLog>& logs,
                                 const std::vector<float>& times,
-                                const std::vector<Posture>& poses,
+                                const std::vector<QPosture>& poses,
                                 const GenerateInitLog* init) const 
 {
     ensure_dir(dir);
@@ -74,7 +87,7 @@ void GSModel::DumpGenerateTrace(const std::string& dir,
         };
 
         std::ofstream ofs(dir + "/gen_trace.csv");
-        ofs << "step,t_sec,dist_goal,delta_goal,alpha,alpha_mode,step_norm,dt,splat_id,v_ref,v_min,v_max,used_speed,v_floor,events" << '\n';
+        ofs << "step,t_sec,dist_goal,delta_goal,alpha,alpha_mode,step_norm,dt,splat_id,v_ref,v_min,v_max,used_speed,v_floor,events,n_eval" << '\n';
         for (const auto& L : logs) {
             ofs << L.step << ','
                 << L.t_sec << ','
@@ -90,7 +103,8 @@ void GSModel::DumpGenerateTrace(const std::string& dir,
                 << L.v_max << ','
                 << L.used_speed << ','
                 << L.v_floor << ','
-                << escape_csv(L.events) << '\n';
+                << escape_csv(L.events) << ','
+                << L.n_eval << '\n';
         }
     }
     {
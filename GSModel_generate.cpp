@@ -1,11 +1,18 @@
 ﻿#include "GSModel.h"
 
+#include <chrono>
+#include <cstring>
+
 using std::vector;
 
 static inline float safe_div(float a, float b) {
     return (b > 1e-8f) ? (a / b) : 0.0f;
 }
 
+// 前進とみなす目標距離の最小の減少量[m]
+static const float eps_progress = 1e-6f;
+
+
 KeyframeMotion GSModel::Generate(const Posture& start,
                                  const Posture& goal,
                                  float tempo) const {
@@ -16,7 +23,58 @@ KeyframeMotion GSModel::Generate(const Posture& start,
 
 KeyframeMotion GSModel::Generate(const Posture& start,
                                  const Posture& goal,
-                                 const GenerateOptions& opt_in) const {
+                                 const GenerateOptions& opt_in,
+                                 GenerateResult* result) const {
+    if (!IsCompatible(start) || !IsCompatible(goal)) {
+        throw std::runtime_error("GSModel::Generate: Skeleton mismatch in input Posture.");
+    }
+
+    // 四元数表現で生成し、最後に行列表現へ戻す
+    vector<float>    times;
+    vector<QPosture> poses;
+    GenerateQ(QPosture(start), QPosture(goal), opt_in, times, poses, result);
+
+    // KeyframeMotion を組み立て
+    KeyframeMotion kf(human_.GetSkeleton(), (int)times.size()); // KeyframeMotionのInitは内部で配列を確保 :contentReference[oaicite:7]{index=7}
+    for (int i = 0; i < (int)times.size(); ++i) {
+        kf.key_times[i] = times[i];
+        poses[i].GetPosture(kf.key_poses[i]);
+    }
+    return kf;
+}
+
+void GSModel::GenerateQ(const QPosture& start,
+                        const QPosture& goal,
+                        const GenerateOptions& opt,
+                        std::vector<float>& times,
+                        std::vector<QPosture>& poses,
+                        GenerateResult* result) const {
+    bool use_cache = (result_cache_ != nullptr);
+#if GSM_ENABLE_DUMP
+    use_cache = use_cache && !opt.dump.enabled && !default_dump_.enabled;
+#endif
+    if (use_cache) {
+        GenerateCached(start, goal, opt, times, poses, result);
+        return;
+    }
+    GenerateRollout(start, goal, opt, nullptr, &times, &poses, result);
+}
+
+void GSModel::GenerateStream(const QPosture& start,
+                             const QPosture& goal,
+                             const GenerateOptions& opt,
+                             const GenerateSink& sink,
+                             GenerateResult* result) const {
+    GenerateRollout(start, goal, opt, &sink, nullptr, nullptr, result);
+}
+
+void GSModel::GenerateRollout(const QPosture& start,
+                              const QPosture& goal,
+                              const GenerateOptions& opt_in,
+                              const GenerateSink* sink,
+                              std::vector<float>* out_times,
+                              std::vector<QPosture>* out_poses,
+                              GenerateResult* result) const {
     if (!IsCompatible(start) || !IsCompatible(goal)) {
         throw std::runtime_error("GSModel::Generate: Skeleton mismatch in input Posture.");
     }
@@ -30,209 +88,165 @@ KeyframeMotion GSModel::Generate(const Posture& start,
     if (!opt.dump.enabled) opt.dump = default_dump_;
 #endif
 
+    // 制限時間（deadline_ms > 0 のときのみ各ステップで経過時間を確認）
+    //   次の1ステップ（直前のステップの所要時間で見積もり）が制限時間内に収まらなければ打ち切り
+    //   経過 50% 未満: 通常 / 80% 未満: αグリッドを {0, 0.5, 1} に縮小 / それ以降: さらに近傍スプラットを近似
+    typedef std::chrono::steady_clock clock_type;
+    const clock_type::time_point t_begin = clock_type::now();
+    const bool use_deadline = (opt.deadline_ms > 0.0f);
+    auto elapsed_ms = [&]() {
+        return std::chrono::duration<float, std::milli>(clock_type::now() - t_begin).count();
+    };
+    float last_check_ms = 0.0f;
+    int max_level = 0;
+    auto check_deadline = [&]() -> int { // 戻り値は簡略化の段階（打ち切りなら -1）
+        float now = elapsed_ms();
+        float step_ms = now - last_check_ms;
+        last_check_ms = now;
+        if (now + step_ms >= opt.deadline_ms) return -1;
+        float ratio = now / opt.deadline_ms;
+        int level = (ratio < 0.5f) ? 0 : (ratio < 0.8f) ? 1 : 2;
+        max_level = std::max(max_level, level);
+        return level;
+    };
+
+    // 出力先（逐次出力のみの場合も、ダンプが有効なら全体を保持）
+    vector<float>    local_times;
+    vector<QPosture> local_poses;
+    bool keep_all = (out_times != nullptr);
+#if GSM_ENABLE_DUMP
+    keep_all = keep_all || opt.dump.enabled;
+#endif
+    vector<float>&    times = out_times ? *out_times : local_times;
+    vector<QPosture>& poses = out_poses ? *out_poses : local_poses;
+    times.clear();
+    poses.clear();
+    if (keep_all) {
+        // 最大長を確保して、伸長時の姿勢の複製を避ける（max_steps が大きい場合は上限を設ける）
+        size_t max_keys = (size_t)std::min(std::max(opt.max_steps, 0), 1024) + 1 + (opt.extend_to_stable ? 120 : 0);
+        times.reserve(max_keys);
+        poses.reserve(max_keys);
+    }
+    bool cancelled = false;
+    auto emit = [&](const GenerateRolloutState& s) {
+        if (keep_all) {
+            times.push_back(s.t);
+            poses.push_back(s.cur);
+        }
+        if (sink && !(*sink)(s.t, s.cur)) cancelled = true;
+        return !cancelled;
+    };
+
     // ロールアウト
-    vector<float>   times;
-    vector<Posture> poses;
 #if GSM_ENABLE_DUMP
     vector<StepLog> logs;
     GenerateInitLog initlog;
 #endif
 
-    float t = 0.0f;
-    Posture cur = start;
+    GenerateRolloutState st;
+    BeginRollout(st, start, goal, opt);
 
-    times.push_back(t);
-    poses.push_back(cur);
+    emit(st);
+    int num_keys = 1;
 
-    const float dt = (opt.dt_seconds > 0.0f ? opt.dt_seconds : (1.0f/30.0f));
     const float goal_th = std::max(1e-4f, opt.goal_tolerance_m);
 
-    // ゴール最近傍スプラット（停止性確認用）
-    int goal_sid = FindNearestSplat(goal, nullptr);
-    bool goal_stoppable = (goal_sid >= 0) && (splats_[goal_sid].stopability >= opt.stopability_th);
-
     // 初期診断
-    float d_goal0 = FKDistance(cur, goal);
+    float d_goal0 = FKDistance(st.cur, goal, st.fk);
     float d_tmp = 0.0f;
-    int start_sid = FindNearestSplat(cur, &d_tmp);
-//    int goal_sid  = FindNearestSplat(goal, nullptr);
-//    bool goal_stoppable = (goal_sid >= 0) && (splats_[goal_sid].stopability >= opt.stopability_th);
+    int start_sid = FindNearestSplat(st.cur, &d_tmp, st.fk, opt.draft_level);
 #if GSM_ENABLE_DUMP
     initlog.d_goal0 = d_goal0;
     initlog.start_sid = start_sid;
     initlog.d_start_splat = d_tmp;
     if (start_sid >= 0) {
-        initlog.d_start_next = FKDistance(cur, splats_[start_sid].next_pose);
+        initlog.d_start_next = FKDistance(st.cur, splats_[start_sid].next_qpose, st.fk);
     }
-    initlog.goal_sid = goal_sid;
-    initlog.goal_stopability = (goal_sid >= 0) ? splats_[goal_sid].stopability : -1.0f;
+    initlog.goal_sid = st.goal_sid;
+    initlog.goal_stopability = (st.goal_sid >= 0) ? splats_[st.goal_sid].stopability : -1.0f;
 #endif
 
-    const float eps_progress = 1e-6f;
-    int stagnation_count = 0;
-    int force_goal_steps = 0;
-    for (int step = 0; step < opt.max_steps; ++step) {
+    GenerateStatus status = GENERATE_MAX_STEPS;
+    bool deadline_hit = false;
+    int num_steps = 0;
+    int num_evals = 0;
+    int closest_index = 0;       // 目標に最も近い姿勢の番号（打ち切り時はここまでを返す）
+    float closest_dist = d_goal0;
+    GenerateStepInfo info;
+    for (int step = 0; step < opt.max_steps && !cancelled; ++step) {
         // 終了条件（距離）
-        float d_goal = FKDistance(cur, goal);
-        if (d_goal <= goal_th && (goal_stoppable || !opt.extend_to_stable)) {
+        float d_goal = FKDistance(st.cur, st.goal, st.fk);
+        if (d_goal <= goal_th && (st.goal_stoppable || !opt.extend_to_stable)) {
+            status = GENERATE_REACHED;
             break;
         }
-
-        // 近傍スプラット
-        float d_s = 0.0f;
-        int sid = FindNearestSplat(cur, &d_s);
-        if (sid < 0) break;
-        const GaussianSplat& S = splats_[sid];
-
-        // 目標姿勢Qの決定
-        //   非停止(s小) -> next_pose寄り, 停止可(s大) -> 目標姿勢寄り
-        float s = S.stopability;
-        Posture target_model = S.has_next ? S.next_pose : S.mean_pose;
-
-        // 速度ノルム
-        float v_ref = S.v_norm_ref * opt.tempo;
-        float v_min = S.v_norm_min * opt.tempo;
-        float v_max = S.v_norm_max * opt.tempo;
-
-        // 2つの候補への距離
-        float d_model = FKDistance(cur, target_model);
-
-        float v_used = GSModel::Clamp(v_ref, v_min, v_max);
-        v_used = std::max(v_used, opt.v_floor_mps);
 
-        auto format_float = [](float value) {
-            std::ostringstream oss;
-            oss << std::fixed << std::setprecision(4) << value;
-            return oss.str();
-        };
-
-        bool force_goal_mode = (force_goal_steps > 0);
-        if (force_goal_mode) {
-            --force_goal_steps;
-        }
-
-        float dt_try = dt;
-        int dt_backoff = 0;
-        bool advanced = false;
-        Posture best_pose(human_.GetSkeleton());
-        float best_delta = -std::numeric_limits<float>::infinity();
-        float best_dist_goal = d_goal;
-        float best_step_norm = 0.0f;
-        float best_alpha = 0.0f;
-        std::string best_mode;
-        float best_dt = dt;
-        float best_r_model = 0.0f;
-        float best_r_goal = 0.0f;
-        std::vector<std::string> event_tags;
-
-        while (dt_backoff <= 2 && !advanced) {
-            float dt_local = dt_try;
-            float r_model_base = GSModel::Clamp( safe_div( v_used * dt_local, std::max(1e-6f, d_model) ), 0.0f, 1.0f );
-            float r_goal_base  = GSModel::Clamp( safe_div( v_used * dt_local, std::max(1e-6f, d_goal) ), 0.0f, 1.0f );
-
-            const float alpha_candidates[] = {0.0f, 0.25f, 0.5f, 0.75f, 1.0f};
-
-            auto evaluate_alpha = [&](float alpha, const std::string& mode) {
-                Posture p_model(human_.GetSkeleton());
-                Posture p_goal(human_.GetSkeleton());
-                Posture candidate(human_.GetSkeleton());
-
-                float r_model = (1.0f - alpha) * r_model_base;
-                float r_goal  = alpha * r_goal_base;
-                PostureInterpolation(cur, target_model, r_model, p_model);
-                PostureInterpolation(cur, goal, r_goal, p_goal);
-                PostureInterpolation(p_model, p_goal, alpha, candidate);
-
-                float dist_goal_next = FKDistance(candidate, goal);
-                float delta_goal = d_goal - dist_goal_next;
-                float step_norm = FKDistance(cur, candidate);
-
-                if (delta_goal > best_delta + eps_progress) {
-                    best_delta = delta_goal;
-                    best_pose = candidate;
-                    best_dist_goal = dist_goal_next;
-                    best_step_norm = step_norm;
-                    best_alpha = alpha;
-                    best_mode = mode;
-                    best_dt = dt_local;
-                    best_r_model = r_model;
-                    best_r_goal = r_goal;
-                }
-            };
-
-            if (force_goal_mode) {
-                evaluate_alpha(1.0f, "force_goal");
-            } else {
-                for (float alpha_candidate : alpha_candidates) {
-                    evaluate_alpha(alpha_candidate, "grid");
-                }
-            }
-
-            if (best_delta > eps_progress) {
-                advanced = true;
-                break;
-            }
-
-            // フォールバック: α=1 で再評価
-            evaluate_alpha(1.0f, force_goal_mode ? "force_goal" : "fallback_goal");
-            if (best_delta > eps_progress) {
-                advanced = true;
-                if (!force_goal_mode && best_mode != "force_goal") {
-                    best_mode = "fallback_goal";
-                }
-                break;
-            }
-
-            dt_try *= 0.5f;
-            ++dt_backoff;
-        }
-
-        if (!advanced && best_delta <= eps_progress) {
+        // 残り時間に応じた探索の簡略化
+        int level = use_deadline ? check_deadline() : 0;
+        if (level < 0) {
+            deadline_hit = true;
             break;
         }
-
-        bool progressed = (best_delta > eps_progress);
-        int next_stagnation = progressed ? 0 : (stagnation_count + 1);
-        bool trigger_force = (!progressed && next_stagnation >= 3);
-
-        if (dt_backoff > 0) {
-            event_tags.push_back("dt=" + format_float(best_dt));
-        }
-        if (force_goal_mode) {
-            event_tags.push_back("force_goal");
-        } else if (best_mode == "fallback_goal") {
-            event_tags.push_back("fallback_goal");
-        }
-        if (trigger_force) {
-            event_tags.push_back("trigger_force_goal");
+
+        // 前進
+        if (!StepRollout(st, opt, d_goal, level, info)) {
+            status = GENERATE_STALLED;
+            break;
+        }
+        emit(st);
+        ++num_keys;
+        ++num_steps;
+        num_evals += info.num_evals;
+        if (info.dist_goal < closest_dist) {
+            closest_dist = info.dist_goal;
+            closest_index = num_keys - 1;
         }
 
-        // 前進
-        t += best_dt;
-        cur = best_pose;
-        times.push_back(t);
-        poses.push_back(cur);
-
 #if GSM_ENABLE_DUMP
         if (opt.dump.enabled) {
+            std::vector<std::string> event_tags;
+            if (info.dt_backoff) {
+                std::ostringstream oss;
+                oss << std::fixed << std::setprecision(4) << info.dt;
+                event_tags.push_back("dt=" + oss.str());
+            }
+            if (info.force_goal) {
+                event_tags.push_back("force_goal");
+            } else if (std::strcmp(info.alpha_mode, "fallback_goal") == 0) {
+                event_tags.push_back("fallback_goal");
+            }
+            if (info.trigger_force) {
+                event_tags.push_back("trigger_force_goal");
+            }
+            if (level > 0) {
+                event_tags.push_back("lod=" + std::to_string(level));
+            }
+            if (info.plan_length > 0) {
+                event_tags.push_back("plan=" + std::to_string(info.plan_length));
+            }
+            if (info.horizon_index > 0) {
+                event_tags.push_back("horizon=" + std::to_string(info.horizon_index));
+            }
+
             StepLog L;
             L.step = step;
-            L.splat_id = sid;
-            L.t_sec = t;
-            L.dist_goal = best_dist_goal;
-            L.delta_goal = best_delta;
-            L.alpha = best_alpha;
-            L.alpha_mode = best_mode;
-            L.step_norm = best_step_norm;
-            L.dt = best_dt;
-            L.v_ref = v_ref;
-            L.v_min = v_min;
-            L.v_max = v_max;
-            L.used_speed = v_used;
+            L.splat_id = info.splat_id;
+            L.t_sec = st.t;
+            L.dist_goal = info.dist_goal;
+            L.delta_goal = info.delta_goal;
+            L.alpha = info.alpha;
+            L.alpha_mode = info.alpha_mode;
+            L.step_norm = info.step_norm;
+            L.dt = info.dt;
+            L.v_ref = info.v_ref;
+            L.v_min = info.v_min;
+            L.v_max = info.v_max;
+            L.used_speed = info.used_speed;
             L.v_floor = opt.v_floor_mps;
-            L.stopability = s;
-            L.r_model = best_r_model;
-            L.r_goal = best_r_goal;
+            L.stopability = info.stopability;
+            L.r_model = info.r_model;
+            L.r_goal = info.r_goal;
+            L.n_eval = info.num_evals;
             if (!event_tags.empty()) {
                 std::ostringstream oss;
                 for (size_t i = 0; i < event_tags.size(); ++i) {
@@ -245,48 +259,58 @@ KeyframeMotion GSModel::Generate(const Posture& start,
         }
 #endif
 
-        if (trigger_force) {
-            force_goal_steps = 3;
-        }
-        stagnation_count = trigger_force ? 0 : next_stagnation;
-
         // ゴール到達判定（ゴールが非停止なら延長する可能性あり）
-        if (d_goal <= goal_th && goal_stoppable) {
+        if (d_goal <= goal_th && st.goal_stoppable) {
+            status = GENERATE_REACHED;
             break;
         }
         // もしゴールが非停止なら、停止可になるまで進める
-        if (d_goal <= goal_th && !goal_stoppable && !opt.extend_to_stable) {
+        if (d_goal <= goal_th && !st.goal_stoppable && !opt.extend_to_stable) {
+            status = GENERATE_REACHED;
             break; // 延長しない設定ならここで終了
         }
     }
 
+    // 制限時間で打ち切った場合は、目標に最も近づいた姿勢までの動作を返す（逐次出力済みの姿勢はそのまま）
+    bool truncated = deadline_hit;
+    if (deadline_hit) {
+        status = GENERATE_DEADLINE;
+        if (out_times) {
+            times.resize(closest_index + 1);
+            poses.resize(closest_index + 1, st.cur);
+#if GSM_ENABLE_DUMP
+            if (logs.size() > (size_t)closest_index) logs.resize(closest_index);
+#endif
+        }
+    }
+
     // もしゴールが非停止で extend_to_stable=true なら、停止可になるまで数歩追加
-    if (opt.extend_to_stable) {
+    if (opt.extend_to_stable && !deadline_hit && !cancelled) {
         for (int k = 0; k < 120; ++k) { // 最長 ~4秒延長
-            int sid = FindNearestSplat(poses.back(), nullptr);
-            if (sid < 0) break;
-            if (splats_[sid].stopability >= opt.stopability_th) break; // 停止可になった
-            // そのままモデルフォローで少し進める
-            const GaussianSplat& S = splats_[sid];
-            Posture next = S.has_next ? S.next_pose : S.mean_pose;
-            float v_ref = S.v_norm_ref * opt.tempo;
-            float d = FKDistance(poses.back(), next);
-            float r = GSModel::Clamp( safe_div( v_ref * opt.dt_seconds, std::max(1e-6f, d) ), 0.0f, 1.0f );
-            Posture cur = poses.back();
-//            Posture out;
-            Posture out( human_.GetSkeleton() );
-            PostureInterpolation(cur, next, r, out);
-            t += opt.dt_seconds;
-            times.push_back(t);
-            poses.push_back(out);
+            int level = use_deadline ? check_deadline() : 0;
+            if (level < 0) {
+                truncated = true;
+                break;
+            }
+            if (!ExtendRollout(st, opt, level)) break; // 停止可になった
+            if (!emit(st)) break;
         }
     }
+    if (cancelled) {
+        status = GENERATE_CANCELLED;
+    }
 
-    // KeyframeMotion を組み立て
-    KeyframeMotion kf(human_.GetSkeleton(), (int)times.size()); // KeyframeMotionのInitは内部で配列を確保 :contentReference[oaicite:7]{index=7}
-    for (int i = 0; i < (int)times.size(); ++i) {
-        kf.key_times[i] = times[i];
-        kf.key_poses[i] = poses[i];
+    // 結果情報
+    if (result) {
+        result->final_dist_goal = FKDistance(out_poses ? poses.back() : st.cur, goal, st.fk);
+        result->status = ResolveStatus(status, std::min(closest_dist, result->final_dist_goal), goal_th);
+        result->truncated = truncated;
+        result->steps = num_steps;
+        result->evaluations = num_evals;
+        result->max_level = max_level;
+        result->plans = st.plans;
+        result->nearest_queries = st.nearest_queries;
+        result->elapsed_ms = elapsed_ms();
     }
 
 #if GSM_ENABLE_DUMP
@@ -295,6 +319,370 @@ KeyframeMotion GSModel::Generate(const Posture& start,
         DumpGenerateTrace(opt.dump.out_dir, logs, times, poses, &initlog);
     }
 #endif
+}
 
-    return kf;
+GenerateStatus GSModel::ResolveStatus(GenerateStatus status, float closest_dist, float goal_th) {
+    if (status == GENERATE_REACHED || status == GENERATE_CANCELLED) return status;
+    return (closest_dist <= goal_th) ? GENERATE_REACHED : status;
+}
+
+void GSModel::BeginRollout(GenerateRolloutState& st, const QPosture& start, const QPosture& goal,
+                           const GenerateOptions& opt) const {
+    // 作業姿勢（骨格が変わらなければ確保済みの領域を使い回す）
+    const Skeleton* body = human_.GetSkeleton();
+    if (st.candidate.body != body) {
+        st.p_model.Init(body);
+        st.p_goal.Init(body);
+        st.candidate.Init(body);
+        st.best_pose.Init(body);
+        st.batch.assign(5, QPosture(body));
+    }
+    PrepareFKBatch(st.fk);
+    st.plan.reserve(splats_.size());
+    st.plan_time.reserve(splats_.size());
+    if (opt.use_planner) PreparePlanWorkspace(st.planner);
+    st.cur = start;
+    st.t = 0.0f;
+    st.prev_sid = -1;
+    st.follow_sid = -1;
+    st.follow_index = 0;
+    st.nearest_queries = 0;
+    st.plans = 0;
+    RetargetRollout(st, goal, opt);
+}
+
+void GSModel::RetargetRollout(GenerateRolloutState& st, const QPosture& goal, const GenerateOptions& opt) const {
+    st.goal = goal;
+    st.stagnation_count = 0;
+    st.force_goal_steps = 0;
+    st.plan.clear();
+    st.plan_index = 0;
+
+    // ゴール最近傍スプラット（停止性確認用）
+    st.goal_sid = FindNearestSplat(goal, nullptr, st.fk, opt.draft_level);
+    st.goal_stoppable = (st.goal_sid >= 0) && (splats_[st.goal_sid].stopability >= opt.stopability_th);
+    st.landmark = (st.goal_sid >= 0 && st.goal_sid < (int)splat_landmark_.size()) ? splat_landmark_[st.goal_sid] : -1;
+}
+
+bool GSModel::StepRollout(GenerateRolloutState& st, const GenerateOptions& opt, float d_goal, int level,
+                          GenerateStepInfo& info) const {
+    const QPosture& cur = st.cur;
+    const QPosture& goal = st.goal;
+
+    // 近傍スプラット（将来の姿勢に沿って進む間は探索を省略）
+    int h = 0;
+    int sid = FindRolloutSplat(st, opt, level, &h);
+    if (sid < 0) return false;
+    const GaussianSplat& S = splats_[sid];
+
+    // 速度ノルム（将来の姿勢に沿って進む場合は、その区間の速度に合わせてスプラットの速度レンジを拡大縮小）
+    float v_ref = S.v_norm_ref * opt.tempo;
+    float v_min = S.v_norm_min * opt.tempo;
+    float v_max = S.v_norm_max * opt.tempo;
+    if (h > 0) {
+        float k = S.horizon_v_norm[h - 1] / S.v_norm_ref;
+        v_ref *= k;
+        v_min *= k;
+        v_max *= k;
+    }
+
+    float v_used = GSModel::Clamp(v_ref, v_min, v_max);
+    v_used = std::max(v_used, opt.v_floor_mps);
+
+    // 目標姿勢Qの決定
+    //   非停止(s小) -> next_pose寄り, 停止可(s大) -> 目標姿勢寄り
+    //   計画経路を使う場合は経路上の次のスプラットの姿勢へ（経路の残り時間が、目標へ直接向かう時間の見込みより短い間のみ）
+    float s = S.stopability;
+    int plan_length = 0;
+    float time_to_go = 0.0f;
+    int waypoint = opt.use_planner ? FollowPlan(st, sid, &plan_length, &time_to_go) : -1;
+    if (waypoint >= 0 && time_to_go / std::max(opt.tempo, 1e-3f) >= d_goal / v_used) {
+        waypoint = -1;
+    }
+    const QPosture& target_model = (waypoint >= 0) ? splats_[waypoint].mean_qpose
+                                 : (h > 0) ? S.horizon_qposes[h - 1]
+                                 : S.has_next ? S.next_qpose : S.mean_qpose;
+
+    // 2つの候補への距離
+    float d_model = FKDistance(cur, target_model, st.fk);
+
+    bool force_goal_mode = (st.force_goal_steps > 0);
+    if (force_goal_mode) {
+        --st.force_goal_steps;
+    }
+
+    const float dt = (opt.dt_seconds > 0.0f ? opt.dt_seconds : (1.0f/30.0f));
+    float dt_try = dt;
+    int dt_backoff = 0;
+    bool advanced = false;
+    float best_delta = -std::numeric_limits<float>::infinity();
+    float best_dist_goal = d_goal;
+    float best_step_norm = 0.0f;
+    float best_alpha = 0.0f;
+    const char* best_mode = "";
+    float best_dt = dt;
+    float best_r_model = 0.0f;
+    float best_r_goal = 0.0f;
+    int num_evals = 0;
+    float warm_alpha = -1.0f; // 前の dt で目標距離が最も減ったα（黄金分割探索で最初に評価）
+    const bool batch_grid = (opt.alpha_search == ALPHA_SEARCH_GRID) && (opt.batch_candidates || waypoint >= 0);
+
+    while (dt_backoff <= 2 && !advanced) {
+        float dt_local = dt_try;
+        float r_model_base = GSModel::Clamp( safe_div( v_used * dt_local, std::max(1e-6f, d_model) ), 0.0f, 1.0f );
+        float r_goal_base  = GSModel::Clamp( safe_div( v_used * dt_local, std::max(1e-6f, d_goal) ), 0.0f, 1.0f );
+
+        static const float alpha_candidates[] = {0.0f, 0.25f, 0.5f, 0.75f, 1.0f};
+        static const float alpha_candidates_coarse[] = {0.0f, 0.5f, 1.0f};
+
+        float round_best_delta = -std::numeric_limits<float>::infinity();
+        float round_best_alpha = 1.0f;
+        bool evaluated_goal = false;
+
+        auto evaluate_alpha = [&](float alpha, const char* mode) {
+            float r_model = (1.0f - alpha) * r_model_base;
+            float r_goal  = alpha * r_goal_base;
+            PostureInterpolation(cur, target_model, r_model, st.p_model, opt.interp_mode);
+            PostureInterpolation(cur, goal, r_goal, st.p_goal, opt.interp_mode);
+            PostureInterpolation(st.p_model, st.p_goal, alpha, st.candidate, opt.interp_mode);
+
+            float dist_goal_next = FKDistance(st.candidate, goal, st.fk);
+            float delta_goal = d_goal - dist_goal_next;
+            float step_norm = FKDistance(cur, st.candidate, st.fk);
+            ++num_evals;
+            if (delta_goal > round_best_delta) {
+                round_best_delta = delta_goal;
+                round_best_alpha = alpha;
+            }
+            evaluated_goal = evaluated_goal || (alpha == 1.0f);
+
+            if (delta_goal > best_delta + eps_progress) {
+                best_delta = delta_goal;
+                st.best_pose = st.candidate;
+                best_dist_goal = dist_goal_next;
+                best_step_norm = step_norm;
+                best_alpha = alpha;
+                best_mode = mode;
+                best_dt = dt_local;
+                best_r_model = r_model;
+                best_r_goal = r_goal;
+            }
+            return delta_goal;
+        };
+
+        if (force_goal_mode) {
+            evaluate_alpha(1.0f, "force_goal");
+        } else if (batch_grid) {
+            // 全候補をまとめて補間し、FK 距離を一括計算（選択は1つずつ評価する場合と同じ順序・判定）
+            const float* grid = (level > 0) ? alpha_candidates_coarse : alpha_candidates;
+            const int num = (level > 0) ? 3 : 5;
+            const QPosture* batch_poses[5];
+            const QPosture* waypoint_pose = (waypoint >= 0) ? &splats_[waypoint].mean_qpose : nullptr;
+            float batch_dist_goal[5], batch_step_norm[5], batch_dist_plan[5];
+            for (int i = 0; i < num; ++i) {
+                float alpha = grid[i];
+                PostureInterpolation(cur, target_model, (1.0f - alpha) * r_model_base, st.p_model, opt.interp_mode);
+                PostureInterpolation(cur, goal, alpha * r_goal_base, st.p_goal, opt.interp_mode);
+                PostureInterpolation(st.p_model, st.p_goal, alpha, st.batch[i], opt.interp_mode);
+                batch_poses[i] = &st.batch[i];
+            }
+            FKDistanceBatch(batch_poses, num, goal, cur, batch_dist_goal, batch_step_norm, st.fk,
+                            waypoint_pose, batch_dist_plan);
+            num_evals += num;
+
+            int best_i = -1;
+            auto select = [&](int i, const char* mode) {
+                best_i = i;
+                best_delta = d_goal - batch_dist_goal[i];
+                best_dist_goal = batch_dist_goal[i];
+                best_step_norm = batch_step_norm[i];
+                best_alpha = grid[i];
+                best_mode = mode;
+                best_dt = dt_local;
+                best_r_model = (1.0f - grid[i]) * r_model_base;
+                best_r_goal = grid[i] * r_goal_base;
+            };
+            for (int i = 0; i < num; ++i) {
+                if (d_goal - batch_dist_goal[i] > best_delta + eps_progress) select(i, "grid");
+            }
+
+            // 計画経路に沿う場合は、目標へ前進する候補のうち経路上の次のスプラットに最も近い候補
+            //   （残りの経路の時間はどの候補も同じなので、次のスプラットまでの距離で比較）
+            if (waypoint_pose) {
+                int plan_i = -1;
+                for (int i = 0; i < num; ++i) {
+                    if (d_goal - batch_dist_goal[i] > eps_progress &&
+                        (plan_i < 0 || batch_dist_plan[i] < batch_dist_plan[plan_i])) plan_i = i;
+                }
+                if (plan_i >= 0) select(plan_i, "plan");
+            }
+            if (best_i >= 0) st.best_pose = st.batch[best_i];
+            evaluated_goal = true;
+        } else if (opt.alpha_search == ALPHA_SEARCH_GOLDEN) {
+            // 黄金分割探索（目標距離の減少量が最大のαを [lo, hi] の縮小で探索、評価回数は alpha_eval_budget まで）
+            //   最後の1回は、最良側の区間が端点 0・1 を含んでいれば端点を評価（単調な場合にグリッドと同じ端点に到達）
+            const float inv_phi = 0.618034f;
+            int budget = std::max(2, (level > 0) ? std::min(opt.alpha_eval_budget, 3) : opt.alpha_eval_budget);
+            int n = 0;
+            if (warm_alpha >= 0.0f) {
+                evaluate_alpha(warm_alpha, "golden");
+                ++n;
+            }
+            if (best_delta <= eps_progress && n + 2 <= budget) {
+                float lo = 0.0f, hi = 1.0f;
+                float x1 = hi - inv_phi * (hi - lo);
+                float x2 = lo + inv_phi * (hi - lo);
+                float f1 = evaluate_alpha(x1, "golden");
+                float f2 = evaluate_alpha(x2, "golden");
+                n += 2;
+                while (n < budget - 1) {
+                    if (f1 >= f2) {
+                        hi = x2; x2 = x1; f2 = f1;
+                        x1 = hi - inv_phi * (hi - lo);
+                        f1 = evaluate_alpha(x1, "golden");
+                    } else {
+                        lo = x1; x1 = x2; f1 = f2;
+                        x2 = lo + inv_phi * (hi - lo);
+                        f2 = evaluate_alpha(x2, "golden");
+                    }
+                    ++n;
+                }
+                if (n < budget) {
+                    float x = (f1 >= f2) ? ((lo <= 0.0f) ? 0.0f : lo + x2 - x1)
+                                         : ((hi >= 1.0f) ? 1.0f : x1 + hi - x2);
+                    evaluate_alpha(x, "golden");
+                }
+            }
+        } else if (level > 0) {
+            for (float alpha_candidate : alpha_candidates_coarse) {
+                evaluate_alpha(alpha_candidate, "grid");
+            }
+        } else {
+            for (float alpha_candidate : alpha_candidates) {
+                evaluate_alpha(alpha_candidate, "grid");
+            }
+        }
+
+        if (best_delta > eps_progress) {
+            advanced = true;
+            break;
+        }
+
+        // フォールバック: α=1 で再評価（黄金分割探索・一括評価で評価済みなら同じ結果になるため省略）
+        if ((opt.alpha_search != ALPHA_SEARCH_GOLDEN && !batch_grid) || force_goal_mode || !evaluated_goal) {
+            evaluate_alpha(1.0f, force_goal_mode ? "force_goal" : "fallback_goal");
+        }
+        if (best_delta > eps_progress) {
+            advanced = true;
+            if (!force_goal_mode && std::strcmp(best_mode, "force_goal") != 0) {
+                best_mode = "fallback_goal";
+            }
+            break;
+        }
+
+        warm_alpha = round_best_alpha;
+        dt_try *= 0.5f;
+        ++dt_backoff;
+    }
+
+    if (!advanced && best_delta <= eps_progress) {
+        return false;
+    }
+
+    bool progressed = (best_delta > eps_progress);
+    int next_stagnation = progressed ? 0 : (st.stagnation_count + 1);
+    bool trigger_force = (!progressed && next_stagnation >= 3);
+
+    // 前進
+    st.t += best_dt;
+    st.cur = st.best_pose;
+
+    info.splat_id = sid;
+    info.dist_goal = best_dist_goal;
+    info.delta_goal = best_delta;
+    info.alpha = best_alpha;
+    info.alpha_mode = best_mode;
+    info.step_norm = best_step_norm;
+    info.dt = best_dt;
+    info.v_ref = v_ref;
+    info.v_min = v_min;
+    info.v_max = v_max;
+    info.used_speed = v_used;
+    info.stopability = s;
+    info.r_model = best_r_model;
+    info.r_goal = best_r_goal;
+    info.num_evals = num_evals;
+    info.dt_backoff = (dt_backoff > 0);
+    info.force_goal = force_goal_mode;
+    info.trigger_force = trigger_force;
+    info.plan_length = plan_length;
+    info.horizon_index = h;
+
+    if (trigger_force) {
+        st.force_goal_steps = 3;
+    }
+    st.stagnation_count = trigger_force ? 0 : next_stagnation;
+    return true;
+}
+
+bool GSModel::FollowHorizon(GenerateRolloutState& st) const {
+    if (st.follow_sid < 0) return false;
+
+    // mean(0)・next(1)・horizon(2..) の列
+    const GaussianSplat& S = splats_[st.follow_sid];
+    const int len = 2 + (int)S.horizon_qposes.size();
+    auto pose_at = [&](int a) -> const QPosture& {
+        return (a == 0) ? S.mean_qpose : (a == 1) ? S.next_qpose : S.horizon_qposes[a - 2];
+    };
+    int a = st.follow_index;
+    float d = FKDistance(st.cur, pose_at(a), st.fk);
+    while (a + 1 < len) {
+        float d_next = FKDistance(st.cur, pose_at(a + 1), st.fk);
+        if (d_next > d) break;
+        d = d_next;
+        ++a;
+    }
+    if (d > S.occ_sigma_m || a + 1 >= len) {
+        st.follow_sid = -1;
+        return false;
+    }
+    st.follow_index = a;
+    return true;
+}
+
+int GSModel::FindRolloutSplat(GenerateRolloutState& st, const GenerateOptions& opt, int level, int* horizon_index) const {
+    *horizon_index = 0;
+    if (opt.use_horizon && FollowHorizon(st)) {
+        *horizon_index = st.follow_index;
+        return st.follow_sid;
+    }
+
+    // 段階 2 では、直前のスプラットの占有半径内に留まる間は全探索を省略
+    int sid = (level >= 2) ? FindNearestSplatApprox(st.cur, st.prev_sid, nullptr, st.fk, opt.draft_level)
+                           : FindNearestSplat(st.cur, nullptr, st.fk, opt.draft_level);
+    ++st.nearest_queries;
+    if (sid < 0) return -1;
+    st.prev_sid = sid;
+    st.follow_sid = (opt.use_horizon && !splats_[sid].horizon_qposes.empty()) ? sid : -1;
+    st.follow_index = 0;
+    return sid;
+}
+
+bool GSModel::ExtendRollout(GenerateRolloutState& st, const GenerateOptions& opt, int level) const {
+    int h = 0;
+    int sid = FindRolloutSplat(st, opt, level, &h);
+    if (sid < 0) return false;
+    const GaussianSplat& S = splats_[sid];
+    float s = (h > 0) ? S.horizon_stopability[h - 1] : S.stopability;
+    if (s >= opt.stopability_th) return false; // 停止可になった
+
+    // そのままモデルフォローで少し進める（将来の姿勢に沿って進む場合はその区間の姿勢・速度）
+    const QPosture& next = (h > 0) ? S.horizon_qposes[h - 1] : S.has_next ? S.next_qpose : S.mean_qpose;
+    float v_ref = ((h > 0) ? S.horizon_v_norm[h - 1] : S.v_norm_ref) * opt.tempo;
+    float d = FKDistance(st.cur, next, st.fk);
+    float r = GSModel::Clamp( safe_div( v_ref * opt.dt_seconds, std::max(1e-6f, d) ), 0.0f, 1.0f );
+    PostureInterpolation(st.cur, next, r, st.candidate, opt.interp_mode);
+    st.cur = st.candidate;
+    st.t += opt.dt_seconds;
+    return true;
 }
@@ -0,0 +1,224 @@
+﻿#include "GSModel.h"
+
+using std::vector;
+
+// 最も粗い階層のクラスタ数の目安（これ以下になるまでまとめる）
+static const int lod_top_clusters = 8;
+
+// まとめる距離の初期値（occ_sigma_m に対する倍率）
+static const float lod_first_link = 1.0f / 16.0f;
+
+// 1つ粗い階層のクラスタ数がこの割合を超える場合は、まとめる距離を √2 倍にしてやり直す
+//   距離が有限でないスプラット（壊れた姿勢など）はどこにもまとまらないため、距離を広げてもまとまるクラスタがなければ打ち切る
+static const float lod_min_shrink = 0.5f;
+
+// 枝刈りの余裕[m]（FK 距離の丸め誤差で線形走査と結果が変わらないように）
+static const float lod_slack_m = 1e-5f;
+
+// root平行移動を除去した関節位置（joint_rmse の va・vb と同じ演算）
+static void relative_joints(const vector<Point3f>& joints, const Point3f& root, vector<float>& out) {
+    out.resize(joints.size() * 3);
+    for (size_t i = 0; i < joints.size(); ++i) {
+        out[3*i + 0] = joints[i].x - root.x;
+        out[3*i + 1] = joints[i].y - root.y;
+        out[3*i + 2] = joints[i].z - root.z;
+    }
+}
+
+// root平行移動を除去した関節位置のRMSE[m]（joint_rmse と同じ演算順、FKDistance と同じ値）
+static float relative_rmse(const float* a, const float* b, int num_joints) {
+    double acc = 0.0;
+    for (int i = 0; i < 3 * num_joints; i += 3) {
+        double dx = double(a[i + 0]) - double(b[i + 0]);
+        double dy = double(a[i + 1]) - double(b[i + 1]);
+        double dz = double(a[i + 2]) - double(b[i + 2]);
+        acc += dx*dx + dy*dy + dz*dz;
+    }
+    return float(std::sqrt(acc / double(num_joints)));
+}
+
+// 下限の小さい順のヒープ
+static bool lod_entry_greater(const FKWorkspace::LODEntry& a, const FKWorkspace::LODEntry& b) {
+    return a.bound > b.bound;
+}
+
+void GSModel::BuildSplatHierarchy(const TrainOptions& opt) {
+    lod_.clear();
+    const int n = (int)splats_.size();
+    if (!opt.build_hierarchy || n == 0) return;
+
+    // 各スプラットの root 平行移動を除去した関節位置
+    FKWorkspace ws;
+    vector<float> joints;
+    int num_joints = 0;
+    for (int i = 0; i < n; ++i) {
+        const QPosture& q = splats_[i].mean_qpose;
+        ForwardKinematics(q, ws.seg_frames, ws.joints_a);
+        relative_joints(ws.joints_a, q.root_pos, ws.query_joints);
+        num_joints = (int)ws.joints_a.size();
+        joints.insert(joints.end(), ws.query_joints.begin(), ws.query_joints.end());
+    }
+    const size_t stride = size_t(3) * num_joints;
+    auto J = [&](int sid) { return &joints[sid * stride]; };
+
+    // 作成中のクラスタ（children は1つ細かい階層のクラスタ番号、members は含まれる全スプラット）
+    struct Group {
+        int center = -1;
+        float radius = 0.0f;
+        vector<int> children;
+        vector<int> members;
+    };
+    vector<vector<Group>> levels(1);
+    levels[0].resize(n);
+    for (int i = 0; i < n; ++i) {
+        levels[0][i].center = i;
+        levels[0][i].members.push_back(i);
+    }
+
+    // 細かい階層から順に、代表スプラットが FK 距離 link 以内のクラスタをまとめる（最も近い先頭のクラスタへ、なければ新しい先頭）
+    //   距離が有限でない場合は新しい先頭（NaN は比較が常に偽になるため明示的に除く）
+    float link = opt.occ_sigma_m * lod_first_link;
+    vector<double> centroid(stride);
+    while ((int)levels.back().size() > lod_top_clusters) {
+        const vector<Group>& prev = levels.back();
+        const int m = (int)prev.size();
+        vector<int> leaders, assign(m);
+        bool can_widen = false;  // link より遠い有限の距離があった（広げればまとまる可能性がある）
+        link *= std::sqrt(2.0f);
+        for (int i = 0; i < m; ++i) {
+            int best = -1;
+            float best_d = link;
+            for (size_t j = 0; j < leaders.size(); ++j) {
+                float d = relative_rmse(J(prev[i].center), J(prev[leaders[j]].center), num_joints);
+                if (!std::isfinite(d)) continue;
+                if (d > link) can_widen = true;
+                if (d <= best_d) {
+                    best_d = d;
+                    best = int(j);
+                }
+            }
+            if (best < 0) {
+                best = (int)leaders.size();
+                leaders.push_back(i);
+            }
+            assign[i] = best;
+        }
+        if (leaders.size() > m * lod_min_shrink) {
+            if (can_widen && std::isfinite(link)) continue;
+            break;
+        }
+
+        vector<Group> next(leaders.size());
+        for (int i = 0; i < m; ++i) {
+            Group& g = next[assign[i]];
+            g.children.push_back(i);
+            g.members.insert(g.members.end(), prev[i].members.begin(), prev[i].members.end());
+        }
+
+        // 代表スプラット：メンバーの関節位置の重心に最も近いスプラット、被覆半径：代表→メンバーの FK 距離の最大値
+        for (Group& g : next) {
+            std::fill(centroid.begin(), centroid.end(), 0.0);
+            for (int sid : g.members)
+                for (size_t e = 0; e < stride; ++e) centroid[e] += J(sid)[e];
+            for (size_t e = 0; e < stride; ++e) centroid[e] /= double(g.members.size());
+            double best_c = std::numeric_limits<double>::infinity();
+            for (int sid : g.members) {
+                double c = 0.0;
+                for (size_t e = 0; e < stride; ++e) c += (J(sid)[e] - centroid[e]) * (J(sid)[e] - centroid[e]);
+                if (c < best_c || (c == best_c && sid < g.center)) {
+                    best_c = c;
+                    g.center = sid;
+                }
+            }
+            if (g.center < 0) g.center = g.members.front();  // 関節位置が有限でないスプラットのみのクラスタ
+            for (int sid : g.members)
+                g.radius = std::max(g.radius, relative_rmse(J(g.center), J(sid), num_joints));
+        }
+        levels.push_back(std::move(next));
+    }
+
+    // 粗い階層から順に、各クラスタの子が1つ細かい階層の連続した範囲になるように並べる
+    const int num_levels = (int)levels.size();
+    lod_.resize(num_levels);
+    vector<int> order(levels.back().size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = int(i);
+    for (int k = num_levels - 1; k >= 0; --k) {
+        SplatLevel& L = lod_[k];
+        vector<int> child_order;
+        L.nodes.resize(order.size());
+        L.joints.resize(order.size() * stride);
+        for (size_t i = 0; i < order.size(); ++i) {
+            const Group& g = levels[k][order[i]];
+            SplatCluster& c = L.nodes[i];
+            c.center = g.center;
+            c.radius = g.radius;
+            c.first_child = (int)child_order.size();
+            c.num_children = (int)g.children.size();
+            child_order.insert(child_order.end(), g.children.begin(), g.children.end());
+            std::copy(J(g.center), J(g.center) + stride, &L.joints[i * stride]);
+        }
+        order.swap(child_order);
+    }
+}
+
+int GSModel::FindNearestSplatLOD(const QPosture& p, int level, float* out_dist, FKWorkspace& ws) const {
+    int best = -1;
+    float best_d = std::numeric_limits<float>::infinity();
+    if (!IsCompatible(p)) {
+        if (out_dist) *out_dist = best_d;
+        return best;
+    }
+    const int top = (int)lod_.size() - 1;
+    level = std::max(0, std::min(level, top));
+
+    ForwardKinematics(p, ws.seg_frames, ws.joints_a);
+    relative_joints(ws.joints_a, p.root_pos, ws.query_joints);
+    const int num_joints = (int)ws.joints_a.size();
+    const size_t stride = size_t(3) * num_joints;
+    const float* q = ws.query_joints.data();
+
+    // クラスタの代表スプラットとの距離を計算し、最近傍の候補の更新・子を探索する場合はヒープに追加
+    //   level = 0 では全ての代表スプラットが候補、level > 0 では階層 level の代表スプラットのみが候補
+    //   親と代表スプラットが同じ子は親の距離を使う
+    vector<FKWorkspace::LODEntry>& heap = ws.lod_heap;
+    heap.clear();
+    if (heap.capacity() == 0) {
+        size_t num_nodes = 0;
+        for (const SplatLevel& L : lod_) num_nodes += L.nodes.size();
+        heap.reserve(num_nodes);
+    }
+    auto visit = [&](int k, int i, int parent_center, float parent_d) {
+        const SplatCluster& c = lod_[k].nodes[i];
+        float d = parent_d;
+        if (c.center != parent_center) {
+            d = relative_rmse(q, &lod_[k].joints[i * stride], num_joints);
+            ++ws.nearest_evals;
+        }
+        if ((k == level || level == 0) && (d < best_d || (d == best_d && c.center < best))) {
+            best_d = d;
+            best = c.center;
+        }
+        if (k > level && d - c.radius <= best_d + lod_slack_m) {
+            FKWorkspace::LODEntry e;
+            e.bound = d - c.radius;
+            e.dist = d;
+            e.level = k;
+            e.node = i;
+            heap.push_back(e);
+            std::push_heap(heap.begin(), heap.end(), lod_entry_greater);
+        }
+    };
+
+    for (int i = 0; i < (int)lod_[top].nodes.size(); ++i) visit(top, i, -1, 0.0f);
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), lod_entry_greater);
+        const FKWorkspace::LODEntry e = heap.back();
+        heap.pop_back();
+        if (e.bound > best_d + lod_slack_m) break;
+        const SplatCluster& c = lod_[e.level].nodes[e.node];
+        for (int i = c.first_child; i < c.first_child + c.num_children; ++i)
+            visit(e.level - 1, i, c.center, e.dist);
+    }
+    if (out_dist) *out_dist = best_d;
+    return best;
+}
@@ -0,0 +1,285 @@
+﻿#include "GSModel.h"
+
+#include <queue>
+#include <mutex>
+#include <unordered_map>
+#include <cstdint>
+
+using std::vector;
+
+// 辺の時間の計算に使う速度の下限[m/s]（GenerateOptions::v_floor_mps の既定値と同じ、停止に近いスプラットから出る辺の時間の発散を防ぐ）
+static const float graph_v_floor = 0.20f;
+
+// 近傍遷移の辺の時間の倍率（データ上の遷移を優先）
+static const float graph_neighbor_penalty = 1.25f;
+
+// 経路キャッシュ（開始・目標のスプラットの組 → 経路、到達できない組は空の経路）
+struct GSModel::PlanCache {
+    static const size_t max_entries = 4096;  // 超えたら全て破棄
+    std::mutex mutex;
+    std::unordered_map<uint64_t, vector<int>> paths;
+    long long hits = 0;
+    long long misses = 0;
+};
+
+void GSModel::BuildTransitionGraph(const TrainOptions& opt) {
+    const int n = (int)splats_.size();
+    graph_offsets_.clear();
+    graph_edges_.clear();
+    graph_max_speed_ = 0.0f;
+    plan_cache_.reset();
+    landmarks_.clear();
+    splat_landmark_.clear();
+    if (!opt.build_graph || n == 0) return;
+    graph_offsets_.assign(n + 1, 0);
+    plan_cache_ = std::make_shared<PlanCache>();
+    splat_landmark_.assign(n, -1);
+
+    // 各スプラットの mean・next_pose と全スプラットの mean との FK 距離を一括計算
+    vector<const QPosture*> means(n);
+    for (int i = 0; i < n; ++i) means[i] = &splats_[i].mean_qpose;
+    vector<float> d_mean(n), d_next(n);
+    vector<int> order(n);
+    FKWorkspace ws;
+
+    for (int i = 0; i < n; ++i) {
+        const GaussianSplat& S = splats_[i];
+        const QPosture& next = S.has_next ? S.next_qpose : S.mean_qpose;
+        FKDistanceBatch(means.data(), n, S.mean_qpose, next, d_mean.data(), d_next.data(), ws);
+        const float speed = std::max(S.v_norm_ref, graph_v_floor);
+
+        // データ上の遷移：next_pose の最近傍スプラット（自分自身なら辺なし）
+        int succ = -1;
+        if (S.has_next) {
+            succ = int(std::min_element(d_next.begin(), d_next.end()) - d_next.begin());
+            if (succ == i) succ = -1;
+        }
+        if (succ >= 0) {
+            SplatEdge e;
+            e.to = succ;
+            e.cost = d_mean[succ] / speed;
+            e.successor = true;
+            graph_edges_.push_back(e);
+        }
+
+        // 近傍遷移：FK距離の近い順に graph_neighbors 個（graph_radius_m 以内）
+        for (int j = 0; j < n; ++j) order[j] = j;
+        int k = std::min(std::max(opt.graph_neighbors, 0), n - 1);
+        std::partial_sort(order.begin(), order.begin() + std::min(n, k + 2), order.end(),
+                          [&](int a, int b) { return d_mean[a] < d_mean[b] || (d_mean[a] == d_mean[b] && a < b); });
+        for (int r = 0, added = 0; r < n && added < k; ++r) {
+            int j = order[r];
+            if (j == i) continue;
+            if (d_mean[j] > opt.graph_radius_m) break;
+            ++added;
+            if (j == succ) continue;
+            SplatEdge e;
+            e.to = j;
+            e.cost = d_mean[j] / speed * graph_neighbor_penalty;
+            graph_edges_.push_back(e);
+        }
+        graph_offsets_[i + 1] = (int)graph_edges_.size();
+        if (graph_offsets_[i + 1] > graph_offsets_[i]) graph_max_speed_ = std::max(graph_max_speed_, speed);
+    }
+}
+
+void GSModel::PreparePlanWorkspace(PlanWorkspace& ws) const {
+    const size_t n = splats_.size();
+    if (ws.cost.capacity() < n) {
+        ws.cost.reserve(n);
+        ws.h.reserve(n);
+        ws.parent.reserve(n);
+        ws.closed.reserve(n);
+    }
+    ws.open.reserve(graph_edges_.size() + 1);  // 各辺で高々1回追加
+    if (n > 0 && ws.fk.joints_a.empty()) FKDistance(splats_[0].mean_qpose, splats_[0].mean_qpose, ws.fk);
+}
+
+bool GSModel::PlanSplatPath(int start_sid, int goal_sid, vector<int>& path) const {
+    PlanWorkspace ws;
+    return PlanSplatPath(start_sid, goal_sid, path, ws);
+}
+
+bool GSModel::PlanSplatPath(int start_sid, int goal_sid, vector<int>& path, PlanWorkspace& ws) const {
+    path.clear();
+    const int n = (int)splats_.size();
+    if (start_sid < 0 || start_sid >= n || goal_sid < 0 || goal_sid >= n) return false;
+    if (start_sid == goal_sid) {
+        path.push_back(start_sid);
+        return true;
+    }
+    if ((int)graph_offsets_.size() != n + 1) return false;  // 遷移グラフなし
+
+    // キャッシュ
+    const uint64_t key = (uint64_t(uint32_t(start_sid)) << 32) | uint32_t(goal_sid);
+    if (plan_cache_) {
+        std::lock_guard<std::mutex> lock(plan_cache_->mutex);
+        auto it = plan_cache_->paths.find(key);
+        if (it != plan_cache_->paths.end()) {
+            ++plan_cache_->hits;
+            path = it->second;
+            return !path.empty();
+        }
+        ++plan_cache_->misses;
+    }
+
+    // A*（ヒューリスティックは目標のスプラットとの FK 距離を辺の最大速度で移動する時間、各辺の時間以下なので許容的）
+    const float inf = std::numeric_limits<float>::infinity();
+    vector<float>& cost = ws.cost;
+    vector<float>& h = ws.h;
+    vector<int>& parent = ws.parent;
+    vector<char>& closed = ws.closed;
+    cost.assign(n, inf);
+    h.assign(n, -1.0f);
+    parent.assign(n, -1);
+    closed.assign(n, 0);
+    auto heuristic = [&](int v) {
+        if (h[v] < 0.0f) {
+            h[v] = (graph_max_speed_ > 0.0f)
+                 ? FKDistance(splats_[v].mean_qpose, splats_[goal_sid].mean_qpose, ws.fk) / graph_max_speed_
+                 : 0.0f;
+        }
+        return h[v];
+    };
+    typedef std::pair<float, int> Entry;
+    const std::greater<Entry> later;  // 最小ヒープ（std::priority_queue<Entry, vector<Entry>, std::greater<Entry>> と同じ順）
+    vector<Entry>& open = ws.open;
+    open.clear();
+    auto push = [&](float f, int v) {
+        open.push_back(Entry(f, v));
+        std::push_heap(open.begin(), open.end(), later);
+    };
+    cost[start_sid] = 0.0f;
+    push(heuristic(start_sid), start_sid);
+    while (!open.empty()) {
+        std::pop_heap(open.begin(), open.end(), later);
+        int u = open.back().second;
+        open.pop_back();
+        if (closed[u]) continue;
+        closed[u] = 1;
+        if (u == goal_sid) break;
+        for (int e = graph_offsets_[u]; e < graph_offsets_[u + 1]; ++e) {
+            const SplatEdge& E = graph_edges_[e];
+            float c = cost[u] + E.cost;
+            if (!closed[E.to] && c < cost[E.to]) {
+                cost[E.to] = c;
+                parent[E.to] = u;
+                push(c + heuristic(E.to), E.to);
+            }
+        }
+    }
+    if (closed[goal_sid]) {
+        for (int v = goal_sid; v >= 0; v = parent[v]) path.push_back(v);
+        std::reverse(path.begin(), path.end());
+    }
+
+    if (plan_cache_) {
+        std::lock_guard<std::mutex> lock(plan_cache_->mutex);
+        if (plan_cache_->paths.size() >= PlanCache::max_entries) plan_cache_->paths.clear();
+        plan_cache_->paths[key] = path;
+    }
+    return !path.empty();
+}
+
+void GSModel::GetPlanCacheStats(long long* hits, long long* misses) const {
+    long long h = 0, m = 0;
+    if (plan_cache_) {
+        std::lock_guard<std::mutex> lock(plan_cache_->mutex);
+        h = plan_cache_->hits;
+        m = plan_cache_->misses;
+    }
+    if (hits) *hits = h;
+    if (misses) *misses = m;
+}
+
+int GSModel::RegisterGoal(const QPosture& goal) {
+    const int n = (int)splats_.size();
+    if (n == 0 || (int)graph_offsets_.size() != n + 1) return -1;  // 遷移グラフなし
+    int goal_sid = FindNearestSplat(goal);
+    if (goal_sid < 0) return -1;
+    if (splat_landmark_[goal_sid] >= 0) return splat_landmark_[goal_sid];  // 同じスプラットを目標とする表は共有
+
+    // 逆向きの辺（スプラット j への辺の元 → 辺の番号）
+    vector<int> rev_offsets(n + 1, 0), rev_edges(graph_edges_.size());
+    for (const SplatEdge& e : graph_edges_) ++rev_offsets[e.to + 1];
+    for (int i = 0; i < n; ++i) rev_offsets[i + 1] += rev_offsets[i];
+    vector<int> fill(rev_offsets.begin(), rev_offsets.end() - 1);
+    vector<int> edge_from(graph_edges_.size());
+    for (int i = 0; i < n; ++i) {
+        for (int e = graph_offsets_[i]; e < graph_offsets_[i + 1]; ++e) {
+            rev_edges[fill[graph_edges_[e].to]++] = e;
+            edge_from[e] = i;
+        }
+    }
+
+    // 目標のスプラットから逆向きに Dijkstra（各スプラットの最短時間と、その最短経路上の次のスプラット）
+    GoalLandmark L;
+    L.goal_sid = goal_sid;
+    L.cost_to_go.assign(n, std::numeric_limits<float>::infinity());
+    L.next_sid.assign(n, -1);
+    vector<char> closed(n, 0);
+    typedef std::pair<float, int> Entry;
+    std::priority_queue<Entry, vector<Entry>, std::greater<Entry>> open;
+    L.cost_to_go[goal_sid] = 0.0f;
+    open.push(Entry(0.0f, goal_sid));
+    while (!open.empty()) {
+        int v = open.top().second;
+        open.pop();
+        if (closed[v]) continue;
+        closed[v] = 1;
+        for (int r = rev_offsets[v]; r < rev_offsets[v + 1]; ++r) {
+            int e = rev_edges[r];
+            int u = edge_from[e];
+            float c = L.cost_to_go[v] + graph_edges_[e].cost;
+            if (!closed[u] && c < L.cost_to_go[u]) {
+                L.cost_to_go[u] = c;
+                L.next_sid[u] = v;
+                open.push(Entry(c, u));
+            }
+        }
+    }
+
+    splat_landmark_[goal_sid] = (int)landmarks_.size();
+    landmarks_.push_back(std::move(L));
+    return splat_landmark_[goal_sid];
+}
+
+int GSModel::FollowPlan(GenerateRolloutState& st, int sid, int* plan_length, float* time_to_go) const {
+    *plan_length = 0;
+    *time_to_go = 0.0f;
+    if (st.goal_sid < 0) return -1;
+
+    // 目標表があれば表を参照（到達できないスプラットでは探索せずに経路なし）
+    if (st.landmark >= 0) {
+        const GoalLandmark& L = landmarks_[st.landmark];
+        *time_to_go = L.cost_to_go[sid];
+        return L.next_sid[sid];
+    }
+
+    // 現在のスプラットが経路上になければ、現在のスプラットから再計画
+    auto it = std::find(st.plan.begin(), st.plan.end(), sid);
+    if (it == st.plan.end()) {
+        PlanSplatPath(sid, st.goal_sid, st.plan, st.planner);
+        ++st.plans;
+        *plan_length = (int)st.plan.size();
+        if (st.plan.empty()) return -1;
+
+        // 各スプラットから目標のスプラットまでの時間（経路の辺の時間の後ろからの累積）
+        st.plan_time.assign(st.plan.size(), 0.0f);
+        for (int i = (int)st.plan.size() - 2; i >= 0; --i) {
+            float c = 0.0f;
+            for (int e = graph_offsets_[st.plan[i]]; e < graph_offsets_[st.plan[i] + 1]; ++e) {
+                if (graph_edges_[e].to == st.plan[i + 1]) {
+                    c = graph_edges_[e].cost;
+                    break;
+                }
+            }
+            st.plan_time[i] = st.plan_time[i + 1] + c;
+        }
+        it = st.plan.begin();
+    }
+    st.plan_index = int(it - st.plan.begin());
+    *time_to_go = st.plan_time[st.plan_index];
+    if (st.plan_index + 1 >= (int)st.plan.size()) return -1;  // 目標のスプラットに到達済み
+    return st.plan[st.plan_index + 1];
+}
@@ -1,10 +1,16 @@
 ﻿#include "GSModel.h"
+#include "BVH.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <random>
 
 using std::vector;
 using std::string;
 
 GSModelBuilder::GSModelBuilder(const HumanBody& human, const TrainOptions& opt)
-    : human_(human), opt_(opt) {}
+    : human_(human), opt_(opt), stream_fk_(human) {}
 
 void GSModelBuilder::AddMotion(const Motion& m) {
     // スケルトン整合性チェック（HumanBodyのSkeletonと同一）
@@ -14,6 +20,45 @@ void GSModelBuilder::AddMotion(const Motion& m) {
     motions_.push_back(&m);
 }
 
+void GSModelBuilder::AppendSplat(const GSModel& fk, const Posture& cur, const Posture& nxt,
+                                 const std::string& name, int frame, float interval,
+                                 std::vector<GaussianSplat>& out) const {
+    GaussianSplat g;
+    g.id = int(out.size());
+    if (opt_.keep_matrix_poses) {
+        g.mean_pose = cur;
+        g.next_pose = nxt;
+    }
+    g.mean_qpose.SetPosture(cur);
+    g.next_qpose.SetPosture(nxt);
+    g.has_next  = true;
+    g.occ_sigma_m = opt_.occ_sigma_m;
+    g.source_motion = name;
+    g.source_frame  = frame;
+    g.source_interval = interval;
+
+    // 速度ノルム（FK距離 / s）
+    float dist = fk.FKDistance(cur, nxt);
+    float v = (interval > 0.0f) ? dist / interval : dist;
+    g.v_norm_ref = std::max(0.001f, v);
+    g.v_norm_min = 0.5f * g.v_norm_ref;
+    g.v_norm_max = 2.0f * g.v_norm_ref;
+
+    // 停止可能性：しきい値以下は高め、以上は低め（連続化）
+    // s = clamp(1 - v / th, 0, 1)
+    float s = 1.0f - (g.v_norm_ref / std::max(1e-4f, opt_.stop_v_threshold));
+    g.stopability = GSModel::Clamp(s, 0.0f, 1.0f);
+
+    out.push_back(std::move(g));
+}
+
+void GSModelBuilder::AppendHorizon(const Posture& p, float v_norm, GaussianSplat& g) const {
+    g.horizon_qposes.emplace_back(p);
+    g.horizon_v_norm.push_back(std::max(0.001f, v_norm));
+    float s = 1.0f - (g.horizon_v_norm.back() / std::max(1e-4f, opt_.stop_v_threshold));
+    g.horizon_stopability.push_back(GSModel::Clamp(s, 0.0f, 1.0f));
+}
+
 void GSModelBuilder::AppendMotionSplats(const Motion& m, std::vector<GaussianSplat>& out) const {
     const int N = m.num_frames;
     if (N <= 1) return;
@@ -21,36 +66,102 @@ void GSModelBuilder::AppendMotionSplats(const Motion& m, std::vector<GaussianSpl
     // 代表姿勢の距離計算用に一時モデルを用意（FK距離を使うため）
     GSModel temp(human_);
 
+    // 将来の姿勢の速度（フレーム f-1 → f、必要な場合のみ）
+    vector<float> frame_v;
+    if (opt_.horizon_steps > 0) {
+        frame_v.assign(N, 0.0f);
+        for (int f = 1; f < N; ++f) {
+            float dist = temp.FKDistance(*m.GetFrame(f - 1), *m.GetFrame(f));
+            frame_v[f] = (m.interval > 0.0f) ? dist / m.interval : dist;
+        }
+    }
+
     for (int i = 0; i < N - 1; i += std::max(1, opt_.sample_stride)) {
-        const Posture& cur = *m.GetFrame(i);
-        const Posture& nxt = *m.GetFrame(i + 1);
+        AppendSplat(temp, *m.GetFrame(i), *m.GetFrame(i + 1), m.name, i, m.interval, out);
+        for (int f = i + 2; f < N && f <= i + 1 + opt_.horizon_steps; ++f) {
+            AppendHorizon(*m.GetFrame(f), frame_v[f], out.back());
+        }
+    }
 
-        GaussianSplat g;
-        g.id = int(out.size());
-        g.mean_pose = cur;
-        g.next_pose = nxt;
-        g.has_next  = true;
-        g.occ_sigma_m = opt_.occ_sigma_m;
-        g.source_motion = m.name;
-        g.source_frame  = i;
-        g.source_interval = m.interval;
+    // 最終フレームは next が無いのでオプション：必要なら追加（ここでは追加しない）
+}
 
-        // 速度ノルム（FK距離 / s）
-        float dist = temp.FKDistance(cur, nxt);
-        float v = (m.interval > 0.0f) ? dist / m.interval : dist;
-        g.v_norm_ref = std::max(0.001f, v);
-        g.v_norm_min = 0.5f * g.v_norm_ref;
-        g.v_norm_max = 2.0f * g.v_norm_ref;
+void GSModelBuilder::BeginStream(const std::string& name, float interval) {
+    if (stream_frame_ >= 0) {
+        throw std::runtime_error("GSModelBuilder::BeginStream: previous stream is not ended.");
+    }
+    stream_name_ = name;
+    stream_interval_ = interval;
+    stream_frame_ = 0;
+    stream_pending_.clear();
+    if (stream_prev_.body != human_.GetSkeleton()) {
+        stream_prev_.Init(human_.GetSkeleton());
+    }
+}
 
-        // 停止可能性：しきい値以下は高め、以上は低め（連続化）
-        // s = clamp(1 - v / th, 0, 1)
-        float s = 1.0f - (g.v_norm_ref / std::max(1e-4f, opt_.stop_v_threshold));
-        g.stopability = GSModel::Clamp(s, 0.0f, 1.0f);
+void GSModelBuilder::AddFrame(const Posture& p) {
+    if (stream_frame_ < 0) {
+        throw std::runtime_error("GSModelBuilder::AddFrame: BeginStream is not called.");
+    }
+    if (p.body != human_.GetSkeleton()) {
+        throw std::runtime_error("GSModelBuilder::AddFrame: Skeleton mismatch.");
+    }
 
-        out.push_back(std::move(g));
+    // 将来の姿勢が揃っていないスプラットに追加（揃えば対象から外す）
+    const int i = stream_frame_ - 1;
+    if (!stream_pending_.empty()) {
+        float dist = stream_fk_.FKDistance(stream_prev_, p);
+        float v = (stream_interval_ > 0.0f) ? dist / stream_interval_ : dist;
+        size_t n = 0;
+        for (int k : stream_pending_) {
+            AppendHorizon(p, v, stream_splats_[k]);
+            if ((int)stream_splats_[k].horizon_qposes.size() < opt_.horizon_steps) stream_pending_[n++] = k;
+        }
+        stream_pending_.resize(n);
     }
 
-    // 最終フレームは next が無いのでオプション：必要なら追加（ここでは追加しない）
+    // 直前のフレームと組にしてスプラットを作成（AppendMotionSplats と同じ間引き）
+    if (i >= 0 && i % std::max(1, opt_.sample_stride) == 0) {
+        AppendSplat(stream_fk_, stream_prev_, p, stream_name_, i, stream_interval_, stream_splats_);
+        if (opt_.horizon_steps > 0) stream_pending_.push_back((int)stream_splats_.size() - 1);
+    }
+    stream_prev_ = p;
+    ++stream_frame_;
+}
+
+void GSModelBuilder::EndStream() {
+    stream_frame_ = -1;
+    stream_pending_.clear();
+}
+
+void GSModelBuilder::AddBVHStream(const char* bvh_file_name) {
+    BVH bvh;
+    BVHPosturePlan plan;
+    if (!bvh.OpenStream(bvh_file_name) || !InitBVHPosturePlan(&bvh, human_.GetSkeleton(), plan)) {
+        throw std::runtime_error(std::string("GSModelBuilder::AddBVHStream: cannot read ") + bvh_file_name);
+    }
+
+    // 小さな窓単位でフレームを読み込み、姿勢に変換して逐次追加（窓の領域は再利用）
+    const int window = 64;
+    const int nc = bvh.GetNumChannel();
+    vector<double> values(size_t(window) * nc);
+    vector<Posture> poses(window, Posture(human_.GetSkeleton()));
+
+    BeginStream(bvh.GetMotionName(), float(bvh.GetInterval()));
+    for (int f = 0; f < bvh.GetNumFrame(); f += window) {
+        const int n = std::min(window, bvh.GetNumFrame() - f);
+        for (int k = 0; k < n; ++k) {
+            if (!bvh.ReadFrame(&values[size_t(k) * nc])) {
+                EndStream();
+                throw std::runtime_error(std::string("GSModelBuilder::AddBVHStream: broken motion data in ") + bvh_file_name);
+            }
+        }
+        GetBVHPostures(plan, values.data(), nc, n, poses.data());
+        for (int k = 0; k < n; ++k) {
+            AddFrame(poses[k]);
+        }
+    }
+    EndStream();
 }
 
 void GSModelBuilder::MergeNearby(std::vector<GaussianSplat>& splats) const {
@@ -63,12 +174,17 @@ void GSModelBuilder::MergeNearby(std::vector<GaussianSplat>& splats) const {
         if (removed[i]) continue;
         for (size_t j = i + 1; j < splats.size(); ++j) {
             if (removed[j]) continue;
-            float d = temp.FKDistance(splats[i].mean_pose, splats[j].mean_pose);
+            float d = temp.FKDistance(splats[i].mean_qpose, splats[j].mean_qpose);
             if (d <= opt_.merge_radius_m) {
                 // 近傍：iへ吸収（meanは簡易に「より停止可能な方」を優先）
                 if (splats[j].stopability > splats[i].stopability) {
                     splats[i].mean_pose = splats[j].mean_pose;
                     splats[i].next_pose = splats[j].next_pose;
+                    splats[i].mean_qpose = splats[j].mean_qpose;
+                    splats[i].next_qpose = splats[j].next_qpose;
+                    splats[i].horizon_qposes = splats[j].horizon_qposes;
+                    splats[i].horizon_v_norm = splats[j].horizon_v_norm;
+                    splats[i].horizon_stopability = splats[j].horizon_stopability;
                 }
                 // 速度レンジは平均的に更新
                 splats[i].v_norm_ref = 0.5f * (splats[i].v_norm_ref + splats[j].v_norm_ref);
@@ -92,14 +208,317 @@ void GSModelBuilder::MergeNearby(std::vector<GaussianSplat>& splats) const {
     splats.swap(compact);
 }
 
+// [0, num) を num_threads 個のスレッドで分割して fn(begin, end) を実行（スレッドは作成時に起動し、破棄まで使い回す）
+struct RangeWorkers {
+    int num_threads = 1;
+    vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable start_cv, done_cv;
+    const std::function<void(int, int)>* fn = nullptr;
+    int num = 0, chunk = 0, pending = 0;
+    unsigned generation = 0;
+    bool quit = false;
+
+    explicit RangeWorkers(int n) : num_threads(std::max(1, n)) {
+        for (int t = 1; t < num_threads; ++t) threads.push_back(std::thread(&RangeWorkers::Loop, this, t));
+    }
+    ~RangeWorkers() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        start_cv.notify_all();
+        for (auto& w : threads) w.join();
+    }
+
+    void Run(int n, const std::function<void(int, int)>& f) {
+        const int used = std::max(1, std::min(num_threads, n));
+        if (used == 1) {
+            f(0, n);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            fn = &f;
+            num = n;
+            chunk = (n + used - 1) / used;
+            pending = (int)threads.size();
+            ++generation;
+        }
+        start_cv.notify_all();
+        f(0, std::min(n, chunk));
+        std::unique_lock<std::mutex> lock(mutex);
+        done_cv.wait(lock, [&] { return pending == 0; });
+    }
+
+    // スレッド t は t 番目の範囲を担当（範囲が空なら何もしない）
+    void Loop(int t) {
+        unsigned seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            start_cv.wait(lock, [&] { return quit || generation != seen; });
+            if (quit) return;
+            seen = generation;
+            const int b = t * chunk, e = std::min(num, b + chunk);
+            const std::function<void(int, int)>* f = fn;
+            lock.unlock();
+            if (b < e) (*f)(b, e);
+            lock.lock();
+            if (--pending == 0) done_cv.notify_one();
+        }
+    }
+};
+
+// 特徴ベクトルの二乗距離
+static float squared_distance(const float* a, const float* b, int dim) {
+    float acc = 0.0f;
+    for (int e = 0; e < dim; ++e) {
+        float d = a[e] - b[e];
+        acc += d * d;
+    }
+    return acc;
+}
+
+// 最も近い中心（同じ距離なら番号の小さい方）
+static int nearest_center(const float* x, const vector<float>& centers, int k, int dim, float* out_d2 = nullptr) {
+    int best = 0;
+    float best_d2 = std::numeric_limits<float>::infinity();
+    for (int c = 0; c < k; ++c) {
+        float d2 = squared_distance(x, &centers[size_t(c) * dim], dim);
+        if (d2 < best_d2) {
+            best_d2 = d2;
+            best = c;
+        }
+    }
+    if (out_d2) *out_d2 = best_d2;
+    return best;
+}
+
+// 回転の平均（q0 と同じ半球に揃えた和の正規化）
+static void accumulate_rotation(const Quat4f& q, const Quat4f& q0, double* sum) {
+    double s = (double(q.x)*q0.x + double(q.y)*q0.y + double(q.z)*q0.z + double(q.w)*q0.w < 0.0) ? -1.0 : 1.0;
+    sum[0] += s * q.x;
+    sum[1] += s * q.y;
+    sum[2] += s * q.z;
+    sum[3] += s * q.w;
+}
+
+static Quat4f average_rotation(const double* sum) {
+    Quat4f q((float)sum[0], (float)sum[1], (float)sum[2], (float)sum[3]);
+    q.normalize();
+    return q;
+}
+
+void GSModelBuilder::ClusterSplats(std::vector<GaussianSplat>& splats) const {
+    const int n = (int)splats.size();
+    const int k = std::min(opt_.target_splats, n);
+    if (k <= 0 || k == n) return;
+
+    int num_threads = opt_.cluster_threads;
+    if (num_threads <= 0) num_threads = std::max(1, (int)std::thread::hardware_concurrency());
+    RangeWorkers workers(std::min(num_threads, n));
+
+    // 特徴：各スプラットの root 平行移動を除去した関節位置（FK距離は特徴のユークリッド距離に比例）
+    const Skeleton* body = human_.GetSkeleton();
+    const int dim = 3 * body->num_joints;
+    vector<float> features(size_t(n) * dim);
+    workers.Run(n, [&](int begin, int end) {
+        vector<Matrix4f> seg_frames;
+        vector<Point3f> joints;
+        for (int i = begin; i < end; ++i) {
+            const QPosture& q = splats[i].mean_qpose;
+            ForwardKinematics(q, seg_frames, joints);
+            float* x = &features[size_t(i) * dim];
+            for (int j = 0; j < body->num_joints; ++j) {
+                x[3*j + 0] = joints[j].x - q.root_pos.x;
+                x[3*j + 1] = joints[j].y - q.root_pos.y;
+                x[3*j + 2] = joints[j].z - q.root_pos.z;
+            }
+        }
+    });
+    auto X = [&](int i) { return &features[size_t(i) * dim]; };
+
+    // 初期中心（k-means++、最も近い中心との二乗距離に比例した確率で選択）
+    std::mt19937 rng((unsigned)opt_.cluster_seed);
+    vector<float> centers(size_t(k) * dim);
+    vector<float> d2(n, std::numeric_limits<float>::infinity());
+    int pick = int(rng() % unsigned(n));
+    for (int c = 0; c < k; ++c) {
+        std::copy(X(pick), X(pick) + dim, &centers[size_t(c) * dim]);
+        const float* center = &centers[size_t(c) * dim];
+        workers.Run(n, [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) d2[i] = std::min(d2[i], squared_distance(X(i), center, dim));
+        });
+        double total = 0.0;
+        for (int i = 0; i < n; ++i) total += d2[i];
+        if (total <= 0.0) {
+            // 残りの特徴が全て既存の中心と同じ（これ以上のクラスタは空になる）
+            centers.resize(size_t(c + 1) * dim);
+            break;
+        }
+        double r = std::uniform_real_distribution<double>(0.0, total)(rng);
+        pick = n - 1;
+        for (int i = 0; i < n; ++i) {
+            r -= d2[i];
+            if (r < 0.0) {
+                pick = i;
+                break;
+            }
+        }
+    }
+    const int num_centers = int(centers.size() / dim);
+
+    // ミニバッチ k-means（割り当ては並列、中心の更新は学習率 1/割り当て数でバッチの順に逐次）
+    const int batch = std::max(1, std::min(opt_.cluster_batch, n));
+    vector<int> batch_ids(batch), batch_assign(batch);
+    vector<int> counts(num_centers, 0);
+    for (int it = 0; it < opt_.cluster_iters; ++it) {
+        for (int b = 0; b < batch; ++b) batch_ids[b] = int(rng() % unsigned(n));
+        workers.Run(batch, [&](int begin, int end) {
+            for (int b = begin; b < end; ++b) batch_assign[b] = nearest_center(X(batch_ids[b]), centers, num_centers, dim);
+        });
+        for (int b = 0; b < batch; ++b) {
+            const int c = batch_assign[b];
+            const float eta = 1.0f / float(++counts[c]);
+            float* center = &centers[size_t(c) * dim];
+            const float* x = X(batch_ids[b]);
+            for (int e = 0; e < dim; ++e) center[e] += eta * (x[e] - center[e]);
+        }
+    }
+
+    // 全スプラットの割り当て（メンバーのないクラスタは除く）
+    vector<int> assign(n);
+    workers.Run(n, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) assign[i] = nearest_center(X(i), centers, num_centers, dim);
+    });
+    vector<vector<int>> members(num_centers);
+    for (int i = 0; i < n; ++i) members[assign[i]].push_back(i);
+
+    // 代表：メンバーの特徴の重心に最も近いメンバー（学習データの順に並べる）
+    vector<int> medoids;
+    vector<double> centroid(dim);
+    for (int c = 0; c < num_centers; ++c) {
+        if (members[c].empty()) continue;
+        std::fill(centroid.begin(), centroid.end(), 0.0);
+        for (int i : members[c])
+            for (int e = 0; e < dim; ++e) centroid[e] += X(i)[e];
+        for (int e = 0; e < dim; ++e) centroid[e] /= double(members[c].size());
+        int best = -1;
+        double best_d2 = std::numeric_limits<double>::infinity();
+        for (int i : members[c]) {
+            double s = 0.0;
+            for (int e = 0; e < dim; ++e) s += (X(i)[e] - centroid[e]) * (X(i)[e] - centroid[e]);
+            if (s < best_d2) {
+                best_d2 = s;
+                best = i;
+            }
+        }
+        medoids.push_back(best);
+    }
+    std::sort(medoids.begin(), medoids.end());
+
+    // 各クラスタのスプラット（姿勢・由来は代表から、next_pose・将来の姿勢・速度・停止可能性はメンバーから集計）
+    //   mean → next → horizon の列の各区間 s（s = 0 は mean→next、s = h + 1 は horizon[h - 1]→horizon[h]、horizon[-1] は next）ごとに、
+    //   その区間を持つメンバーの変化を平均し、代表の mean から順に適用（将来の姿勢の数は代表と同じ）
+    auto pose_at = [](auto& S, int s) -> auto& {
+        return (s == 0) ? S.mean_qpose : (s == 1) ? S.next_qpose : S.horizon_qposes[s - 2];
+    };
+    vector<GaussianSplat> clustered;
+    clustered.reserve(medoids.size());
+    vector<double> rot_sum(size_t(4) * (body->num_joints + 1));
+    Quat4f q_inv, delta;
+    Matrix3f r;
+    for (int m : medoids) {
+        const vector<int>& group = members[assign[m]];
+        GaussianSplat g = splats[m];
+        g.id = int(clustered.size());
+        const int num_steps = 1 + (int)g.horizon_qposes.size();
+
+        for (int s = 0; s < num_steps; ++s) {
+            // 区間の変化（ルート：区間の始めのルートの座標系での移動・ワールドの回転、関節：局所回転 from⁻¹·to）の平均
+            std::fill(rot_sum.begin(), rot_sum.end(), 0.0);
+            double move[3] = { 0.0, 0.0, 0.0 };
+            double v_sum = 0.0, s_sum = 0.0;
+            int count = 0;
+            const Quat4f identity(0.0f, 0.0f, 0.0f, 1.0f);
+            for (int i : group) {
+                const GaussianSplat& S = splats[i];
+                if ((int)S.horizon_qposes.size() < s) continue;
+                const QPosture& from = pose_at(S, s);
+                const QPosture& to = pose_at(S, s + 1);
+                q_inv.inverse(from.root_ori);  // Quat4::mulInverse(q1, q2) は自身のノルムで割るため使わない
+                r.set(q_inv);
+                Vector3f step(to.root_pos.x - from.root_pos.x, to.root_pos.y - from.root_pos.y, to.root_pos.z - from.root_pos.z);
+                r.transform(&step);
+                move[0] += step.x;
+                move[1] += step.y;
+                move[2] += step.z;
+                delta.mul(to.root_ori, q_inv);
+                accumulate_rotation(delta, identity, &rot_sum[0]);
+                for (int j = 0; j < body->num_joints; ++j) {
+                    q_inv.inverse(from.joint_rotations[j]);
+                    delta.mul(q_inv, to.joint_rotations[j]);
+                    accumulate_rotation(delta, identity, &rot_sum[size_t(4) * (j + 1)]);
+                }
+                if (s == 0) {
+                    v_sum += S.v_norm_ref;
+                    s_sum += S.stopability;
+                    g.v_norm_min = std::min(g.v_norm_min, S.v_norm_min);
+                    g.v_norm_max = std::max(g.v_norm_max, S.v_norm_max);
+                } else {
+                    v_sum += S.horizon_v_norm[s - 1];
+                    s_sum += S.horizon_stopability[s - 1];
+                }
+                ++count;
+            }
+            const double inv = 1.0 / double(count);
+            const QPosture& from = pose_at(g, s);
+            QPosture& to = pose_at(g, s + 1);
+            Vector3f step(float(move[0] * inv), float(move[1] * inv), float(move[2] * inv));
+            r.set(from.root_ori);
+            r.transform(&step);
+            to.root_pos.set(from.root_pos.x + step.x, from.root_pos.y + step.y, from.root_pos.z + step.z);
+            delta = average_rotation(&rot_sum[0]);
+            to.root_ori.mul(delta, from.root_ori);
+            for (int j = 0; j < body->num_joints; ++j) {
+                delta = average_rotation(&rot_sum[size_t(4) * (j + 1)]);
+                to.joint_rotations[j].mul(from.joint_rotations[j], delta);
+            }
+            if (s == 0) {
+                g.v_norm_ref = std::max(0.001f, float(v_sum * inv));
+                g.stopability = float(s_sum * inv);
+            } else {
+                g.horizon_v_norm[s - 1] = std::max(0.001f, float(v_sum * inv));
+                g.horizon_stopability[s - 1] = float(s_sum * inv);
+            }
+        }
+        if (opt_.keep_matrix_poses) g.next_qpose.GetPosture(g.next_pose);
+        clustered.push_back(std::move(g));
+    }
+    splats.swap(clustered);
+}
+
 GSModel GSModelBuilder::Build() const {
     GSModel model(human_);
     vector<GaussianSplat> buf;
     for (auto m : motions_) {
         AppendMotionSplats(*m, buf);
     }
-    MergeNearby(buf);
+
+    // ストリーミングで追加したスプラット（AddMotion の後ろに並べる）
+    buf.reserve(buf.size() + stream_splats_.size());
+    for (const auto& s : stream_splats_) {
+        buf.push_back(s);
+        buf.back().id = int(buf.size()) - 1;
+    }
+    if (opt_.target_splats > 0) {
+        ClusterSplats(buf);
+    } else {
+        MergeNearby(buf);
+    }
     model.splats_ = std::move(buf);
+    model.BuildTransitionGraph(opt_);
+    model.BuildSplatHierarchy(opt_);
 
 #if GSM_ENABLE_DUMP
     if (opt_.dump.enabled) {
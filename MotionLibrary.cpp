@@ -0,0 +1,239 @@
+﻿/**
+***  キャラクタアニメーションのための人体モデルの表現・基本処理 ライブラリ・サンプルプログラム
+***  Copyright (c) 2015-, Masaki OSHITA (www.oshita-lab.org)
+***  Released under the MIT license http://opensource.org/licenses/mit-license.php
+**/
+
+/**
+***  動作データライブラリ（複数のBVHファイルの並列読み込み）
+**/
+
+
+// ライブラリ・クラス定義の読み込み
+#include "MotionLibrary.h"
+#include "BVH.h"
+
+#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <filesystem>
+#include <ctype.h>
+
+using namespace  std;
+
+
+//
+//  BVHファイルの読み込みと動作データの生成（各スレッドで並列に実行）
+//  （階層構造が基準のBVHと異なる場合は失敗）
+//
+static Motion *  LoadLibraryMotion( const string & file_name, const BVH & reference, const Skeleton * body, int parse_threads, string & reason )
+{
+	BVH  bvh;
+
+	// BVHファイルの読み込み
+	if ( !LoadBVHFile( file_name.c_str(), bvh, parse_threads ) )
+	{
+		reason = "cannot load BVH";
+		return  NULL;
+	}
+
+	// 階層構造の確認
+	if ( !bvh.HasSameHierarchy( reference ) )
+	{
+		reason = "hierarchy mismatch";
+		return  NULL;
+	}
+	if ( bvh.GetNumFrame() == 0 )
+	{
+		reason = "no frames";
+		return  NULL;
+	}
+
+	// 共有の骨格モデルで動作データを生成
+	Motion *  motion = CoustructBVHMotion( &bvh, body );
+	if ( !motion )
+		reason = "cannot construct motion";
+	return  motion;
+}
+
+
+//
+//  複数のBVHファイルを並列に読み込み
+//
+bool  LoadMotionLibrary( const vector< string > & bvh_file_names, MotionLibrary & library, int num_threads )
+{
+	int  num_files = bvh_file_names.size();
+	BVH  reference;
+	int  first = 0;
+
+	library.body = NULL;
+	library.motions.clear();
+	library.file_names.clear();
+	library.file_indices.clear();
+	library.errors.clear();
+
+	// 基準の階層構造・共有の骨格モデルを、最初に読み込めたファイルから生成
+	vector< string >  reasons( num_files );
+	for ( ; first < num_files; first++ )
+	{
+		if ( LoadBVHFile( bvh_file_names[ first ].c_str(), reference ) && ( reference.GetNumFrame() > 0 ) )
+			break;
+		reasons[ first ] = "cannot load BVH";
+	}
+	if ( first < num_files )
+		library.body = CoustructBVHSkeleton( &reference );
+	if ( !library.body )
+	{
+		for ( int i = 0; i < num_files; i++ )
+		{
+			MotionLibraryError  error;
+			error.file_name = bvh_file_names[ i ];
+			error.reason = reasons[ i ].empty() ? "cannot construct skeleton" : reasons[ i ];
+			library.errors.push_back( error );
+		}
+		return  false;
+	}
+
+	// 基準のファイルの動作データを生成
+	vector< Motion * >  results( num_files, (Motion *) NULL );
+	results[ first ] = CoustructBVHMotion( &reference, library.body );
+	if ( !results[ first ] )
+		reasons[ first ] = "cannot construct motion";
+
+	// スレッド数の決定（ファイルの読み込み自体は各スレッドで１スレッドずつ行う）
+	if ( num_threads <= 0 )
+		num_threads = max( 1, (int) thread::hardware_concurrency() );
+	num_threads = min( num_threads, max( 1, num_files - first - 1 ) );
+	int  parse_threads = ( num_threads > 1 ) ? 1 : 0;
+
+	// スレッドプール（各スレッドが未処理のファイルを順番に取り出して読み込む）
+	atomic< int >  next_file( first + 1 );
+	auto  worker = [&]()
+	{
+		int  i;
+		while ( ( i = next_file.fetch_add( 1 ) ) < num_files )
+			results[ i ] = LoadLibraryMotion( bvh_file_names[ i ], reference, library.body, parse_threads, reasons[ i ] );
+	};
+	vector< thread >  workers;
+	for ( int t = 1; t < num_threads; t++ )
+		workers.push_back( thread( worker ) );
+	worker();
+	for ( int t = 0; t < workers.size(); t++ )
+		workers[ t ].join();
+
+	// 入力ファイルの順番に結果を登録
+	for ( int i = 0; i < num_files; i++ )
+	{
+		if ( results[ i ] )
+		{
+			library.motions.push_back( results[ i ] );
+			library.file_names.push_back( bvh_file_names[ i ] );
+			library.file_indices.push_back( i );
+		}
+		else
+		{
+			MotionLibraryError  error;
+			error.file_name = bvh_file_names[ i ];
+			error.reason = reasons[ i ];
+			library.errors.push_back( error );
+		}
+	}
+
+	return  library.motions.size() > 0;
+}
+
+
+//
+//  ディレクトリ内の全てのBVHファイルを読み込み
+//
+bool  LoadMotionLibraryDirectory( const char * directory, MotionLibrary & library, int num_threads )
+{
+	vector< string >  bvh_file_names;
+	if ( !ListBVHFiles( directory, bvh_file_names ) )
+	{
+		library = MotionLibrary();
+		return  false;
+	}
+	return  LoadMotionLibrary( bvh_file_names, library, num_threads );
+}
+
+
+//
+//  マニフェストファイルに列挙されたBVHファイルを読み込み
+//
+bool  LoadMotionLibraryManifest( const char * manifest_file_name, MotionLibrary & library, int num_threads )
+{
+	vector< string >  bvh_file_names;
+	if ( !ReadMotionManifest( manifest_file_name, bvh_file_names ) )
+	{
+		library = MotionLibrary();
+		return  false;
+	}
+	return  LoadMotionLibrary( bvh_file_names, library, num_threads );
+}
+
+
+//
+//  ディレクトリ内のBVHファイルの一覧を取得
+//
+bool  ListBVHFiles( const char * directory, vector< string > & bvh_file_names )
+{
+	error_code  ec;
+	filesystem::directory_iterator  it( directory, ec ), end;
+	if ( ec )
+		return  false;
+
+	bvh_file_names.clear();
+	for ( ; it != end; it.increment( ec ) )
+	{
+		if ( ec )
+			return  false;
+		if ( !it->is_regular_file( ec ) )
+			continue;
+
+		// 拡張子の判定（大文字・小文字は区別しない）
+		string  ext = it->path().extension().string();
+		for ( int i = 0; i < ext.size(); i++ )
+			ext[ i ] = tolower( ext[ i ] );
+		if ( ext == ".bvh" )
+			bvh_file_names.push_back( it->path().string() );
+	}
+	sort( bvh_file_names.begin(), bvh_file_names.end() );
+	return  true;
+}
+
+
+//
+//  マニフェストファイルからファイルの一覧を取得
+//
+bool  ReadMotionManifest( const char * manifest_file_name, vector< string > & bvh_file_names )
+{
+	ifstream  file( manifest_file_name );
+	if ( !file.is_open() )
+		return  false;
+
+	filesystem::path  base = filesystem::path( manifest_file_name ).parent_path();
+	string  line;
+
+	bvh_file_names.clear();
+	while ( getline( file, line ) )
+	{
+		// コメント・前後の空白を除去
+		size_t  comment = line.find( '#' );
+		if ( comment != string::npos )
+			line.erase( comment );
+		size_t  first = line.find_first_not_of( " \t\r" );
+		if ( first == string::npos )
+			continue;
+		size_t  last = line.find_last_not_of( " \t\r" );
+		line = line.substr( first, last - first + 1 );
+
+		// 相対パスはマニフェストの場所から
+		filesystem::path  path( line );
+		if ( path.is_relative() && !base.empty() )
+			path = base / path;
+		bvh_file_names.push_back( path.string() );
+	}
+	return  true;
+}
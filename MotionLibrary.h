@@ -0,0 +1,77 @@
+﻿/**
+***  キャラクタアニメーションのための人体モデルの表現・基本処理 ライブラリ・サンプルプログラム
+***  Copyright (c) 2015-, Masaki OSHITA (www.oshita-lab.org)
+***  Released under the MIT license http://opensource.org/licenses/mit-license.php
+**/
+
+/**
+***  動作データライブラリ（複数のBVHファイルの並列読み込み）
+**/
+
+#ifndef  _MOTION_LIBRARY_H_
+#define  _MOTION_LIBRARY_H_
+
+
+// ライブラリ・クラス定義の読み込み
+#include "SimpleHuman.h"
+
+
+//
+//  読み込みに失敗したファイルの情報
+//
+struct  MotionLibraryError
+{
+	// ファイル名
+	std::string  file_name;
+
+	// 失敗の理由
+	std::string  reason;
+};
+
+
+//
+//  動作データライブラリ（全ての動作データで１つの骨格モデルを共有）
+//  （骨格モデル・動作データは LoadAndCoustructBVHMotion と同様に呼び出し側で削除する）
+//
+struct  MotionLibrary
+{
+	// 全ての動作データで共有する骨格モデル（最初に読み込めたファイルから生成）
+	const Skeleton *  body;
+
+	// 読み込んだ動作データ [動作番号]（入力ファイルの順番）
+	std::vector< Motion * >  motions;
+
+	// 各動作データのファイル名・入力ファイルの中での番号 [動作番号]
+	std::vector< std::string >  file_names;
+	std::vector< int >  file_indices;
+
+	// 読み込みに失敗したファイル（入力ファイルの順番）
+	std::vector< MotionLibraryError >  errors;
+
+
+	// コンストラクタ
+	MotionLibrary() { body = NULL; }
+
+	// 学習用の動作データの配列を取得（GSModel::Fit にそのまま渡せる）
+	std::vector< const Motion * >  GetMotions() const { return  std::vector< const Motion * >( motions.begin(), motions.end() ); }
+};
+
+
+// 複数のBVHファイルを並列に読み込み（num_threads が 0 の場合はハードウェアのスレッド数）
+// 階層構造が最初のファイルと異なるファイルは読み込まずに errors に追加、１つも読み込めなければ false
+bool  LoadMotionLibrary( const std::vector< std::string > & bvh_file_names, MotionLibrary & library, int num_threads = 0 );
+
+// ディレクトリ内の全てのBVHファイル（*.bvh）をファイル名順に読み込み
+bool  LoadMotionLibraryDirectory( const char * directory, MotionLibrary & library, int num_threads = 0 );
+
+// マニフェストファイル（１行に１ファイル、空行と # 以降は無視、相対パスはマニフェストの場所から）に列挙されたBVHファイルを読み込み
+bool  LoadMotionLibraryManifest( const char * manifest_file_name, MotionLibrary & library, int num_threads = 0 );
+
+// ディレクトリ内のBVHファイルの一覧を取得（ファイル名順）
+bool  ListBVHFiles( const char * directory, std::vector< std::string > & bvh_file_names );
+
+// マニフェストファイルからファイルの一覧を取得
+bool  ReadMotionManifest( const char * manifest_file_name, std::vector< std::string > & bvh_file_names );
+
+
+#endif // _MOTION_LIBRARY_H_
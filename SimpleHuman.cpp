@@ -28,6 +28,9 @@ using namespace  std;
 // BVHファイルの位置情報に適用するスケーリング比率（デフォルトでは cm→m への変換）
 static float  bvh_scale = 0.01f;
 
+// BVHファイルの読み込み時にバイナリキャッシュ（.bvhc）を使用するかどうかの設定
+static bool  bvh_cache_enabled = true;
+
 
 
 //
@@ -166,6 +169,123 @@ Posture::~Posture()
 }
 
 
+//
+//  人体モデルの姿勢を表すクラス（四元数表現）
+//
+
+QPosture::QPosture()
+{
+	body = NULL;
+	root_pos.set( 0.0f, 0.0f, 0.0f );
+	root_ori.set( 0.0f, 0.0f, 0.0f, 1.0f );
+	joint_rotations = NULL;
+}
+
+QPosture::QPosture( const Skeleton * b )
+{
+	body = NULL;
+	joint_rotations = NULL;
+	Init( b );
+}
+
+QPosture::QPosture( const QPosture & p )
+{
+	body = p.body;
+	root_pos = p.root_pos;
+	root_ori = p.root_ori;
+
+	if ( !body )
+	{
+		joint_rotations = NULL;
+		return;
+	}
+
+	joint_rotations = new Quat4f[ body->num_joints ];
+	for ( int i = 0; i < body->num_joints; i++ )
+		joint_rotations[ i ] = p.joint_rotations[ i ];
+}
+
+QPosture::QPosture( const Posture & p )
+{
+	body = NULL;
+	joint_rotations = NULL;
+	root_pos.set( 0.0f, 0.0f, 0.0f );
+	root_ori.set( 0.0f, 0.0f, 0.0f, 1.0f );
+	SetPosture( p );
+}
+
+QPosture & QPosture::operator=( const QPosture & p )
+{
+	if ( !p.body || !p.joint_rotations )
+		return  *this;
+
+	if ( body != p.body )
+	{
+		body = p.body;
+		if ( joint_rotations )
+			delete[]  joint_rotations;
+		joint_rotations = new Quat4f[ body->num_joints ];
+	}
+
+	root_pos = p.root_pos;
+	root_ori = p.root_ori;
+	for ( int i = 0; i < body->num_joints; i++ )
+		joint_rotations[ i ] = p.joint_rotations[ i ];
+
+	return  *this;
+}
+
+void  QPosture::Init( const Skeleton * b )
+{
+	body = b;
+	root_pos.set( 0.0f, 0.0f, 0.0f );
+	root_ori.set( 0.0f, 0.0f, 0.0f, 1.0f );
+
+	if ( joint_rotations )
+		delete[]  joint_rotations;
+
+	joint_rotations = new Quat4f[ body->num_joints ];
+	for ( int i = 0; i < body->num_joints; i++ )
+		joint_rotations[ i ].set( 0.0f, 0.0f, 0.0f, 1.0f );
+}
+
+QPosture::~QPosture()
+{
+	if ( joint_rotations )
+		delete[]  joint_rotations;
+}
+
+// 回転行列表現の姿勢から設定
+void  QPosture::SetPosture( const Posture & p )
+{
+	if ( !p.body || !p.joint_rotations )
+		return;
+
+	if ( body != p.body )
+		Init( p.body );
+
+	root_pos = p.root_pos;
+	root_ori.set( p.root_ori );
+	for ( int i = 0; i < body->num_joints; i++ )
+		joint_rotations[ i ].set( p.joint_rotations[ i ] );
+}
+
+// 回転行列表現の姿勢に変換
+void  QPosture::GetPosture( Posture & p ) const
+{
+	if ( !body )
+		return;
+
+	if ( p.body != body )
+		p.Init( body );
+
+	p.root_pos = root_pos;
+	p.root_ori.set( root_ori );
+	for ( int i = 0; i < body->num_joints; i++ )
+		p.joint_rotations[ i ].set( joint_rotations[ i ] );
+}
+
+
 //
 //  人体モデルの動作を表すクラス
 //
@@ -574,9 +694,10 @@ Motion *  CoustructBVHMotion( class BVH * bvh, const Skeleton * bvh_body )
 	motion->interval = bvh->GetInterval();
 	motion->name = bvh->GetMotionName();
 
-	// 各フレームの姿勢をBVH動作から取得
-	for ( int i = 0; i < num_frames; i++ )
-		GetBVHPosture( bvh, i, motion->frames[ i ] );
+	// 各フレームの姿勢をBVH動作からまとめて取得（変換の準備は最初に一度だけ行う）
+	BVHPosturePlan  plan;
+	if ( InitBVHPosturePlan( bvh, body, plan ) )
+		GetBVHPostures( bvh, plan, 0, num_frames, motion->frames );
 
 	// 生成した動作データを返す
 	return  motion;
@@ -588,11 +709,10 @@ Motion *  CoustructBVHMotion( class BVH * bvh, const Skeleton * bvh_body )
 //
 Motion *  LoadAndCoustructBVHMotion( const char * bvh_file_name, const Skeleton * bvh_body )
 {
-	// BVH動作データを読み込み
-	BVH  bvh( bvh_file_name );
+	BVH  bvh;
 
-	// 読み込みに失敗したら終了
-	if ( !bvh.IsLoadSuccess() )
+	// BVH動作データを読み込み（読み込みに失敗したら終了）
+	if ( !LoadBVHFile( bvh_file_name, bvh ) )
 		return  NULL;
 
 	// BVH動作から骨格モデルと動作データを生成
@@ -603,6 +723,35 @@ Motion *  LoadAndCoustructBVHMotion( const char * bvh_file_name, const Skeleton
 }
 
 
+//
+//  BVHファイルの読み込み（バイナリキャッシュが有効なら、有効なキャッシュを読み込むか、無ければ作成）
+//
+bool  LoadBVHFile( const char * bvh_file_name, BVH & bvh, int num_threads )
+{
+	string  cache_file_name = BVH::GetCacheFileName( bvh_file_name );
+
+	// 有効なバイナリキャッシュがあれば読み込み
+	if ( bvh_cache_enabled && bvh.LoadCache( cache_file_name.c_str(), bvh_file_name ) )
+		return  true;
+
+	// BVH動作データを読み込み
+	bvh.Load( bvh_file_name, num_threads );
+	if ( !bvh.IsLoadSuccess() )
+		return  false;
+
+	// バイナリキャッシュを作成（書き出せなくても続行）
+	// モーションデータはキャッシュと同じ float の精度に揃えて、キャッシュの有無で結果が変わらないようにする
+	if ( bvh_cache_enabled )
+	{
+		bvh.SaveCache( cache_file_name.c_str(), bvh_file_name );
+		for ( int f = 0; f < bvh.GetNumFrame(); f++ )
+			for ( int c = 0; c < bvh.GetNumChannel(); c++ )
+				bvh.SetMotion( f, c, (float) bvh.GetMotion( f, c ) );
+	}
+	return  true;
+}
+
+
 //
 //  BVH動作の関節回転を計算（オイラー角表現から回転行列表現に変換）
 //
@@ -638,72 +787,418 @@ void  GetBVHPosture( const BVH * bvh, int frame_no, Posture & posture )
 {
 	if ( !bvh || !bvh->IsLoadSuccess() || !posture.body )
 		return;
-	if ( bvh->GetNumJoint() < posture.body->num_joints )
+
+	// 変換の準備（スレッドごとの領域を使い回してメモリを確保しない、同じBVH動作を繰り返し変換する場合は準備情報を渡す方が効率的）
+	static thread_local BVHPosturePlan  plan;
+	if ( !InitBVHPosturePlan( bvh, posture.body, plan ) )
 		return;
+	GetBVHPostures( bvh, plan, frame_no, 1, &posture );
+}
 
-	const Skeleton *  body = posture.body;
-	Vector3f  root_pos;
+void  GetBVHPosture( const BVH * bvh, const BVHPosturePlan & plan, int frame_no, Posture & posture )
+{
+	if ( !bvh || !bvh->IsLoadSuccess() || ( posture.body && ( posture.body->num_joints != plan.num_joints ) ) )
+		return;
+	GetBVHPostures( bvh, plan, frame_no, 1, &posture );
+}
+
+
+//
+//  BVH動作から姿勢への変換の準備
+//
+bool  InitBVHPosturePlan( const BVH * bvh, const Skeleton * body, BVHPosturePlan & plan )
+{
+	if ( !bvh || !bvh->IsLoadSuccess() || !body )
+		return  false;
+	if ( bvh->GetNumJoint() < body->num_joints + 1 )
+		return  false;
+
+	plan.num_joints = body->num_joints;
+	plan.root_pos_channels[ 0 ] = plan.root_pos_channels[ 1 ] = plan.root_pos_channels[ 2 ] = -1;
+	plan.rotation_first_axis.clear();
+	plan.axis_channels.clear();
+	plan.axis_codes.clear();
+	plan.num_channels = bvh->GetNumChannel();
+	plan.default_values.assign( plan.num_channels, 0.0 );
+
+	// 各回転（ルートの向き・各関節の回転）の軸を順番に登録
+	// ルートは回転チャンネルが３つある場合のみ、各関節は全ての回転チャンネルを使用（位置チャンネルは無視）
+	for ( int i = 0; i <= body->num_joints; i++ )
+	{
+		const BVH::Joint *  bvh_joint = bvh->GetJoint( i );
+		int  first = plan.axis_channels.size();
+		plan.rotation_first_axis.push_back( first );
+
+		for ( int j = 0; j < bvh_joint->channels.size(); j++ )
+		{
+			const BVH::Channel *  channel = bvh_joint->channels[ j ];
+			switch ( channel->type )
+			{
+			  case BVH::X_ROTATION:
+			  case BVH::Y_ROTATION:
+			  case BVH::Z_ROTATION:
+				plan.axis_channels.push_back( channel->index );
+				plan.axis_codes.push_back( channel->type - BVH::X_ROTATION );
+				break;
+			  case BVH::X_POSITION:
+			  case BVH::Y_POSITION:
+			  case BVH::Z_POSITION:
+				if ( i == 0 )
+					plan.root_pos_channels[ channel->type - BVH::X_POSITION ] = channel->index;
+				plan.default_values[ channel->index ] = bvh_joint->offset[ channel->type - BVH::X_POSITION ];
+				break;
+			}
+		}
+		if ( ( i == 0 ) && ( plan.axis_channels.size() != 3 ) )
+		{
+			plan.axis_channels.clear();
+			plan.axis_codes.clear();
+		}
+	}
+	plan.rotation_first_axis.push_back( plan.axis_channels.size() );
+	return  true;
+}
+
+
+//
+//  角度の配列の正弦・余弦をまとめて計算
+//  （π/2 単位で [-π/4, π/4] に範囲を縮小して多項式で近似、分岐を使わないのでコンパイラにより自動ベクトル化される）
+//  （範囲縮小が正確なのは |角度| <= 8192 ラジアン（π/2 の倍数が 2^13 未満）まで、それを超える角度・NaN は sinf・cosf で計算する）
+//
+void  SinCosArray( const float * angles, float * sin_values, float * cos_values, int num )
+{
+	// 範囲縮小が正確な角度の範囲（π/2 の３分割の上位２つとの積が丸め誤差なしに計算される範囲）
+	const float  max_angle = 8192.0f;
+
+	// π/2 の３分割（範囲縮小の丸め誤差を抑えるため）
+	const float  two_over_pi = 0.636619772367581f;
+	const float  pio2_1 = 1.5703125f;
+	const float  pio2_2 = 4.837512969970703125e-4f;
+	const float  pio2_3 = 7.54978995489188216e-8f;
+
+	for ( int i = 0; i < num; i++ )
+	{
+		float  x = angles[ i ];
+		// 整数への変換が未定義にならないように範囲内に制限（NaN も制限される、範囲外の結果は後で計算し直す）
+		float  y = fminf( fmaxf( x * two_over_pi, -max_angle ), max_angle );
+		int  q = (int)( y + copysignf( 0.5f, y ) );
+		float  fq = (float) q;
+		float  r = ( ( x - fq * pio2_1 ) - fq * pio2_2 ) - fq * pio2_3;
+		float  r2 = r * r;
+
+		// [-π/4, π/4] での正弦・余弦の多項式近似
+		float  s = r + r * r2 * ( -1.6666654611e-1f + r2 * ( 8.3321608736e-3f + r2 * -1.9515295891e-4f ) );
+		float  c = 1.0f - 0.5f * r2 + r2 * r2 * ( 4.166664568298827e-2f + r2 * ( -1.388731625493765e-3f + r2 * 2.443315711809948e-5f ) );
+
+		// 象限に応じて入れ替え・符号反転（分岐しないように 0 か 1 の係数を掛けて選択する）
+		float  swap = (float)( q & 1 );
+		float  sin_sign = 1.0f - (float)( q & 2 );
+		float  cos_sign = 1.0f - (float)( ( q + 1 ) & 2 );
+		sin_values[ i ] = sin_sign * ( ( 1.0f - swap ) * s + swap * c );
+		cos_values[ i ] = cos_sign * ( ( 1.0f - swap ) * c + swap * s );
+	}
+
+	// 範囲外の角度・NaN は標準の関数で計算し直す（通常の BVH の角度では起こらない）
+	for ( int i = 0; i < num; i++ )
+	{
+		if ( !( fabsf( angles[ i ] ) <= max_angle ) )
+		{
+			sin_values[ i ] = sinf( angles[ i ] );
+			cos_values[ i ] = cosf( angles[ i ] );
+		}
+	}
+}
+
+
+//
+//  BVH動作から連続する複数フレームの姿勢をまとめて取得
+//
+void  GetBVHPostures( const BVH * bvh, const BVHPosturePlan & plan, int first_frame, int num_frames, Posture * postures )
+{
+	GetBVHPostures( plan, bvh->GetFrameData( first_frame ), bvh->GetNumChannel(), num_frames, postures );
+}
+
+
+//
+//  BVHのモーションデータ（[フレーム番号][チャンネル番号] の配列）から複数フレームの姿勢をまとめて取得
+//
+void  GetBVHPostures( const BVHPosturePlan & plan, const double * frame_data, int num_channels, int num_frames, Posture * postures )
+{
+	// 一度に三角関数を計算するフレーム数
+	const int  block_frames = 64;
+
+	int  num_axes = plan.axis_channels.size();
+	int  num_rotations = plan.num_joints + 1;
 	Matrix3f  rot;
-	BVH::Channel *  root_rot_channels[ 3 ];
-	const BVH::Joint *  bvh_joint = NULL;
-	int  num_channels = 0;
-	float  angles[ 6 ];
-
-	// ルート関節の位置・向きを取得
-	const BVH::Joint *  bvh_root = bvh->GetJoint( 0 );
-	int  c = 0;
-	for ( int j = 0; j < bvh_root->channels.size(); j++ )
+
+	// 角度・正弦・余弦の作業領域（１フレームの変換など少量ならスタック上に確保）
+	const int  stack_values = 256;
+	float  stack_buffer[ 3 * stack_values ];
+	std::vector< float >  heap_buffer;
+	int  block_values = ( ( num_frames < block_frames ) ? num_frames : block_frames ) * num_axes;
+	float *  angles = stack_buffer;
+	if ( block_values > stack_values )
 	{
-		switch ( bvh_root->channels[ j ]->type )
+		heap_buffer.resize( 3 * block_values );
+		angles = &heap_buffer.front();
+	}
+	float *  sin_values = angles + block_values;
+	float *  cos_values = sin_values + block_values;
+
+	for ( int block = 0; block < num_frames; block += block_frames )
+	{
+		int  n = ( num_frames - block < block_frames ) ? ( num_frames - block ) : block_frames;
+
+		// 全軸の角度を集めて（度→ラジアン）、正弦・余弦をまとめて計算
+		for ( int f = 0; f < n; f++ )
 		{
-			case BVH::X_POSITION:
-			root_pos.x = bvh->GetMotion( frame_no, bvh_root->channels[ j ]->index );
-			break;
-			case BVH::Y_POSITION:
-			root_pos.y = bvh->GetMotion( frame_no, bvh_root->channels[ j ]->index );
-			break;
-			case BVH::Z_POSITION:
-			root_pos.z = bvh->GetMotion( frame_no, bvh_root->channels[ j ]->index );
-			break;
-			case BVH::X_ROTATION:
-			root_rot_channels[ c++ ] = bvh_root->channels[ j ];
-			break;
-			case BVH::Y_ROTATION:
-			root_rot_channels[ c++ ] = bvh_root->channels[ j ];
-			break;
-			case BVH::Z_ROTATION:
-			root_rot_channels[ c++ ] = bvh_root->channels[ j ];
-			break;
+			const double *  values = frame_data + (size_t)( block + f ) * num_channels;
+			float *  a = &angles[ f * num_axes ];
+			for ( int k = 0; k < num_axes; k++ )
+				a[ k ] = values[ plan.axis_channels[ k ] ] * M_PI / 180.0f;
+		}
+		SinCosArray( angles, sin_values, cos_values, n * num_axes );
+
+		for ( int f = 0; f < n; f++ )
+		{
+			const double *  values = frame_data + (size_t)( block + f ) * num_channels;
+			Posture &  posture = postures[ block + f ];
+			const float *  s = &sin_values[ f * num_axes ];
+			const float *  c = &cos_values[ f * num_axes ];
+
+			// ルートの位置を設定
+			Vector3f  root_pos( 0.0f, 0.0f, 0.0f );
+			if ( plan.root_pos_channels[ 0 ] >= 0 )
+				root_pos.x = values[ plan.root_pos_channels[ 0 ] ];
+			if ( plan.root_pos_channels[ 1 ] >= 0 )
+				root_pos.y = values[ plan.root_pos_channels[ 1 ] ];
+			if ( plan.root_pos_channels[ 2 ] >= 0 )
+				root_pos.z = values[ plan.root_pos_channels[ 2 ] ];
+			root_pos.scale( bvh_scale );
+			posture.root_pos = root_pos;
+
+			// ルートの向き・各関節の回転を設定
+			// （各軸の回転行列を右から掛ける代わりに、回転行列の２つの列を直接更新する）
+			for ( int i = 0; i < num_rotations; i++ )
+			{
+				rot.setIdentity();
+				for ( int k = plan.rotation_first_axis[ i ]; k < plan.rotation_first_axis[ i + 1 ]; k++ )
+				{
+					float  ck = c[ k ], sk = s[ k ], t0, t1, t2;
+					switch ( plan.axis_codes[ k ] )
+					{
+					  case 0: // X軸回転（列1, 列2）
+						t0 = rot.m01;  t1 = rot.m11;  t2 = rot.m21;
+						rot.m01 = ck * t0 + sk * rot.m02;  rot.m02 = ck * rot.m02 - sk * t0;
+						rot.m11 = ck * t1 + sk * rot.m12;  rot.m12 = ck * rot.m12 - sk * t1;
+						rot.m21 = ck * t2 + sk * rot.m22;  rot.m22 = ck * rot.m22 - sk * t2;
+						break;
+					  case 1: // Y軸回転（列0, 列2）
+						t0 = rot.m00;  t1 = rot.m10;  t2 = rot.m20;
+						rot.m00 = ck * t0 - sk * rot.m02;  rot.m02 = sk * t0 + ck * rot.m02;
+						rot.m10 = ck * t1 - sk * rot.m12;  rot.m12 = sk * t1 + ck * rot.m12;
+						rot.m20 = ck * t2 - sk * rot.m22;  rot.m22 = sk * t2 + ck * rot.m22;
+						break;
+					  case 2: // Z軸回転（列0, 列1）
+						t0 = rot.m00;  t1 = rot.m10;  t2 = rot.m20;
+						rot.m00 = ck * t0 + sk * rot.m01;  rot.m01 = ck * rot.m01 - sk * t0;
+						rot.m10 = ck * t1 + sk * rot.m11;  rot.m11 = ck * rot.m11 - sk * t1;
+						rot.m20 = ck * t2 + sk * rot.m21;  rot.m21 = ck * rot.m21 - sk * t2;
+						break;
+					}
+				}
+				if ( i == 0 )
+					posture.root_ori = rot;
+				else
+					posture.joint_rotations[ i - 1 ] = rot;
+			}
 		}
 	}
-	if ( c == 3 )
+}
+
+
+//
+//  正接の配列から角度をまとめて計算
+//  （比を [0, 1] に縮小して、さらに tan(π/8) 以上は π/4 を中心に変換して多項式で近似、分岐を使わないのでコンパイラにより自動ベクトル化される）
+//
+void  Atan2Array( const float * y_values, const float * x_values, float * angles, int num )
+{
+	const float  pi = 3.14159265358979f;
+	const float  tan_pi_8 = 0.414213562373095f;
+
+	for ( int i = 0; i < num; i++ )
 	{
-		for ( int j = 0; j < 3; j++ )
-			angles[ j ] = bvh->GetMotion( frame_no, root_rot_channels[ j ]->index ) * M_PI / 180.0f;
-		ComputeBVHJointRotation( 3, root_rot_channels, angles, rot );
+		float  y = y_values[ i ];
+		float  x = x_values[ i ];
+		float  ax = fabsf( x ), ay = fabsf( y );
+
+		// 比 a = min / max（0 ≦ a ≦ 1、x = y = 0 の場合は 0）
+		// （分岐しないように、比較の代わりに差の符号から求めた 0 か 1 の係数を掛けて選択する）
+		float  swap = 0.5f - 0.5f * copysignf( 1.0f, ax - ay );
+		float  mn = ( 1.0f - swap ) * ay + swap * ax;
+		float  mx = ( 1.0f - swap ) * ax + swap * ay;
+		float  a = mn / ( mx + 1.0e-30f );
+
+		// tan(π/8) 以上の場合は atan(a) = π/4 + atan((a-1)/(a+1)) を使う
+		float  upper = 0.5f + 0.5f * copysignf( 1.0f, a - tan_pi_8 );
+		float  t = ( 1.0f - upper ) * a + upper * ( a - 1.0f ) / ( a + 1.0f );
+		float  z = t * t;
+		float  r = ( ( ( ( 8.05374449538e-2f * z - 1.38776856032e-1f ) * z + 1.99777106478e-1f ) * z - 3.33329491539e-1f ) * z * t + t ) + upper * ( pi * 0.25f );
+
+		// 象限に応じて変換
+		r = ( 1.0f - swap ) * r + swap * ( pi * 0.5f - r );
+		float  neg_x = 0.5f - 0.5f * copysignf( 1.0f, x );
+		r = ( 1.0f - neg_x ) * r + neg_x * ( pi - r );
+		angles[ i ] = copysignf( r, y );
 	}
-	else
-		rot.setIdentity();
+}
 
-	// ルート関節の位置・向きを設定
-	root_pos.scale( bvh_scale );
-	posture.root_pos = root_pos;
-	posture.root_ori = rot;
 
-	// 各関節の回転を取得
-	for ( int i = 0; i < body->num_joints; i++ )
+//
+//  姿勢からBVHのモーションデータ（１フレーム分）を取得
+//
+void  GetBVHFrameData( const BVHPosturePlan & plan, const Posture & posture, double * frame_data )
+{
+	GetBVHFrameDatas( plan, &posture, 1, frame_data );
+}
+
+
+//
+//  複数の姿勢からBVHのモーションデータをまとめて取得
+//
+void  GetBVHFrameDatas( const BVHPosturePlan & plan, const Posture * postures, int num_frames, double * frame_data )
+{
+	// 一度に逆正接を計算するフレーム数
+	const int  block_frames = 64;
+
+	// 各回転（rot = R_i(a) R_j(b) R_k(c)）の軸 i, j, k と、各チャンネルに出力する角度（0: a, 1: b, 2: c, -1: 出力しない）を決定
+	// 軸が３つ未満の場合は使われていない軸を補って分解し、同じ軸が重複する場合は最初のチャンネルに全ての回転を割り当てる
+	int  num_rotations = plan.num_joints + 1;
+	int  num_axes = plan.axis_channels.size();
+	std::vector< int >  rotation_axes( num_rotations * 3 );
+	std::vector< int >  axis_angles( num_axes, -1 );
+	for ( int r = 0; r < num_rotations; r++ )
 	{
-		bvh_joint = bvh->GetJoint( i + 1 );
-		num_channels = bvh_joint->channels.size();
+		int *  axes = &rotation_axes[ r * 3 ];
+		int  n = 0;
+		for ( int k = plan.rotation_first_axis[ r ]; ( k < plan.rotation_first_axis[ r + 1 ] ) && ( n < 3 ); k++ )
+		{
+			int  axis = plan.axis_codes[ k ];
+			if ( ( n == 0 ) || ( ( axis != axes[ 0 ] ) && ( ( n < 2 ) || ( axis != axes[ 1 ] ) ) ) )
+			{
+				axis_angles[ k ] = n;
+				axes[ n ++ ] = axis;
+			}
+		}
+		for ( int axis = 0; n < 3; axis++ )
+			if ( ( n == 0 ) || ( ( axis != axes[ 0 ] ) && ( ( n < 2 ) || ( axis != axes[ 1 ] ) ) ) )
+				axes[ n ++ ] = axis;
+	}
 
-		// 関節の回転を取得
-		for ( int j = 0; j < num_channels; j++ )
-			angles[ j ] = bvh->GetMotion( frame_no, bvh_joint->channels[ j ]->index ) * M_PI / 180.0f;
-		ComputeBVHJointRotation( num_channels, &bvh_joint->channels.front(), angles, rot );
+	// 各回転ごとに４つの逆正接（b, a, c, ジンバルロック時の a）を計算
+	std::vector< float >  y_values( block_frames * num_rotations * 4 ), x_values( y_values.size() ), angles( y_values.size() );
+	std::vector< unsigned char >  gimbal_lock( block_frames * num_rotations );
 
-		// 関節の回転を設定
-		posture.joint_rotations[ i ] = rot;
+	for ( int block = 0; block < num_frames; block += block_frames )
+	{
+		int  n = ( num_frames - block < block_frames ) ? ( num_frames - block ) : block_frames;
+
+		// 全ての回転行列から逆正接の引数を集める
+		for ( int f = 0; f < n; f++ )
+		{
+			const Posture &  posture = postures[ block + f ];
+			for ( int r = 0; r < num_rotations; r++ )
+			{
+				const Matrix3f &  rot = ( r == 0 ) ? posture.root_ori : posture.joint_rotations[ r - 1 ];
+				const float  m[ 3 ][ 3 ] = { { rot.m00, rot.m01, rot.m02 }, { rot.m10, rot.m11, rot.m12 }, { rot.m20, rot.m21, rot.m22 } };
+				int  i = rotation_axes[ r * 3 ], j = rotation_axes[ r * 3 + 1 ], k = rotation_axes[ r * 3 + 2 ];
+
+				// 軸の順番が巡回順（XYZ, YZX, ZXY）かどうかで符号が変わる
+				float  s = ( ( j - i + 3 ) % 3 == 1 ) ? 1.0f : -1.0f;
+				float  cb = sqrtf( m[ i ][ i ] * m[ i ][ i ] + m[ i ][ j ] * m[ i ][ j ] );
+
+				int  no = ( f * num_rotations + r ) * 4;
+				y_values[ no ] = s * m[ i ][ k ];       x_values[ no ] = cb;
+				y_values[ no + 1 ] = -s * m[ j ][ k ];  x_values[ no + 1 ] = m[ k ][ k ];
+				y_values[ no + 2 ] = -s * m[ i ][ j ];  x_values[ no + 2 ] = m[ i ][ i ];
+				y_values[ no + 3 ] = s * m[ k ][ j ];   x_values[ no + 3 ] = m[ j ][ j ];
+				gimbal_lock[ f * num_rotations + r ] = ( cb <= 1.0e-6f );
+			}
+		}
+		Atan2Array( &y_values.front(), &x_values.front(), &angles.front(), n * num_rotations * 4 );
+
+		for ( int f = 0; f < n; f++ )
+		{
+			const Posture &  posture = postures[ block + f ];
+			double *  values = frame_data + (size_t)( block + f ) * plan.num_channels;
+
+			// 姿勢から決まらないチャンネルの値を設定
+			for ( int c = 0; c < plan.num_channels; c++ )
+				values[ c ] = plan.default_values[ c ];
+
+			// ルートの位置を設定
+			if ( plan.root_pos_channels[ 0 ] >= 0 )
+				values[ plan.root_pos_channels[ 0 ] ] = posture.root_pos.x / bvh_scale;
+			if ( plan.root_pos_channels[ 1 ] >= 0 )
+				values[ plan.root_pos_channels[ 1 ] ] = posture.root_pos.y / bvh_scale;
+			if ( plan.root_pos_channels[ 2 ] >= 0 )
+				values[ plan.root_pos_channels[ 2 ] ] = posture.root_pos.z / bvh_scale;
+
+			// ルートの向き・各関節の回転の角度（ラジアン→度）を設定
+			// （ジンバルロック（２番目の回転が ±90度）の場合は３番目の回転を 0 とする）
+			for ( int r = 0; r < num_rotations; r++ )
+			{
+				const float *  a = &angles[ ( f * num_rotations + r ) * 4 ];
+				bool  lock = gimbal_lock[ f * num_rotations + r ];
+				double  euler[ 3 ] = { lock ? a[ 3 ] : a[ 1 ], a[ 0 ], lock ? 0.0f : a[ 2 ] };
+				for ( int k = plan.rotation_first_axis[ r ]; k < plan.rotation_first_axis[ r + 1 ]; k++ )
+					if ( axis_angles[ k ] >= 0 )
+						values[ plan.axis_channels[ k ] ] = euler[ axis_angles[ k ] ] * 180.0 / M_PI;
+			}
+		}
+	}
+}
+
+
+//
+//  キーフレーム動作を指定フレームレートでサンプリングして、BVHファイルに１フレームずつ出力
+//
+bool  SaveBVHKeyframeMotion( const char * bvh_file_name, BVH * layout, const KeyframeMotion & motion, float fps )
+{
+	// 一度に姿勢を変換するフレーム数
+	const int  block_frames = 64;
+
+	if ( ( motion.num_keyframes < 1 ) || !motion.body || ( fps <= 0.0f ) )
+		return  false;
+
+	BVHPosturePlan  plan;
+	if ( !InitBVHPosturePlan( layout, motion.body, plan ) )
+		return  false;
+
+	// 出力フレーム数（動作の長さに収まる最後のフレームまで）
+	int  num_frames = (int) floor( motion.GetDuration() * fps + 1.0e-4f ) + 1;
+	if ( !layout->BeginSave( bvh_file_name, num_frames, 1.0 / fps ) )
+		return  false;
+
+	// 一定フレームごとに姿勢を取得してまとめて変換・出力
+	std::vector< Posture >  postures( block_frames, Posture( motion.body ) );
+	std::vector< double >  frame_data( block_frames * plan.num_channels );
+	for ( int block = 0; block < num_frames; block += block_frames )
+	{
+		int  n = ( num_frames - block < block_frames ) ? ( num_frames - block ) : block_frames;
+		for ( int f = 0; f < n; f++ )
+			motion.GetPosture( motion.key_times[ 0 ] + ( block + f ) / fps, postures[ f ] );
+		GetBVHFrameDatas( plan, &postures.front(), n, &frame_data.front() );
+		for ( int f = 0; f < n; f++ )
+		{
+			if ( !layout->SaveFrame( &frame_data[ f * plan.num_channels ] ) )
+			{
+				layout->EndSave();
+				return  false;
+			}
+		}
 	}
+	return  layout->EndSave();
 }
 
 
@@ -725,6 +1220,24 @@ void  SetBVHScale( float scale )
 }
 
 
+//
+//  BVHファイルの読み込み時のバイナリキャッシュ（.bvhc）の使用の有無を取得
+//
+bool  GetBVHCacheEnabled()
+{
+	return  bvh_cache_enabled;
+}
+
+
+//
+//  BVHファイルの読み込み時のバイナリキャッシュ（.bvhc）の使用の有無を設定
+//
+void  SetBVHCacheEnabled( bool enabled )
+{
+	bvh_cache_enabled = enabled;
+}
+
+
 //
 //  骨格モデルから体節を名前で探索
 //
@@ -759,9 +1272,11 @@ int  FindJoint( const Skeleton * body, const char * joint_name )
 
 //
 //  順運動学計算のための反復計算（ルート体節から末端体節に向かって繰り返し再帰呼び出し）
+//  （関節回転が回転行列表現の Posture と四元数表現の QPosture の両方に対応）
 //
+template< class POSTURE >
 void  ForwardKinematicsIteration( 
-	const Segment *  segment, const Segment * prev_segment, const Posture & posture, 
+	const Segment *  segment, const Segment * prev_segment, const POSTURE & posture, 
 	Matrix4f * seg_frame_array, Point3f * joi_pos_array = NULL )
 {
 	// 骨格情報
@@ -859,10 +1374,44 @@ void  ForwardKinematics( const Posture & posture, vector< Matrix4f > & seg_frame
 }
 
 
+//
+//  順運動学計算（四元数表現の姿勢）
+//
+void  ForwardKinematics( const QPosture & posture, vector< Matrix4f > & seg_frame_array, vector< Point3f > & joi_pos_array )
+{
+	// 配列初期化
+	seg_frame_array.resize( posture.body->num_segments );
+	joi_pos_array.resize( posture.body->num_joints );
+
+	// ルート体節の位置・向きを設定
+	seg_frame_array[ 0 ].set( posture.root_ori, Vector3f( posture.root_pos ), 1.0f );
+
+	// Forward Kinematics 計算のための反復計算（ルート体節から末端体節に向かって繰り返し計算）
+	ForwardKinematicsIteration( posture.body->segments[ 0 ], NULL, posture, &seg_frame_array.front(), &joi_pos_array.front() );
+}
+
+void  ForwardKinematics( const QPosture & posture, vector< Matrix4f > & seg_frame_array )
+{
+	// 配列初期化
+	seg_frame_array.resize( posture.body->num_segments );
+
+	// ルート体節の位置・向きを設定
+	seg_frame_array[ 0 ].set( posture.root_ori, Vector3f( posture.root_pos ), 1.0f );
+
+	// Forward Kinematics 計算のための反復計算（ルート体節から末端体節に向かって繰り返し計算）
+	ForwardKinematicsIteration( posture.body->segments[ 0 ], NULL, posture, &seg_frame_array.front() );
+}
+
+
 //
 //  姿勢補間（２つの姿勢を補間）
 //
 void  PostureInterpolation( const Posture & p0, const Posture & p1, float ratio, Posture & p )
+{
+	PostureInterpolation( p0, p1, ratio, p, POSTURE_INTERP_SLERP );
+}
+
+void  PostureInterpolation( const Posture & p0, const Posture & p1, float ratio, Posture & p, PostureInterpolationMode mode )
 {
 	// ２つの姿勢の骨格モデルが異なる場合は終了
 	if ( ( p0.body != p1.body ) || ( p0.body != p.body ) )
@@ -871,28 +1420,30 @@ void  PostureInterpolation( const Posture & p0, const Posture & p1, float ratio,
 	// 骨格モデルを取得
 	const Skeleton *  body = p0.body;
 
-	// 計算用変数
-	Quat4f  q0, q1, q;
+	// 計算用変数（関節の回転は一定数ずつ四元数に変換してまとめて補間）
+	const int  block = 16;
+	Quat4f  q0[ block ], q1[ block ], q[ block ];
 	Vector3f  v0, v1, v;
 
 	// ２つの姿勢の各関節の回転を補間
-	for ( int i = 0; i < body->num_joints; i++ )
+	for ( int b = 0; b < body->num_joints; b += block )
 	{
-		q0.set( p0.joint_rotations[ i ] );
-		q1.set( p1.joint_rotations[ i ] );
-		if ( q0.x * q1.x + q0.y * q1.y + q0.z * q1.z + q0.w * q1.w < 0 )
-			q1.negate( q1 );
-		q.interpolate( q0, q1, ratio );
-		p.joint_rotations[ i ].set( q );
+		int  n = ( body->num_joints - b < block ) ? ( body->num_joints - b ) : block;
+		for ( int i = 0; i < n; i++ )
+		{
+			q0[ i ].set( p0.joint_rotations[ b + i ] );
+			q1[ i ].set( p1.joint_rotations[ b + i ] );
+		}
+		QuaternionArrayInterpolation( q0, q1, ratio, q, n, mode );
+		for ( int i = 0; i < n; i++ )
+			p.joint_rotations[ b + i ].set( q[ i ] );
 	}
 
 	// ２つの姿勢のルートの向きを補間
-	q0.set( p0.root_ori );
-	q1.set( p1.root_ori );
-	if ( q0.x * q1.x + q0.y * q1.y + q0.z * q1.z + q0.w * q1.w < 0 )
-		q1.negate( q1 );
-	q.interpolate( q0, q1, ratio );
-	p.root_ori.set( q );
+	q0[ 0 ].set( p0.root_ori );
+	q1[ 0 ].set( p1.root_ori );
+	QuaternionArrayInterpolation( q0, q1, ratio, q, 1, mode );
+	p.root_ori.set( q[ 0 ] );
 
 	// ２つの姿勢のルートの位置を補間
 	v0.set( p0.root_pos );
@@ -903,6 +1454,116 @@ void  PostureInterpolation( const Posture & p0, const Posture & p1, float ratio,
 }
 
 
+//
+//  姿勢補間（四元数表現の姿勢、行列との変換なし）
+//
+void  PostureInterpolation( const QPosture & p0, const QPosture & p1, float ratio, QPosture & p, PostureInterpolationMode mode )
+{
+	// ２つの姿勢の骨格モデルが異なる場合は終了
+	if ( ( p0.body != p1.body ) || ( p0.body != p.body ) )
+		return;
+
+	// ２つの姿勢の各関節の回転・ルートの向きを補間
+	QuaternionArrayInterpolation( p0.joint_rotations, p1.joint_rotations, ratio, p.joint_rotations, p0.body->num_joints, mode );
+	QuaternionArrayInterpolation( &p0.root_ori, &p1.root_ori, ratio, &p.root_ori, 1, mode );
+
+	// ２つの姿勢のルートの位置を補間
+	p.root_pos.set( p0.root_pos.x + ratio * ( p1.root_pos.x - p0.root_pos.x ),
+	                p0.root_pos.y + ratio * ( p1.root_pos.y - p0.root_pos.y ),
+	                p0.root_pos.z + ratio * ( p1.root_pos.z - p0.root_pos.z ) );
+}
+
+
+//
+//  四元数配列の補間（全関節の回転をまとめて補間）
+//
+void  QuaternionArrayInterpolation( const Quat4f * q0, const Quat4f * q1, float ratio, Quat4f * q, int num, 
+	PostureInterpolationMode mode )
+{
+	// 補間係数の計算と適用を一定数ずつ分けて行う
+	//（係数を適用するループは分岐を含まないため、コンパイラによるベクトル化の対象となる）
+	const int  block = 16;
+	float  w0[ block ], w1[ block ], sign[ block ];
+
+	for ( int b = 0; b < num; b += block )
+	{
+		int  n = ( num - b < block ) ? ( num - b ) : block;
+		const Quat4f *  a = q0 + b;
+		const Quat4f *  c = q1 + b;
+		Quat4f *  r = q + b;
+
+		// 各回転の内積を計算（内積が負の場合は q1 の符号を反転して最短経路で補間）
+		for ( int i = 0; i < n; i++ )
+		{
+			float  d = a[ i ].x * c[ i ].x + a[ i ].y * c[ i ].y + a[ i ].z * c[ i ].z + a[ i ].w * c[ i ].w;
+			sign[ i ] = copysignf( 1.0f, d );
+			w0[ i ] = d * sign[ i ];
+		}
+
+		// 各回転の補間係数を計算
+		if ( mode == POSTURE_INTERP_SLERP )
+		{
+			// 球面線形補間（ほぼ同じ回転の場合は線形補間で代用）
+			for ( int i = 0; i < n; i++ )
+			{
+				float  d = w0[ i ];
+				float  s0 = 1.0f - ratio;
+				float  s1 = ratio;
+				if ( d < 1.0f - 1.0e-6f )
+				{
+					float  theta = acos( d );
+					float  inv_sin = 1.0f / sin( theta );
+					s0 = sin( ( 1.0f - ratio ) * theta ) * inv_sin;
+					s1 = sin( ratio * theta ) * inv_sin;
+				}
+				w0[ i ] = s0;
+				w1[ i ] = s1 * sign[ i ];
+			}
+		}
+		else if ( mode == POSTURE_INTERP_FAST_SLERP )
+		{
+			// 多項式近似の球面線形補間（分岐を含まないため、このループもベクトル化の対象となる）
+			for ( int i = 0; i < n; i++ )
+			{
+				float  s0, s1;
+				Quat4f::interpolateFastWeights( w0[ i ], ratio, &s0, &s1 );
+				w0[ i ] = s0;
+				w1[ i ] = s1 * sign[ i ];
+			}
+		}
+		else
+		{
+			// 正規化線形補間（係数は補間の比率のまま、後で正規化）
+			for ( int i = 0; i < n; i++ )
+			{
+				w0[ i ] = 1.0f - ratio;
+				w1[ i ] = ratio * sign[ i ];
+			}
+		}
+
+		// 補間係数を適用
+		for ( int i = 0; i < n; i++ )
+		{
+			float  x = w0[ i ] * a[ i ].x + w1[ i ] * c[ i ].x;
+			float  y = w0[ i ] * a[ i ].y + w1[ i ] * c[ i ].y;
+			float  z = w0[ i ] * a[ i ].z + w1[ i ] * c[ i ].z;
+			float  w = w0[ i ] * a[ i ].w + w1[ i ] * c[ i ].w;
+			r[ i ].x = x;  r[ i ].y = y;  r[ i ].z = z;  r[ i ].w = w;
+		}
+
+		// 正規化線形補間の場合は正規化
+		if ( mode == POSTURE_INTERP_NLERP )
+		{
+			for ( int i = 0; i < n; i++ )
+			{
+				float  inv_len = 1.0f / sqrt( r[ i ].x * r[ i ].x + r[ i ].y * r[ i ].y + r[ i ].z * r[ i ].z + r[ i ].w * r[ i ].w );
+				r[ i ].x *= inv_len;  r[ i ].y *= inv_len;  r[ i ].z *= inv_len;  r[ i ].w *= inv_len;
+			}
+		}
+	}
+}
+
+
 //
 //  変換行列の水平向き（方位角）成分を計算（Ｚ軸の正の方向を０とする時計回りの角度を -180～180 の範囲で求める）
 //
@@ -37,6 +37,7 @@ struct  Segment;
 struct  Joint;
 class  Skeleton;
 class  Posture;
+class  QPosture;
 
 
 //
@@ -136,6 +137,44 @@ class  Posture
 };
 
 
+//
+//  人体モデルの姿勢を表すクラス（四元数表現）
+//  （補間やコピーの多い処理のための表現、Posture とは SetPosture / GetPosture で相互に変換）
+//
+class  QPosture
+{
+  public:
+	// 骨格モデル
+	const Skeleton *  body;
+
+	// ルートの位置
+	Point3f  root_pos;
+
+	// ルートの向き（四元数表現）
+	Quat4f  root_ori;
+
+	// 各関節の相対回転（四元数表現）[関節番号]
+	Quat4f *  joint_rotations;
+
+
+  public:
+	// コンストラクタ・デストラクタ
+	QPosture();
+	QPosture( const Skeleton * b );
+	QPosture( const QPosture & p );
+	explicit QPosture( const Posture & p );
+	QPosture &operator=( const QPosture & p );
+	~QPosture();
+
+	// 初期化
+	void  Init( const Skeleton * b );
+
+	// 回転行列表現の姿勢との変換
+	void  SetPosture( const Posture & p );
+	void  GetPosture( Posture & p ) const;
+};
+
+
 //
 //  人体モデルの動作を表すクラス
 //
@@ -236,15 +275,74 @@ Motion *  CoustructBVHMotion( class BVH * bvh, const Skeleton * bvh_body = NULL
 // BVHファイルを読み込んで動作データ（＋骨格モデル）を生成
 Motion *  LoadAndCoustructBVHMotion( const char * bvh_file_name, const Skeleton * bvh_body = NULL );
 
-// BVH動作から姿勢を取得
+// BVHファイルの読み込み（バイナリキャッシュが有効なら使用・作成、LoadAndCoustructBVHMotion と同じ読み込み処理）
+//（num_threads はモーションデータ解析のスレッド数、0 の場合は BVH::SetNumLoadThreads の設定）
+bool  LoadBVHFile( const char * bvh_file_name, class BVH & bvh, int num_threads = 0 );
+
+// BVH動作から姿勢を取得（変換の準備情報は呼び出しごとに作成、スレッドごとの領域を使い回すのでメモリは確保しない）
 void  GetBVHPosture( const class BVH * bvh, int frame_no, Posture & posture );
 
+// BVH動作から姿勢を取得（InitBVHPosturePlan で一度だけ作成した準備情報を使用、毎フレーム変換する場合はこちらを使う）
+void  GetBVHPosture( const class BVH * bvh, const struct BVHPosturePlan & plan, int frame_no, Posture & posture );
+
+// BVH動作から姿勢への変換の準備情報（BVHのチャンネル構成から一度だけ計算しておく）
+struct  BVHPosturePlan
+{
+	// 変換先の骨格モデルの関節数
+	int  num_joints;
+
+	// ルートの位置 x, y, z のチャンネル番号（チャンネルが無い場合は -1）
+	int  root_pos_channels[ 3 ];
+
+	// 各回転（[0]: ルートの向き, [1～num_joints]: 各関節の回転）の軸の範囲 [回転番号]（num_joints + 2 個）
+	std::vector< int >  rotation_first_axis;
+
+	// 各軸のチャンネル番号と軸の種類（0: X, 1: Y, 2: Z）[軸番号]（回転ごとにファイル中の順番で並ぶ）
+	std::vector< int >  axis_channels;
+	std::vector< unsigned char >  axis_codes;
+
+	// BVHのチャンネル数と、姿勢から決まらないチャンネルの値 [チャンネル番号]（回転は 0、ルート以外の位置は関節のオフセット）
+	int  num_channels;
+	std::vector< double >  default_values;
+};
+
+// BVH動作から姿勢への変換の準備（骨格モデルと対応しないBVH動作なら false）
+bool  InitBVHPosturePlan( const class BVH * bvh, const Skeleton * body, BVHPosturePlan & plan );
+
+// BVH動作から連続する複数フレームの姿勢をまとめて取得（各軸の三角関数をまとめて計算）
+void  GetBVHPostures( const class BVH * bvh, const BVHPosturePlan & plan, int first_frame, int num_frames, Posture * postures );
+
+// BVHのモーションデータ（[フレーム番号][チャンネル番号] の配列）から姿勢を取得（BVH::ReadFrame によるストリーミング読み込み用）
+void  GetBVHPostures( const BVHPosturePlan & plan, const double * frame_data, int num_channels, int num_frames, Posture * postures );
+
+// 姿勢からBVHのモーションデータ（１フレーム分の [チャンネル番号] の配列）を取得（GetBVHPostures の逆変換）
+// （回転行列を各関節のチャンネルの順番のオイラー角に分解、ルートの位置は GetBVHScale で割って元の単位に戻す）
+void  GetBVHFrameData( const BVHPosturePlan & plan, const Posture & posture, double * frame_data );
+
+// 複数の姿勢からBVHのモーションデータ（[フレーム番号][チャンネル番号] の配列）をまとめて取得（各回転の逆正接をまとめて計算）
+void  GetBVHFrameDatas( const BVHPosturePlan & plan, const Posture * postures, int num_frames, double * frame_data );
+
+// キーフレーム動作を指定フレームレートでサンプリングして、BVHファイルに１フレームずつ出力（中間のBVH動作は作成しない）
+// （階層構造・チャンネル構成は layout を使用、layout は動作の骨格モデルと対応している必要がある）
+bool  SaveBVHKeyframeMotion( const char * bvh_file_name, class BVH * layout, const KeyframeMotion & motion, float fps );
+
+// 角度の配列の正弦・余弦をまとめて計算（多項式近似、自動ベクトル化される分岐のない実装、誤差は float の数ulp 程度）
+void  SinCosArray( const float * angles, float * sin_values, float * cos_values, int num );
+
+// 正接の引数の配列から逆正接 atan2( y, x ) をまとめて計算（多項式近似、自動ベクトル化される分岐のない実装、誤差は float の数ulp 程度）
+void  Atan2Array( const float * y_values, const float * x_values, float * angles, int num );
+
 // BVH動作の読み込み時の位置のスケールを取得
 float  GetBVHScale();
 
 // BVH動作の読み込み時の位置のスケールを設定
 void  SetBVHScale( float scale );
 
+// BVHファイルの読み込み時のバイナリキャッシュ（.bvhc）の使用の有無を取得・設定
+// （有効な場合、LoadAndCoustructBVHMotion は元ファイルと同じ場所のキャッシュを読み込み、無いか古ければ作成する）
+bool  GetBVHCacheEnabled();
+void  SetBVHCacheEnabled( bool enabled );
+
 // 骨格モデルから体節を名前で探索
 int  FindSegment( const Skeleton * body, const char * segment_name );
 
@@ -257,8 +355,33 @@ void  ForwardKinematics( const Posture & posture, std::vector< Matrix4f > & seg_
 // 順運動学計算
 void  ForwardKinematics( const Posture & posture, std::vector< Matrix4f > & seg_frame_array );
 
+// 順運動学計算（四元数表現の姿勢）
+void  ForwardKinematics( const QPosture & posture, std::vector< Matrix4f > & seg_frame_array, std::vector< Point3f > & joi_pos_array );
+void  ForwardKinematics( const QPosture & posture, std::vector< Matrix4f > & seg_frame_array );
+
+// 姿勢補間の方式
+enum  PostureInterpolationMode
+{
+	POSTURE_INTERP_SLERP,  // 球面線形補間（Quat4::interpolate と同等）
+	POSTURE_INTERP_NLERP,  // 正規化線形補間（三角関数なし、近似）
+	// NLERP の回転角誤差の上限（補間する２つの回転の差の角度ごと）
+	//   30度: 0.034度, 60度: 0.27度, 90度: 0.92度, 180度: 8.2度
+	//   （ratio = 0, 0.5, 1 では誤差なし、ratio ≒ 0.21, 0.79 付近で最大）
+	POSTURE_INTERP_FAST_SLERP  // 多項式近似の球面線形補間（Quat4::interpolateFast と同等、三角関数なし）
+	// FAST_SLERP の回転角誤差の上限: 90度まで: 6.5e-6度, 180度まで: 0.001度（四元数の長さの誤差は 3e-5 以下）
+};
+
 // 姿勢補間（２つの姿勢を補間）
 void  PostureInterpolation( const Posture & p0, const Posture & p1, float ratio, Posture & p );
+void  PostureInterpolation( const Posture & p0, const Posture & p1, float ratio, Posture & p, PostureInterpolationMode mode );
+
+// 姿勢補間（四元数表現の姿勢、行列との変換なし）
+void  PostureInterpolation( const QPosture & p0, const QPosture & p1, float ratio, QPosture & p, 
+	PostureInterpolationMode mode = POSTURE_INTERP_SLERP );
+
+// 四元数配列の補間（全関節の回転をまとめて補間、q は q0 または q1 と同じ配列でも良い）
+void  QuaternionArrayInterpolation( const Quat4f * q0, const Quat4f * q1, float ratio, Quat4f * q, int num, 
+	PostureInterpolationMode mode = POSTURE_INTERP_SLERP );
 
 // 変換行列の水平向き（方位角）成分を計算（Ｚ軸の正の方向を０とする時計回りの角度を -180～180 の範囲で求める）
 float  ComputeOrientationAngle( const Matrix3f & ori );
@@ -0,0 +1,114 @@
+/**
+***  キャラクタアニメーションのための人体モデルの表現・基本処理 ライブラリ・サンプルプログラム
+***  Copyright (c) 2015-, Masaki OSHITA (www.oshita-lab.org)
+***  Released under the MIT license http://opensource.org/licenses/mit-license.php
+**/
+
+/**
+***  αの探索方式（5点グリッド / 黄金分割探索）の比較
+***
+***  使い方: bench_alpha_search [budget=4] [num_requests=100] [seed=1]
+***    サンプル動作（app_headless と同じ）で学習したモデルに対して、ランダムな開始・目標姿勢の生成を各方式で行い、
+***    1ステップあたりの候補評価数・ステップ数・最終姿勢と目標姿勢の FK 距離 [m]・生成時間 [ms] を出力する。
+***    また、グリッドの生成中の各状態から両方式で1ステップ進め、目標距離の減少量（delta_goal）を同じ状態で比較する。
+**/
+
+#include "SimpleHuman.h"
+#include "HumanBody.h"
+#include "GSModel.h"
+#include "GSModelController.h"
+#include "bench_common.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace  std;
+
+
+typedef chrono::steady_clock  clock_type;
+
+
+int  main( int argc, char ** argv )
+{
+    int  budget = ( argc > 1 ) ? atoi( argv[ 1 ] ) : 4;
+    int  num_requests = ( argc > 2 ) ? max( 1, atoi( argv[ 2 ] ) ) : 100;
+    unsigned  seed = ( argc > 3 ) ? (unsigned) atoi( argv[ 3 ] ) : 1u;
+
+    // サンプル動作データの読み込み・モデルの学習
+    BenchSamples  samples;
+    if ( !LoadBenchSamples( "bench_alpha_search", samples ) )
+        return  1;
+    GSModel  model = TrainBenchModel( samples );
+    const Skeleton *  body = model.GetHumanBody().GetSkeleton();
+    printf( "[bench_alpha_search] splats=%d requests=%d budget=%d seed=%u\n", (int) model.GetSplats().size(), num_requests, budget, seed );
+
+    // ランダムな開始・目標姿勢（サンプル動作のフレーム）
+    mt19937  rng( seed );
+    vector< QPosture >  starts, goals;
+    RandomSamplePairs( samples, rng, num_requests, starts, goals );
+
+    GenerateOptions  opts[ 2 ];
+    opts[ 1 ].alpha_search = ALPHA_SEARCH_GOLDEN;
+    opts[ 1 ].alpha_eval_budget = budget;
+    const char *  names[ 2 ] = { "grid", "golden" };
+
+    // 生成全体の比較
+    vector< vector< QPosture > >  grid_poses( num_requests );
+    printf( "search,evals_per_step,steps_mean,final_dist_m,generate_ms_mean\n" );
+    for ( int m = 0; m < 2; m++ )
+    {
+        double  sum_evals = 0.0, sum_steps = 0.0, sum_dist = 0.0, sum_ms = 0.0;
+        vector< float >  times;
+        vector< QPosture >  poses;
+        for ( int i = 0; i < num_requests; i++ )
+        {
+            GenerateResult  result;
+            auto  t0 = clock_type::now();
+            model.GenerateQ( starts[ i ], goals[ i ], opts[ m ], times, poses, &result );
+            sum_ms += chrono::duration< double, milli >( clock_type::now() - t0 ).count();
+            sum_evals += result.evaluations;
+            sum_steps += result.steps;
+            sum_dist += result.final_dist_goal;
+            if ( m == 0 )
+                grid_poses[ i ].assign( poses.begin(), poses.begin() + min( poses.size(), (size_t) result.steps + 1 ) );
+        }
+        printf( "%s,%.2f,%.1f,%.4f,%.3f\n", names[ m ], sum_evals / max( 1.0, sum_steps ), sum_steps / num_requests,
+            sum_dist / num_requests, sum_ms / num_requests );
+    }
+
+    // 同じ状態からの1ステップの比較（グリッドの生成中の各姿勢から、各方式で1ステップ進める）
+    GSModelController  controller( model );
+    QPosture  next( body );
+    FKWorkspace  ws;
+    int  num_states = 0, num_not_worse = 0, num_better = 0;
+    double  sum_delta[ 2 ] = { 0.0, 0.0 }, sum_state_evals[ 2 ] = { 0.0, 0.0 };
+    for ( int i = 0; i < num_requests; i++ )
+        for ( size_t s = 0; s + 1 < grid_poses[ i ].size(); s++ )
+        {
+            float  d0 = model.FKDistance( grid_poses[ i ][ s ], goals[ i ], ws );
+            float  delta[ 2 ];
+            for ( int m = 0; m < 2; m++ )
+            {
+                controller.Begin( grid_poses[ i ][ s ], goals[ i ], opts[ m ] );
+                controller.Step( next );
+                delta[ m ] = d0 - model.FKDistance( next, goals[ i ], ws );
+                sum_delta[ m ] += delta[ m ];
+                sum_state_evals[ m ] += controller.GetStepInfo().num_evals;
+            }
+            num_states++;
+            if ( delta[ 1 ] >= delta[ 0 ] - 1e-6f )
+                num_not_worse++;
+            if ( delta[ 1 ] > delta[ 0 ] + 1e-6f )
+                num_better++;
+        }
+    int  n = max( 1, num_states );
+    printf( "same_state: states=%d grid_delta_mean=%.6f golden_delta_mean=%.6f golden_not_worse=%.1f%% golden_better=%.1f%% evals_per_step grid=%.2f golden=%.2f\n",
+        num_states, sum_delta[ 0 ] / n, sum_delta[ 1 ] / n, 100.0 * num_not_worse / n, 100.0 * num_better / n,
+        sum_state_evals[ 0 ] / n, sum_state_evals[ 1 ] / n );
+    return  0;
+}
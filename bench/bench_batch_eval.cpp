@@ -0,0 +1,126 @@
+/**
+***  キャラクタアニメーションのための人体モデルの表現・基本処理 ライブラリ・サンプルプログラム
+***  Copyright (c) 2015-, Masaki OSHITA (www.oshita-lab.org)
+***  Released under the MIT license http://opensource.org/licenses/mit-license.php
+**/
+
+/**
+***  αグリッドの候補の一括評価（GenerateOptions::batch_candidates）と1つずつの評価の比較
+***
+***  使い方: bench_batch_eval [num_requests=100] [seed=1]
+***    サンプル動作（app_headless と同じ）で学習したモデルに対して、ランダムな開始・目標姿勢の生成を両方式で行い、
+***    生成時間 [ms] と、生成結果（時刻・姿勢）がビット単位で一致するかを出力する。
+***    また、5つの候補姿勢の FK 距離（目標・現在の姿勢との2つ）を FKDistance と FKDistanceBatch で計算し、
+***    候補１つあたりの時間 [ns] と、距離が一致するかを出力する。
+**/
+
+#include "SimpleHuman.h"
+#include "HumanBody.h"
+#include "GSModel.h"
+#include "bench_common.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace  std;
+
+
+typedef chrono::steady_clock  clock_type;
+
+
+// 姿勢がビット単位で一致するか
+static bool  SamePosture( const QPosture & a, const QPosture & b )
+{
+    if ( ( a.body != b.body ) || memcmp( &a.root_pos, &b.root_pos, sizeof( a.root_pos ) ) || memcmp( &a.root_ori, &b.root_ori, sizeof( a.root_ori ) ) )
+        return  false;
+    return  memcmp( &a.joint_rotations[ 0 ], &b.joint_rotations[ 0 ], sizeof( Quat4f ) * a.body->num_joints ) == 0;
+}
+
+
+int  main( int argc, char ** argv )
+{
+    int  num_requests = ( argc > 1 ) ? max( 1, atoi( argv[ 1 ] ) ) : 100;
+    unsigned  seed = ( argc > 2 ) ? (unsigned) atoi( argv[ 2 ] ) : 1u;
+
+    // サンプル動作データの読み込み・モデルの学習
+    BenchSamples  samples;
+    if ( !LoadBenchSamples( "bench_batch_eval", samples ) )
+        return  1;
+    GSModel  model = TrainBenchModel( samples );
+    const Skeleton *  body = model.GetHumanBody().GetSkeleton();
+    printf( "[bench_batch_eval] splats=%d requests=%d lanes=%d seed=%u\n", (int) model.GetSplats().size(), num_requests, GSM_FK_LANES, seed );
+
+    // ランダムな開始・目標姿勢（サンプル動作のフレーム）
+    mt19937  rng( seed );
+    vector< QPosture >  starts, goals;
+    RandomSamplePairs( samples, rng, num_requests, starts, goals );
+
+    // 生成全体の比較（両方式を交互に実行）
+    GenerateOptions  opts[ 2 ];
+    opts[ 0 ].batch_candidates = false;
+    opts[ 1 ].batch_candidates = true;
+    double  sum_ms[ 2 ] = { 0.0, 0.0 }, sum_steps = 0.0;
+    int  num_same = 0;
+    vector< float >  times[ 2 ];
+    vector< QPosture >  poses[ 2 ];
+    for ( int i = 0; i < num_requests; i++ )
+    {
+        GenerateResult  result;
+        for ( int m = 0; m < 2; m++ )
+        {
+            auto  t0 = clock_type::now();
+            model.GenerateQ( starts[ i ], goals[ i ], opts[ m ], times[ m ], poses[ m ], &result );
+            sum_ms[ m ] += chrono::duration< double, milli >( clock_type::now() - t0 ).count();
+        }
+        sum_steps += result.steps;
+        bool  same = ( times[ 0 ] == times[ 1 ] ) && ( poses[ 0 ].size() == poses[ 1 ].size() );
+        for ( size_t k = 0; same && ( k < poses[ 0 ].size() ); k++ )
+            same = SamePosture( poses[ 0 ][ k ], poses[ 1 ][ k ] );
+        num_same += same;
+    }
+    printf( "evaluation,generate_ms_mean,speedup\n" );
+    printf( "sequential,%.3f,1.00x\n", sum_ms[ 0 ] / num_requests );
+    printf( "batch,%.3f,%.2fx\n", sum_ms[ 1 ] / num_requests, sum_ms[ 0 ] / sum_ms[ 1 ] );
+    printf( "steps_mean=%.1f identical=%d/%d\n", sum_steps / num_requests, num_same, num_requests );
+
+    // FK 距離の計算のみの比較（各要求の開始姿勢を現在の姿勢、その後の5要求の開始姿勢を候補とする）
+    const int  num_candidates = 5;
+    FKWorkspace  ws;
+    vector< float >  dist_goal( num_requests * num_candidates ), step_norm( num_requests * num_candidates );
+    vector< float >  batch_goal( num_requests * num_candidates ), batch_norm( num_requests * num_candidates );
+    const QPosture *  candidates[ num_candidates ];
+    double  sec[ 2 ] = { 1e30, 1e30 };
+    for ( int trial = 0; trial < 3; trial++ )
+    {
+        auto  t0 = clock_type::now();
+        for ( int i = 0; i < num_requests; i++ )
+            for ( int c = 0; c < num_candidates; c++ )
+            {
+                const QPosture &  cand = starts[ ( i + 1 + c ) % num_requests ];
+                dist_goal[ i * num_candidates + c ] = model.FKDistance( cand, goals[ i ], ws );
+                step_norm[ i * num_candidates + c ] = model.FKDistance( starts[ i ], cand, ws );
+            }
+        auto  t1 = clock_type::now();
+        for ( int i = 0; i < num_requests; i++ )
+        {
+            for ( int c = 0; c < num_candidates; c++ )
+                candidates[ c ] = &starts[ ( i + 1 + c ) % num_requests ];
+            model.FKDistanceBatch( candidates, num_candidates, goals[ i ], starts[ i ],
+                &batch_goal[ i * num_candidates ], &batch_norm[ i * num_candidates ], ws );
+        }
+        auto  t2 = clock_type::now();
+        sec[ 0 ] = min( sec[ 0 ], chrono::duration< double >( t1 - t0 ).count() );
+        sec[ 1 ] = min( sec[ 1 ], chrono::duration< double >( t2 - t1 ).count() );
+    }
+    bool  same_dist = ( dist_goal == batch_goal ) && ( step_norm == batch_norm );
+    int  n = num_requests * num_candidates;
+    printf( "fk_distance_ns_per_candidate sequential=%.1f batch=%.1f speedup=%.2fx identical=%s\n",
+        sec[ 0 ] / n * 1e9, sec[ 1 ] / n * 1e9, sec[ 0 ] / sec[ 1 ], same_dist ? "yes" : "no" );
+    return  ( num_same == num_requests ) && same_dist ? 0 : 2;
+}
@@ -0,0 +1,165 @@
+/**
+***  キャラクタアニメーションのための人体モデルの表現・基本処理 ライブラリ・サンプルプログラム
+***  Copyright (c) 2015-, Masaki OSHITA (www.oshita-lab.org)
+***  Released under the MIT license http://opensource.org/licenses/mit-license.php
+**/
+
+/**
+***  BVHローダのスループット計測（メモリマップ版 Load と旧実装 LoadByStream の比較）
+***
+***  使い方: bench_bvh_load [size_mb=1024] [src_bvh=motion_rikiya/I25.bvh] [tmp_bvh=bench_synthetic.bvh] [threads=0]
+***    src_bvh の階層構造とモーションを繰り返して size_mb の合成BVHを作成し、各ローダの MB/s を出力する。
+***    Load は１スレッドと threads スレッド（0 の場合はハードウェアのスレッド数）で計測し、結果の一致も確認する。
+**/
+
+#include "BVH.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace  std;
+
+
+// 合成BVHファイルの作成（ヘッダ部はそのまま、モーション行を繰り返して指定サイズにする）
+static bool  MakeSyntheticBVH( const string & src, const string & dst, size_t target_bytes, size_t & out_bytes )
+{
+    ifstream  in( src );
+    if ( !in )
+        return  false;
+
+    vector< string >  header, frames;
+    string  line;
+    bool  in_frames = false;
+    while ( getline( in, line ) )
+    {
+        if ( in_frames )
+        {
+            if ( !line.empty() )
+                frames.push_back( line );
+            continue;
+        }
+        if ( line.compare( 0, 6, "Frames" ) == 0 )
+            continue; // フレーム数は後で書く
+        header.push_back( line );
+        if ( line.compare( 0, 10, "Frame Time" ) == 0 )
+            in_frames = true;
+    }
+    if ( frames.empty() )
+        return  false;
+
+    size_t  header_bytes = 0, frame_bytes = 0;
+    for ( auto & h : header ) header_bytes += h.size() + 1;
+    for ( auto & f : frames ) frame_bytes += f.size() + 1;
+    size_t  num_frames = ( target_bytes > header_bytes ) ? ( target_bytes - header_bytes ) * frames.size() / frame_bytes : frames.size();
+    if ( num_frames < frames.size() )
+        num_frames = frames.size();
+
+    ofstream  out( dst, ios::binary );
+    if ( !out )
+        return  false;
+    for ( size_t i = 0; i + 1 < header.size(); i++ )
+        out << header[ i ] << '\n';
+    out << "Frames: " << num_frames << '\n';
+    out << header.back() << '\n';
+    for ( size_t i = 0; i < num_frames; i++ )
+        out << frames[ i % frames.size() ] << '\n';
+    out_bytes = (size_t) out.tellp();
+    return  true;
+}
+
+
+// 2つのBVHの内容の比較（階層構造・モーションデータ）
+static bool  SameBVH( const BVH & a, const BVH & b )
+{
+    if ( a.GetNumJoint() != b.GetNumJoint() || a.GetNumChannel() != b.GetNumChannel() ||
+         a.GetNumFrame() != b.GetNumFrame() || a.GetInterval() != b.GetInterval() )
+        return  false;
+    for ( int i = 0; i < a.GetNumJoint(); i++ )
+    {
+        const BVH::Joint *  ja = a.GetJoint( i );
+        const BVH::Joint *  jb = b.GetJoint( i );
+        if ( ja->name != jb->name || ja->channels.size() != jb->channels.size() || ja->has_site != jb->has_site )
+            return  false;
+        for ( int k = 0; k < 3; k++ )
+            if ( ja->offset[ k ] != jb->offset[ k ] || ja->site[ k ] != jb->site[ k ] )
+                return  false;
+    }
+    // モーションデータはビット単位で比較
+    for ( int f = 0; f < a.GetNumFrame(); f++ )
+        for ( int c = 0; c < a.GetNumChannel(); c++ )
+        {
+            double  va = a.GetMotion( f, c ), vb = b.GetMotion( f, c );
+            if ( memcmp( &va, &vb, sizeof( double ) ) != 0 )
+                return  false;
+        }
+    return  true;
+}
+
+
+int  main( int argc, char ** argv )
+{
+    size_t  size_mb = ( argc > 1 ) ? strtoul( argv[ 1 ], NULL, 10 ) : 1024;
+    string  src = ( argc > 2 ) ? argv[ 2 ] : "motion_rikiya/I25.bvh";
+    string  tmp = ( argc > 3 ) ? argv[ 3 ] : "bench_synthetic.bvh";
+
+    size_t  bytes = 0;
+    if ( !MakeSyntheticBVH( src, tmp, size_mb * 1024 * 1024, bytes ) )
+    {
+        cerr << "[bench_bvh_load] failed to create synthetic BVH from " << src << endl;
+        return  1;
+    }
+    double  mb = bytes / ( 1024.0 * 1024.0 );
+    cout << "[bench_bvh_load] file=" << tmp << " size=" << mb << " MB" << endl;
+
+    int  num_threads = ( argc > 4 ) ? atoi( argv[ 4 ] ) : 0;
+    if ( num_threads <= 0 )
+        num_threads = max( 1, (int) thread::hardware_concurrency() );
+
+    typedef chrono::steady_clock  clock;
+
+    // 各ローダを交互に繰り返し実行して最短時間を採用（ページキャッシュ・書き戻しの影響を揃えるため）
+    const int  num_trials = 3;
+    BVH  by_stream, by_map, by_par;
+    double  s_stream = 1e30, s_map = 1e30, s_par = 1e30;
+    for ( int trial = 0; trial < num_trials; trial++ )
+    {
+        // 旧実装（ifstream + strtok + atof）
+        auto  t0 = clock::now();
+        by_stream.LoadByStream( tmp.c_str() );
+        auto  t1 = clock::now();
+
+        // メモリマップ + from_chars（１スレッド）
+        auto  t2 = clock::now();
+        by_map.Load( tmp.c_str(), 1 );
+        auto  t3 = clock::now();
+
+        // メモリマップ + from_chars（モーションデータを分割して並列に解析）
+        auto  t4 = clock::now();
+        by_par.Load( tmp.c_str(), num_threads );
+        auto  t5 = clock::now();
+
+        s_stream = min( s_stream, chrono::duration< double >( t1 - t0 ).count() );
+        s_map = min( s_map, chrono::duration< double >( t3 - t2 ).count() );
+        s_par = min( s_par, chrono::duration< double >( t5 - t4 ).count() );
+    }
+    bool  same = by_stream.IsLoadSuccess() && by_map.IsLoadSuccess() && SameBVH( by_stream, by_map );
+    bool  same_par = by_par.IsLoadSuccess() && SameBVH( by_map, by_par );
+
+    printf( "loader,frames,seconds,MB_per_s\n" );
+    printf( "LoadByStream,%d,%.3f,%.1f\n", by_stream.GetNumFrame(), s_stream, mb / s_stream );
+    printf( "Load,%d,%.3f,%.1f\n", by_map.GetNumFrame(), s_map, mb / s_map );
+    printf( "Load(%d threads),%d,%.3f,%.1f\n", num_threads, by_par.GetNumFrame(), s_par, mb / s_par );
+    printf( "speedup=%.2fx identical=%s\n", s_stream / s_map, same ? "yes" : "NO" );
+    printf( "parallel_speedup=%.2fx identical=%s\n", s_map / s_par, same_par ? "yes" : "NO" );
+
+    remove( tmp.c_str() );
+    return  ( same && same_par ) ? 0 : 2;
+}
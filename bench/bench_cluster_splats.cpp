@@ -0,0 +1,189 @@
+/**
+***  キャラクタアニメーションのための人体モデルの表現・基本処理 ライブラリ・サンプルプログラム
+***  Copyright (c) 2015-, Masaki OSHITA (www.oshita-lab.org)
+***  Released under the MIT license http://opensource.org/licenses/mit-license.php
+**/
+
+/**
+***  スプラットの集約の比較（近傍マージ・ミニバッチ k-means による TrainOptions::target_splats）
+***
+***  使い方: bench_cluster_splats [copies=16] [targets=64,256,1024] [num_requests=100] [threads=2] [seed=1]
+***    サンプル動作（app_headless と同じ）を鉛直軸まわりに 360/copies 度ずつ回転した copies 個の動作から、
+***    近傍マージ（merge_radius_m = 0.03）と target_splats の各値でモデルを学習し、スプラット数・学習時間 [s]・
+***    学習データの各フレームと最近傍スプラットの FK 距離（平均・最大）[m]・最近傍探索の FK 距離の計算数、
+***    学習した動作のいずれかと同じ向きのランダムな開始・目標姿勢からの生成時間 [ms]・目標の許容距離に入った要求の割合・
+***    最後の姿勢と目標の距離 [m] を出力する。
+***    また、k-means の結果がスレッド数（1 と threads）によらず同じかを確認する。
+**/
+
+#include "SimpleHuman.h"
+#include "HumanBody.h"
+#include "GSModel.h"
+#include "GSModelTest.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace  std;
+
+
+typedef chrono::steady_clock  clock_type;
+
+
+int  main( int argc, char ** argv )
+{
+    int  copies = ( argc > 1 ) ? max( 1, atoi( argv[ 1 ] ) ) : 16;
+    vector< int >  targets;
+    const char *  targets_arg = ( argc > 2 ) ? argv[ 2 ] : "64,256,1024";
+    for ( const char * s = targets_arg; *s; )
+    {
+        targets.push_back( max( 1, atoi( s ) ) );
+        const char *  comma = strchr( s, ',' );
+        s = comma ? comma + 1 : s + strlen( s );
+    }
+    int  num_requests = ( argc > 3 ) ? max( 1, atoi( argv[ 3 ] ) ) : 100;
+    int  num_threads = ( argc > 4 ) ? max( 1, atoi( argv[ 4 ] ) ) : 2;
+    unsigned  seed = ( argc > 5 ) ? (unsigned) atoi( argv[ 5 ] ) : 1u;
+
+    // サンプル動作データの読み込み
+    vector< const Motion * >  sample_motions;
+    const HumanBody *  sample_body = NULL;
+    vector< Posture * >  sample_key_poses;
+    LoadSampleMotions( sample_motions, &sample_body, sample_key_poses );
+    if ( sample_motions.empty() || !sample_body )
+    {
+        cerr << "[bench_cluster_splats] cannot load sample motions" << endl;
+        return  1;
+    }
+    const Motion *  motion = sample_motions[ 0 ];
+    const Skeleton *  body = sample_body->GetSkeleton();
+
+    // 鉛直軸まわりに回転した学習データの全フレーム（動作ごと）
+    vector< vector< QPosture > >  frames( copies );
+    Posture  p( body );
+    for ( int k = 0; k < copies; k++ )
+    {
+        for ( int f = 0; f < motion->num_frames; f++ )
+        {
+            motion->GetPosture( f * motion->interval, p );
+            Matrix3f  yaw, ori = p.root_ori;
+            yaw.rotY( 2.0f * 3.14159265f * k / copies );
+            p.root_ori.mul( yaw, ori );
+            frames[ k ].push_back( QPosture( p ) );
+        }
+    }
+    printf( "[bench_cluster_splats] copies=%d frames=%d targets=%s requests=%d threads=%d seed=%u\n",
+        copies, copies * motion->num_frames, targets_arg, num_requests, num_threads, seed );
+
+    // 開始・目標姿勢（学習した動作のいずれかのランダムなフレーム、同じ動作から選ぶ）
+    mt19937  rng( seed );
+    vector< const QPosture * >  starts( num_requests ), goals( num_requests );
+    for ( int i = 0; i < num_requests; i++ )
+    {
+        const vector< QPosture > &  m = frames[ rng() % copies ];
+        starts[ i ] = &m[ rng() % m.size() ];
+        goals[ i ] = &m[ rng() % m.size() ];
+    }
+
+    // 学習（target = 0 は近傍マージ）
+    auto  train = [&]( int target, int threads, double * seconds )
+    {
+        TrainOptions  topt;
+        topt.sample_stride    = 1;
+        topt.occ_sigma_m      = 0.05f;
+        topt.merge_radius_m   = 0.03f;
+        topt.stop_v_threshold = 0.15f;
+        topt.target_splats    = target;
+        topt.cluster_threads  = threads;
+        GSModelBuilder  builder( *sample_body, topt );
+        for ( int k = 0; k < copies; k++ )
+        {
+            builder.BeginStream( "rotated", motion->interval );
+            for ( size_t f = 0; f < frames[ k ].size(); f++ )
+            {
+                frames[ k ][ f ].GetPosture( p );
+                builder.AddFrame( p );
+            }
+            builder.EndStream();
+        }
+        auto  t0 = clock_type::now();
+        GSModel *  model = new GSModel( builder.Build() );
+        *seconds = chrono::duration< double >( clock_type::now() - t0 ).count();
+        return  model;
+    };
+
+    printf( "method,splats,train_s,frame_dist_mean,frame_dist_max,nearest_evals,generate_ms_mean,reached,final_dist_mean\n" );
+    for ( int t = -1; t < (int) targets.size(); t++ )
+    {
+        const int  target = ( t < 0 ) ? 0 : targets[ t ];
+        double  train_s = 0.0;
+        GSModel *  model = train( target, num_threads, &train_s );
+
+        // 学習データの各フレームと最近傍スプラットの距離
+        FKWorkspace  ws;
+        double  sum_dist = 0.0;
+        float  max_dist = 0.0f;
+        int  num_frames = 0;
+        for ( int k = 0; k < copies; k++ )
+            for ( size_t f = 0; f < frames[ k ].size(); f++ )
+            {
+                float  d = 0.0f;
+                model->FindNearestSplat( frames[ k ][ f ], &d, ws );
+                sum_dist += d;
+                max_dist = max( max_dist, d );
+                num_frames++;
+            }
+        double  evals = (double) ws.nearest_evals / num_frames;
+
+        // 生成
+        GenerateOptions  gopt;
+        vector< float >  times;
+        vector< QPosture >  poses;
+        double  sum_ms = 0.0, sum_final = 0.0;
+        int  num_reached = 0;
+        for ( int i = 0; i < num_requests; i++ )
+        {
+            GenerateResult  result;
+            auto  t0 = clock_type::now();
+            model->GenerateQ( *starts[ i ], *goals[ i ], gopt, times, poses, &result );
+            sum_ms += chrono::duration< double, milli >( clock_type::now() - t0 ).count();
+            sum_final += result.final_dist_goal;
+            for ( size_t k = 0; k < poses.size(); k++ )
+                if ( model->FKDistance( poses[ k ], *goals[ i ], ws ) <= gopt.goal_tolerance_m )
+                {
+                    num_reached++;
+                    break;
+                }
+        }
+
+        string  method = ( target == 0 ) ? string( "merge" ) : "kmeans_" + to_string( target );
+        printf( "%s,%d,%.3f,%.4f,%.4f,%.1f,%.3f,%.1f%%,%.4f\n", method.c_str(), (int) model->GetSplats().size(), train_s,
+            sum_dist / num_frames, max_dist, evals, sum_ms / num_requests, 100.0 * num_reached / num_requests, sum_final / num_requests );
+        delete  model;
+    }
+
+    // スレッド数によらず同じ結果か（最後の target、スプラットの代表・次の姿勢の FK 距離）
+    double  s1 = 0.0, sn = 0.0;
+    GSModel *  a = train( targets.back(), 1, &s1 );
+    GSModel *  b = train( targets.back(), num_threads, &sn );
+    bool  same = ( a->GetSplats().size() == b->GetSplats().size() );
+    FKWorkspace  ws;
+    for ( size_t i = 0; same && ( i < a->GetSplats().size() ); i++ )
+    {
+        const GaussianSplat &  sa = a->GetSplats()[ i ];
+        const GaussianSplat &  sb = b->GetSplats()[ i ];
+        same = ( a->FKDistance( sa.mean_qpose, sb.mean_qpose, ws ) == 0.0f ) && ( a->FKDistance( sa.next_qpose, sb.next_qpose, ws ) == 0.0f ) &&
+            ( sa.v_norm_ref == sb.v_norm_ref );
+    }
+    printf( "threads 1 vs %d: train_s=%.3f/%.3f same_result=%s\n", num_threads, s1, sn, same ? "yes" : "no" );
+    delete  a;
+    delete  b;
+    return  0;
+}
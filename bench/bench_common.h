@@ -0,0 +1,94 @@
+/**
+***  キャラクタアニメーションのための人体モデルの表現・基本処理 ライブラリ・サンプルプログラム
+***  Copyright (c) 2015-, Masaki OSHITA (www.oshita-lab.org)
+***  Released under the MIT license http://opensource.org/licenses/mit-license.php
+**/
+
+/**
+***  ベンチマークの共通処理（サンプル動作データの読み込み・学習、ランダムな開始・目標姿勢）
+***    学習オプションは TrainGSModel と同じ（SetSampleTrainOptions、ダンプなし）
+**/
+
+#ifndef  _BENCH_COMMON_H_
+#define  _BENCH_COMMON_H_
+
+#include "SimpleHuman.h"
+#include "HumanBody.h"
+#include "GSModel.h"
+#include "GSModelTest.h"
+
+#include <iostream>
+#include <random>
+#include <vector>
+
+
+// サンプル動作データ（app_headless と同じ）
+struct  BenchSamples
+{
+    std::vector< const Motion * >  motions;
+    const HumanBody *  body = NULL;
+    std::vector< Posture * >  key_poses;
+};
+
+
+// サンプル動作データの読み込み（読み込めなければ bench_name を付けて出力し、false を返す）
+inline bool  LoadBenchSamples( const char * bench_name, BenchSamples & samples )
+{
+    LoadSampleMotions( samples.motions, &samples.body, samples.key_poses );
+    if ( samples.motions.empty() || !samples.body )
+    {
+        std::cerr << "[" << bench_name << "] cannot load sample motions" << std::endl;
+        return  false;
+    }
+    return  true;
+}
+
+
+// サンプル動作データからのモデルの学習（TrainGSModel と同じ設定、ダンプなし）
+inline GSModel  TrainBenchModel( const BenchSamples & samples )
+{
+    TrainOptions  topt;
+    SetSampleTrainOptions( topt );
+    return  GSModel::Fit( *samples.body, samples.motions, topt );
+}
+
+
+// ランダムなサンプル動作・フレームの時刻
+inline void  RandomSampleTime( const BenchSamples & samples, std::mt19937 & rng, const Motion ** motion, float * time )
+{
+    *motion = samples.motions[ rng() % samples.motions.size() ];
+    *time = ( rng() % ( *motion )->num_frames ) * ( *motion )->interval;
+}
+
+// ランダムなサンプル動作のフレームの姿勢
+inline void  RandomSamplePose( const BenchSamples & samples, std::mt19937 & rng, Posture & p )
+{
+    const Motion *  m;
+    float  t;
+    RandomSampleTime( samples, rng, &m, &t );
+    m->GetPosture( t, p );
+}
+
+inline void  RandomSamplePose( const BenchSamples & samples, std::mt19937 & rng, QPosture & q )
+{
+    Posture  p( samples.body->GetSkeleton() );
+    RandomSamplePose( samples, rng, p );
+    q.SetPosture( p );
+}
+
+// ランダムな開始・目標姿勢の組（サンプル動作のフレーム、開始・目標の順に選ぶ）
+inline void  RandomSamplePairs( const BenchSamples & samples, std::mt19937 & rng, int num,
+    std::vector< QPosture > & starts, std::vector< QPosture > & goals )
+{
+    const Skeleton *  body = samples.body->GetSkeleton();
+    starts.assign( num, QPosture( body ) );
+    goals.assign( num, QPosture( body ) );
+    for ( int i = 0; i < num; i++ )
+    {
+        RandomSamplePose( samples, rng, starts[ i ] );
+        RandomSamplePose( samples, rng, goals[ i ] );
+    }
+}
+
+
+#endif // _BENCH_COMMON_H_
@@ -0,0 +1,204 @@
+/**
+***  キャラクタアニメーションのための人体モデルの表現・基本処理 ライブラリ・サンプルプログラム
+***  Copyright (c) 2015-, Masaki OSHITA (www.oshita-lab.org)
+***  Released under the MIT license http://opensource.org/licenses/mit-license.php
+**/
+
+/**
+***  逐次生成コントローラ（GSModelController）の計測
+***
+***  使い方: bench_controller [num_requests=200] [seed=1]
+***    サンプル動作（app_headless と同じ）で学習したモデルに対して、ランダムな開始・目標姿勢の生成を
+***    GSModel::GenerateQ（全体を一括生成）と GSModelController（1ステップずつ生成）で行い、
+***    最初の姿勢が得られるまでの時間 [us]、1ステップの時間 [us]、Step 中のメモリ確保の回数、
+***    両者の姿勢列の差（FK距離の最大値 [m]）・終了状態が異なる要求の数を出力する。
+***    また、生成の途中（10ステップ後）で目標姿勢を変更した場合の終了状態・最終姿勢と新しい目標姿勢の FK 距離と、
+***    経路計画あり（GenerateOptions::use_planner）の Step 中のメモリ確保の回数（経路キャッシュにない経路の計画1回あたり）も出力する。
+**/
+
+#include "SimpleHuman.h"
+#include "HumanBody.h"
+#include "GSModel.h"
+#include "GSModelController.h"
+#include "bench_common.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+#include <vector>
+
+using namespace  std;
+
+
+// メモリ確保の回数（Step 中に確保しないことの確認用）
+static atomic< long >  num_allocations( 0 );
+
+void *  operator new( size_t size )
+{
+    num_allocations++;
+    void *  p = malloc( size ? size : 1 );
+    if ( !p )
+        throw  bad_alloc();
+    return  p;
+}
+
+void  operator delete( void * p ) noexcept
+{
+    free( p );
+}
+
+void  operator delete( void * p, size_t ) noexcept
+{
+    free( p );
+}
+
+
+typedef chrono::steady_clock  clock_type;
+
+static double  ElapsedUs( clock_type::time_point t0 )
+{
+    return  chrono::duration< double, micro >( clock_type::now() - t0 ).count();
+}
+
+// 百分位数
+static double  Percentile( vector< double > values, double q )
+{
+    if ( values.empty() )
+        return  0.0;
+    size_t  k = min( values.size() - 1, (size_t)( q * values.size() ) );
+    nth_element( values.begin(), values.begin() + k, values.end() );
+    return  values[ k ];
+}
+
+
+int  main( int argc, char ** argv )
+{
+    int  num_requests = ( argc > 1 ) ? atoi( argv[ 1 ] ) : 200;
+    unsigned  seed = ( argc > 2 ) ? (unsigned) atoi( argv[ 2 ] ) : 1u;
+
+    // サンプル動作データの読み込み・モデルの学習
+    BenchSamples  samples;
+    if ( !LoadBenchSamples( "bench_controller", samples ) )
+        return  1;
+    GSModel  model = TrainBenchModel( samples );
+    const Skeleton *  body = model.GetHumanBody().GetSkeleton();
+    printf( "[bench_controller] splats=%d requests=%d seed=%u\n", (int) model.GetSplats().size(), num_requests, seed );
+
+    // ランダムな開始・目標姿勢（サンプル動作のフレーム）
+    mt19937  rng( seed );
+
+    GenerateOptions  gopt;
+    GSModelController  controller( model );
+    QPosture  start( body ), goal( body ), goal2( body ), pose( body );
+    FKWorkspace  ws;
+    vector< float >  times;
+    vector< QPosture >  poses;
+    vector< double >  full_us, first_us, step_us;
+    long  step_allocations = 0;
+    int  num_mismatch = 0, num_status_mismatch = 0, retarget_status[ 4 ] = { 0, 0, 0, 0 };
+    double  sum_retarget_dist = 0.0;
+    double  max_diff = 0.0;
+    for ( int i = 0; i < num_requests; i++ )
+    {
+        RandomSamplePose( samples, rng, start );
+        RandomSamplePose( samples, rng, goal );
+        RandomSamplePose( samples, rng, goal2 );
+
+        // 一括生成
+        GenerateResult  result;
+        auto  t0 = clock_type::now();
+        model.GenerateQ( start, goal, gopt, times, poses, &result );
+        full_us.push_back( ElapsedUs( t0 ) );
+
+        // 逐次生成（最初の姿勢までの時間・1ステップの時間・メモリ確保の回数）
+        t0 = clock_type::now();
+        controller.Begin( start, goal, gopt );
+        bool  advanced = controller.Step( pose );
+        first_us.push_back( ElapsedUs( t0 ) );
+        size_t  k = 1;
+        while ( advanced )
+        {
+            double  diff = ( k < poses.size() ) ? model.FKDistance( pose, poses[ k ], ws ) : 1e30;
+            max_diff = max( max_diff, diff );
+            k++;
+            long  a0 = num_allocations;
+            t0 = clock_type::now();
+            advanced = controller.Step( pose );
+            double  us = ElapsedUs( t0 );
+            step_allocations += num_allocations - a0;
+            step_us.push_back( us );
+        }
+        if ( k != poses.size() )
+            num_mismatch++;
+        if ( controller.GetStatus() != result.status )
+            num_status_mismatch++;
+
+        // 途中で目標姿勢を変更
+        controller.Begin( start, goal, gopt );
+        for ( int s = 0; s < 10 && controller.Step( pose ); s++ )
+            ;
+        controller.SetGoal( goal2 );
+        while ( controller.Step( pose ) )
+            ;
+        retarget_status[ controller.GetStatus() ]++;
+        sum_retarget_dist += model.FKDistance( controller.GetPose(), goal2, ws );
+    }
+
+    // 経路計画あり（メモリを確保するのは経路キャッシュに新しい経路を登録するステップのみ）
+    GenerateOptions  popt;
+    popt.use_planner = true;
+    long  planner_steps = 0, planner_allocations = 0, new_plan_allocations = 0;
+    long long  hits0, misses0, hits1, misses1;
+    model.GetPlanCacheStats( &hits0, &misses0 );
+    for ( int i = 0; i < num_requests; i++ )
+    {
+        RandomSamplePose( samples, rng, start );
+        RandomSamplePose( samples, rng, goal );
+        controller.Begin( start, goal, popt );
+        bool  advanced = true;
+        while ( advanced )
+        {
+            long long  m0;
+            model.GetPlanCacheStats( NULL, &m0 );
+            long  a0 = num_allocations;
+            advanced = controller.Step( pose );
+            long  a = num_allocations - a0;
+            long long  m1;
+            model.GetPlanCacheStats( NULL, &m1 );
+            planner_allocations += a;
+            if ( m1 != m0 )
+                new_plan_allocations += a;
+            planner_steps++;
+        }
+    }
+    model.GetPlanCacheStats( &hits1, &misses1 );
+
+    double  sum_full = 0.0, sum_first = 0.0, sum_step = 0.0;
+    for ( int i = 0; i < num_requests; i++ )
+    {
+        sum_full += full_us[ i ];
+        sum_first += first_us[ i ];
+    }
+    for ( size_t i = 0; i < step_us.size(); i++ )
+        sum_step += step_us[ i ];
+    int  n = max( 1, num_requests );
+    printf( "generate_q_us mean=%.1f p50=%.1f p99=%.1f\n", sum_full / n, Percentile( full_us, 0.50 ), Percentile( full_us, 0.99 ) );
+    printf( "first_pose_us mean=%.1f p50=%.1f p99=%.1f\n", sum_first / n, Percentile( first_us, 0.50 ), Percentile( first_us, 0.99 ) );
+    printf( "step_us mean=%.2f p50=%.2f p99=%.2f max=%.2f steps=%d allocations_per_step=%.3f\n",
+        sum_step / max( (size_t) 1, step_us.size() ), Percentile( step_us, 0.50 ), Percentile( step_us, 0.99 ),
+        step_us.empty() ? 0.0 : *max_element( step_us.begin(), step_us.end() ), (int) step_us.size(),
+        (double) step_allocations / max( (size_t) 1, step_us.size() ) );
+    printf( "same_as_generate_q: length_mismatch=%d status_mismatch=%d max_fk_diff_m=%.3g\n", num_mismatch, num_status_mismatch, max_diff );
+    printf( "retarget_after_10_steps: reached=%d stalled=%d max_steps=%d final_dist_m mean=%.4f\n",
+        retarget_status[ GENERATE_REACHED ], retarget_status[ GENERATE_STALLED ], retarget_status[ GENERATE_MAX_STEPS ],
+        sum_retarget_dist / n );
+    printf( "planner: steps=%ld allocations_per_step=%.3f new_plans=%lld cached_plans=%lld allocations_per_new_plan=%.2f allocations_outside_new_plans=%ld\n",
+        planner_steps, (double) planner_allocations / max( 1L, planner_steps ), misses1 - misses0, hits1 - hits0,
+        (double) new_plan_allocations / max( 1LL, misses1 - misses0 ), planner_allocations - new_plan_allocations );
+    return  0;
+}
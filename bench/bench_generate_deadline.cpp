@@ -0,0 +1,183 @@
+/**
+***  キャラクタアニメーションのための人体モデルの表現・基本処理 ライブラリ・サンプルプログラム
+***  Copyright (c) 2015-, Masaki OSHITA (www.oshita-lab.org)
+***  Released under the MIT license http://opensource.org/licenses/mit-license.php
+**/
+
+/**
+***  制限時間付きの動作生成（GenerateOptions::deadline_ms）のレイテンシの計測
+***
+***  使い方: bench_generate_deadline [deadline_ms=0] [num_requests=400] [num_threads=ハードウェアのスレッド数] [seed=1]
+***    サンプル動作（app_headless と同じ）で学習したモデルに対して、ランダムな開始・目標姿勢（サンプル動作のフレーム）の
+***    生成を num_threads スレッドで並行に実行し、制限時間なし・ありのそれぞれで生成時間の p50/p99/max [ms]、
+***    終了状態（reached / max_steps / stalled / deadline）の件数、最終姿勢と目標姿勢の FK 距離の平均 [m] を出力する。
+***    deadline_ms が 0 以下なら、制限時間なしの生成時間の p50 の半分（打ち切り・探索の簡略化が起きる制限時間）を使う。
+***    以下を確認し、満たさなければ 1 を返す。
+***      - 制限時間なしでは打ち切りがなく、制限時間ありでは打ち切り・探索の簡略化が起きる
+***      - 終了状態が reached であることと、返した動作のいずれかの姿勢が目標の許容距離内であることが一致する
+**/
+
+#include "SimpleHuman.h"
+#include "HumanBody.h"
+#include "GSModel.h"
+#include "bench_common.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace  std;
+
+
+struct  Request
+{
+    const Motion *  start_motion;
+    float  start_time;
+    const Motion *  goal_motion;
+    float  goal_time;
+};
+
+struct  Summary
+{
+    vector< float >  latency_ms;
+    int  status_count[ 5 ] = { 0, 0, 0, 0, 0 };
+    int  num_truncated = 0;
+    int  level_count[ 3 ] = { 0, 0, 0 };
+    double  sum_final_dist = 0.0;
+    int  num_mismatch = 0;    // 終了状態が reached であることと、返した動作が目標の許容距離内に入ったことが一致しない要求の数
+};
+
+
+// 百分位数
+static float  Percentile( vector< float > values, double q )
+{
+    if ( values.empty() )
+        return  0.0f;
+    size_t  k = min( values.size() - 1, (size_t)( q * values.size() ) );
+    nth_element( values.begin(), values.begin() + k, values.end() );
+    return  values[ k ];
+}
+
+
+// 全要求を num_threads スレッドで並行に生成（各スレッドが未処理の要求を順番に取り出す）
+static Summary  RunRequests( const GSModel & model, const vector< Request > & requests, const GenerateOptions & gopt, int num_threads )
+{
+    const Skeleton *  body = model.GetHumanBody().GetSkeleton();
+    int  num_requests = requests.size();
+    vector< float >  latency( num_requests, 0.0f ), final_dist( num_requests, 0.0f );
+    vector< char >  reached( num_requests, 0 );
+    vector< GenerateResult >  results( num_requests );
+    atomic< int >  next( 0 );
+    auto  worker = [&]()
+    {
+        Posture  start( body ), goal( body );
+        FKWorkspace  ws;
+        vector< float >  times;
+        vector< QPosture >  poses;
+        int  i;
+        while ( ( i = next.fetch_add( 1 ) ) < num_requests )
+        {
+            const Request &  r = requests[ i ];
+            r.start_motion->GetPosture( r.start_time, start );
+            r.goal_motion->GetPosture( r.goal_time, goal );
+            QPosture  qstart( start ), qgoal( goal );
+            model.GenerateQ( qstart, qgoal, gopt, times, poses, &results[ i ] );
+            latency[ i ] = results[ i ].elapsed_ms;
+            final_dist[ i ] = results[ i ].final_dist_goal;
+
+            // 返した動作が目標の許容距離内に入ったか（生成時間の計測後）
+            for ( size_t k = 0; k < poses.size() && !reached[ i ]; k++ )
+                reached[ i ] = ( model.FKDistance( poses[ k ], qgoal, ws ) <= max( 1e-4f, gopt.goal_tolerance_m ) );
+        }
+    };
+    vector< thread >  threads;
+    for ( int t = 1; t < num_threads; t++ )
+        threads.push_back( thread( worker ) );
+    worker();
+    for ( size_t t = 0; t < threads.size(); t++ )
+        threads[ t ].join();
+
+    Summary  s;
+    s.latency_ms = latency;
+    for ( int i = 0; i < num_requests; i++ )
+    {
+        s.status_count[ results[ i ].status ]++;
+        s.num_truncated += results[ i ].truncated ? 1 : 0;
+        s.level_count[ results[ i ].max_level ]++;
+        s.sum_final_dist += final_dist[ i ];
+        s.num_mismatch += ( ( results[ i ].status == GENERATE_REACHED ) != ( reached[ i ] != 0 ) ) ? 1 : 0;
+    }
+    return  s;
+}
+
+
+static void  PrintSummary( const char * label, float deadline_ms, const Summary & s )
+{
+    int  n = s.latency_ms.size();
+    printf( "%s,%.3f,%.3f,%.3f,%.3f,%d,%d,%d,%d,%d,%d/%d/%d,%.4f,%d\n", label, deadline_ms,
+        Percentile( s.latency_ms, 0.50 ), Percentile( s.latency_ms, 0.99 ),
+        n ? *max_element( s.latency_ms.begin(), s.latency_ms.end() ) : 0.0f,
+        s.status_count[ GENERATE_REACHED ], s.status_count[ GENERATE_MAX_STEPS ], s.status_count[ GENERATE_STALLED ],
+        s.status_count[ GENERATE_DEADLINE ], s.num_truncated, s.level_count[ 0 ], s.level_count[ 1 ], s.level_count[ 2 ],
+        n ? s.sum_final_dist / n : 0.0, s.num_mismatch );
+}
+
+
+int  main( int argc, char ** argv )
+{
+    float  deadline_ms = ( argc > 1 ) ? (float) atof( argv[ 1 ] ) : 0.0f;
+    int  num_requests = ( argc > 2 ) ? max( 1, atoi( argv[ 2 ] ) ) : 400;
+    int  num_threads = ( argc > 3 ) ? max( 1, atoi( argv[ 3 ] ) ) : max( 1, (int) thread::hardware_concurrency() );
+    unsigned  seed = ( argc > 4 ) ? (unsigned) atoi( argv[ 4 ] ) : 1u;
+
+    // サンプル動作データの読み込み・モデルの学習
+    BenchSamples  samples;
+    if ( !LoadBenchSamples( "bench_generate_deadline", samples ) )
+        return  1;
+    GSModel  model = TrainBenchModel( samples );
+
+    // ランダムな開始・目標姿勢（サンプル動作のフレームの時刻）
+    mt19937  rng( seed );
+    vector< Request >  requests( num_requests );
+    for ( int i = 0; i < num_requests; i++ )
+    {
+        Request &  r = requests[ i ];
+        RandomSampleTime( samples, rng, &r.start_motion, &r.start_time );
+        RandomSampleTime( samples, rng, &r.goal_motion, &r.goal_time );
+    }
+    printf( "[bench_generate_deadline] splats=%d requests=%d threads=%d seed=%u\n", (int) model.GetSplats().size(), num_requests, num_threads, seed );
+
+    // 制限時間なし・ありの比較
+    GenerateOptions  gopt;
+    printf( "mode,deadline_ms,p50_ms,p99_ms,max_ms,reached,max_steps,stalled,deadline,truncated,level0/1/2,final_dist_m,status_mismatch\n" );
+    Summary  base = RunRequests( model, requests, gopt, num_threads );
+    PrintSummary( "unlimited", 0.0f, base );
+    if ( deadline_ms <= 0.0f )
+        deadline_ms = 0.5f * Percentile( base.latency_ms, 0.50 );
+    gopt.deadline_ms = deadline_ms;
+    Summary  limited = RunRequests( model, requests, gopt, num_threads );
+    PrintSummary( "deadline", deadline_ms, limited );
+
+    // 確認
+    bool  ok = true;
+    auto  check = [&]( bool cond, const char * what )
+    {
+        if ( !cond )
+        {
+            printf( "check failed: %s\n", what );
+            ok = false;
+        }
+    };
+    check( base.status_count[ GENERATE_DEADLINE ] == 0 && base.num_truncated == 0, "unlimited run was truncated" );
+    check( base.status_count[ GENERATE_REACHED ] > 0, "unlimited run reached no goal" );
+    check( limited.status_count[ GENERATE_DEADLINE ] + limited.num_truncated > 0, "deadline never truncated a request" );
+    check( limited.level_count[ 1 ] + limited.level_count[ 2 ] > 0, "deadline never degraded the search" );
+    check( base.num_mismatch == 0 && limited.num_mismatch == 0, "status reached does not match the returned motion" );
+    printf( "check: %s\n", ok ? "ok" : "failed" );
+    return  ok ? 0 : 1;
+}
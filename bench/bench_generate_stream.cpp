@@ -0,0 +1,165 @@
+/**
+***  キャラクタアニメーションのための人体モデルの表現・基本処理 ライブラリ・サンプルプログラム
+***  Copyright (c) 2015-, Masaki OSHITA (www.oshita-lab.org)
+***  Released under the MIT license http://opensource.org/licenses/mit-license.php
+**/
+
+/**
+***  逐次出力の生成（GSModel::GenerateStream）と一括生成（GSModel::GenerateQ）の比較
+***
+***  使い方: bench_generate_stream [num_requests=100] [dt_seconds=0.0333] [seed=1]
+***    サンプル動作（app_headless と同じ）で学習したモデルに対して、ランダムな開始・目標姿勢の生成を行い、
+***    最初の姿勢が得られるまでの時間 [us]、生成全体の時間 [us]、生成中のヒープの最大使用量（開始時からの増分）[KB] を出力する。
+***    dt_seconds を小さくすると１回の生成のキー数が増える（長い動作の比較）。
+**/
+
+#include "SimpleHuman.h"
+#include "HumanBody.h"
+#include "GSModel.h"
+#include "bench_common.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+#include <vector>
+
+using namespace  std;
+
+
+// ヒープの使用量（確保したサイズを先頭に記録して、解放時に差し引く、サンプル動作の読み込みスレッドからも呼ばれる）
+static atomic< size_t >  heap_bytes( 0 ), heap_peak( 0 );
+
+void *  operator new( size_t size )
+{
+    size_t *  p = (size_t *) malloc( size + sizeof( max_align_t ) );
+    if ( !p )
+        throw  bad_alloc();
+    *p = size;
+    size_t  bytes = heap_bytes.fetch_add( size ) + size;
+    size_t  peak = heap_peak.load();
+    while ( peak < bytes && !heap_peak.compare_exchange_weak( peak, bytes ) )
+        ;
+    return  (char *) p + sizeof( max_align_t );
+}
+
+void  operator delete( void * p ) noexcept
+{
+    if ( !p )
+        return;
+    size_t *  h = (size_t *)( (char *) p - sizeof( max_align_t ) );
+    heap_bytes.fetch_sub( *h );
+    free( h );
+}
+
+void  operator delete( void * p, size_t ) noexcept
+{
+    operator delete( p );
+}
+
+
+typedef chrono::steady_clock  clock_type;
+
+static double  ElapsedUs( clock_type::time_point t0 )
+{
+    return  chrono::duration< double, micro >( clock_type::now() - t0 ).count();
+}
+
+// 百分位数
+static double  Percentile( vector< double > values, double q )
+{
+    if ( values.empty() )
+        return  0.0;
+    size_t  k = min( values.size() - 1, (size_t)( q * values.size() ) );
+    nth_element( values.begin(), values.begin() + k, values.end() );
+    return  values[ k ];
+}
+
+
+struct  Measure
+{
+    vector< double >  first_us, total_us, peak_kb;
+    double  sum_keys = 0.0;
+
+    void  Print( const char * label ) const
+    {
+        int  n = max( (size_t) 1, total_us.size() );
+        printf( "%s,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f\n", label, sum_keys / n,
+            Percentile( first_us, 0.50 ), Percentile( first_us, 0.99 ), Percentile( total_us, 0.50 ), Percentile( total_us, 0.99 ),
+            Percentile( peak_kb, 0.50 ), *max_element( peak_kb.begin(), peak_kb.end() ) );
+    }
+};
+
+
+int  main( int argc, char ** argv )
+{
+    int  num_requests = ( argc > 1 ) ? max( 1, atoi( argv[ 1 ] ) ) : 100;
+    float  dt = ( argc > 2 ) ? (float) atof( argv[ 2 ] ) : 1.0f / 30.0f;
+    unsigned  seed = ( argc > 3 ) ? (unsigned) atoi( argv[ 3 ] ) : 1u;
+
+    // サンプル動作データの読み込み・モデルの学習
+    BenchSamples  samples;
+    if ( !LoadBenchSamples( "bench_generate_stream", samples ) )
+        return  1;
+    GSModel  model = TrainBenchModel( samples );
+    const Skeleton *  body = model.GetHumanBody().GetSkeleton();
+    printf( "[bench_generate_stream] splats=%d requests=%d dt=%g seed=%u\n", (int) model.GetSplats().size(), num_requests, dt, seed );
+
+    // ランダムな開始・目標姿勢（サンプル動作のフレーム）
+    mt19937  rng( seed );
+    vector< QPosture >  starts, goals;
+    RandomSamplePairs( samples, rng, num_requests, starts, goals );
+
+    GenerateOptions  gopt;
+    gopt.dt_seconds = dt;
+    gopt.max_steps = max( gopt.max_steps, (int)( 20.0f / dt ) );
+    Measure  batch, stream;
+    for ( int i = 0; i < num_requests; i++ )
+    {
+        // 一括生成（全体が得られてから最初の姿勢を使用できる）
+        {
+            vector< float >  times;
+            vector< QPosture >  poses;
+            size_t  base = heap_bytes;
+            heap_peak = heap_bytes.load();
+            auto  t0 = clock_type::now();
+            model.GenerateQ( starts[ i ], goals[ i ], gopt, times, poses );
+            double  us = ElapsedUs( t0 );
+            batch.first_us.push_back( us );
+            batch.total_us.push_back( us );
+            batch.peak_kb.push_back( ( heap_peak - base ) / 1024.0 );
+            batch.sum_keys += times.size();
+        }
+
+        // 逐次出力（出力先は姿勢を保持せずに集計のみ）
+        {
+            double  first = -1.0;
+            int  num_keys = 0;
+            float  sum_y = 0.0f;
+            size_t  base = heap_bytes;
+            heap_peak = heap_bytes.load();
+            auto  t0 = clock_type::now();
+            model.GenerateStream( starts[ i ], goals[ i ], gopt, [&]( float, const QPosture & pose )
+            {
+                if ( first < 0.0 )
+                    first = ElapsedUs( t0 );
+                sum_y += pose.root_pos.y;
+                num_keys++;
+                return  true;
+            } );
+            stream.total_us.push_back( ElapsedUs( t0 ) );
+            stream.first_us.push_back( first );
+            stream.peak_kb.push_back( ( heap_peak - base ) / 1024.0 );
+            stream.sum_keys += num_keys;
+        }
+    }
+
+    printf( "mode,keys_mean,first_pose_us_p50,first_pose_us_p99,total_us_p50,total_us_p99,peak_heap_kb_p50,peak_heap_kb_max\n" );
+    batch.Print( "GenerateQ" );
+    stream.Print( "GenerateStream" );
+    return  0;
+}
@@ -0,0 +1,139 @@
+/**
+***  キャラクタアニメーションのための人体モデルの表現・基本処理 ライブラリ・サンプルプログラム
+***  Copyright (c) 2015-, Masaki OSHITA (www.oshita-lab.org)
+***  Released under the MIT license http://opensource.org/licenses/mit-license.php
+**/
+
+/**
+***  登録した目標姿勢の目標表（GSModel::RegisterGoal）の有無による経路計画付きの生成の比較
+***
+***  使い方: bench_goal_landmarks [num_requests=200] [num_goals=4] [seed=1]
+***    サンプル動作（app_headless と同じ）で学習したモデルに対して、num_goals 個の目標姿勢のいずれかへ向かう
+***    ランダムな開始姿勢からの生成（use_planner）を、A*（経路キャッシュあり）と目標表で行い、
+***    目標の登録時間・生成時間 [ms]（平均・最大）・計画回数・同じ結果になった要求の割合を出力する。
+***    また、目標までの時間の取得を目標表（GetCostToGo）と経路キャッシュ（PlanSplatPath）で比較する。
+**/
+
+#include "SimpleHuman.h"
+#include "HumanBody.h"
+#include "GSModel.h"
+#include "bench_common.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace  std;
+
+
+typedef chrono::steady_clock  clock_type;
+
+
+int  main( int argc, char ** argv )
+{
+    int  num_requests = ( argc > 1 ) ? max( 1, atoi( argv[ 1 ] ) ) : 200;
+    int  num_goals = ( argc > 2 ) ? max( 1, atoi( argv[ 2 ] ) ) : 4;
+    unsigned  seed = ( argc > 3 ) ? (unsigned) atoi( argv[ 3 ] ) : 1u;
+
+    // サンプル動作データの読み込み・モデルの学習
+    //   経路キャッシュはモデルの複製間で共有されるため、比較する2つのモデルはそれぞれ学習
+    BenchSamples  samples;
+    if ( !LoadBenchSamples( "bench_goal_landmarks", samples ) )
+        return  1;
+    GSModel  models[ 2 ] = { TrainBenchModel( samples ), TrainBenchModel( samples ) };
+    const Skeleton *  body = models[ 0 ].GetHumanBody().GetSkeleton();
+    int  num_splats = models[ 0 ].GetSplats().size();
+    printf( "[bench_goal_landmarks] splats=%d graph_edges=%d requests=%d goals=%d seed=%u\n",
+        num_splats, models[ 0 ].GetNumGraphEdges(), num_requests, num_goals, seed );
+
+    // 目標姿勢・ランダムな開始姿勢（サンプル動作のフレーム）
+    mt19937  rng( seed );
+    vector< QPosture >  goals( num_goals, QPosture( body ) ), starts( num_requests, QPosture( body ) );
+    for ( int g = 0; g < num_goals; g++ )
+        RandomSamplePose( samples, rng, goals[ g ] );
+    for ( int i = 0; i < num_requests; i++ )
+        RandomSamplePose( samples, rng, starts[ i ] );
+
+    // 目標の登録（目標表は models[ 1 ] のみ）
+    vector< int >  landmarks( num_goals );
+    auto  t0 = clock_type::now();
+    for ( int g = 0; g < num_goals; g++ )
+        landmarks[ g ] = models[ 1 ].RegisterGoal( goals[ g ] );
+    double  register_ms = chrono::duration< double, milli >( clock_type::now() - t0 ).count();
+    printf( "register_ms_per_goal=%.3f landmarks=%d\n", register_ms / num_goals, models[ 1 ].GetNumGoalLandmarks() );
+
+    // 生成の比較
+    GenerateOptions  gopt;
+    gopt.use_planner = true;
+    const char *  names[ 2 ] = { "astar", "landmark" };
+    vector< vector< QPosture > >  results[ 2 ];
+    printf( "mode,generate_ms_mean,generate_ms_max,plans_mean,keys_mean\n" );
+    for ( int m = 0; m < 2; m++ )
+    {
+        double  sum_ms = 0.0, max_ms = 0.0, sum_plans = 0.0, sum_keys = 0.0;
+        vector< float >  times;
+        results[ m ].resize( num_requests );
+        for ( int i = 0; i < num_requests; i++ )
+        {
+            GenerateResult  result;
+            auto  t0 = clock_type::now();
+            models[ m ].GenerateQ( starts[ i ], goals[ i % num_goals ], gopt, times, results[ m ][ i ], &result );
+            double  ms = chrono::duration< double, milli >( clock_type::now() - t0 ).count();
+            sum_ms += ms;
+            max_ms = max( max_ms, ms );
+            sum_plans += result.plans;
+            sum_keys += times.size();
+        }
+        printf( "%s,%.3f,%.3f,%.2f,%.2f\n", names[ m ], sum_ms / num_requests, max_ms, sum_plans / num_requests, sum_keys / num_requests );
+    }
+
+    // 同じ結果になった要求（最短時間が同じ経路が複数ある場合は異なることがある）
+    FKWorkspace  ws;
+    int  num_same = 0;
+    float  max_diff = 0.0f;
+    for ( int i = 0; i < num_requests; i++ )
+    {
+        const vector< QPosture > &  a = results[ 0 ][ i ];
+        const vector< QPosture > &  b = results[ 1 ][ i ];
+        bool  same = ( a.size() == b.size() );
+        for ( size_t k = 0; same && ( k < a.size() ); k++ )
+        {
+            float  d = models[ 0 ].FKDistance( a[ k ], b[ k ], ws );
+            max_diff = max( max_diff, d );
+            same = ( d == 0.0f );
+        }
+        num_same += same;
+    }
+    printf( "same_result=%.1f%% max_fk_diff_m=%g\n", 100.0 * num_same / num_requests, max_diff );
+
+    // 目標までの時間の取得（全スプラット × 目標、経路キャッシュは上の生成で作成済みのものを含む）
+    vector< int >  goal_sids( num_goals ), path;
+    for ( int g = 0; g < num_goals; g++ )
+        goal_sids[ g ] = models[ 1 ].GetGoalLandmarkSplat( landmarks[ g ] );
+    double  sec[ 2 ];
+    volatile float  sink = 0.0f;
+    for ( int m = 0; m < 2; m++ )
+    {
+        auto  t0 = clock_type::now();
+        for ( int pass = 0; pass < 2; pass++ )
+            for ( int g = 0; g < num_goals; g++ )
+                for ( int s = 0; s < num_splats; s++ )
+                {
+                    if ( m == 0 )
+                    {
+                        models[ 0 ].PlanSplatPath( s, goal_sids[ g ], path );
+                        sink = sink + path.size();
+                    }
+                    else
+                        sink = sink + models[ 1 ].GetCostToGo( landmarks[ g ], s );
+                }
+        sec[ m ] = chrono::duration< double >( clock_type::now() - t0 ).count();
+    }
+    int  num_lookups = 2 * num_goals * num_splats;
+    printf( "cost_to_go_ns plan_cache=%.1f landmark=%.2f\n", sec[ 0 ] / num_lookups * 1e9, sec[ 1 ] / num_lookups * 1e9 );
+    return  0;
+}
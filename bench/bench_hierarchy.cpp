@@ -0,0 +1,205 @@
+/**
+***  キャラクタアニメーションのための人体モデルの表現・基本処理 ライブラリ・サンプルプログラム
+***  Copyright (c) 2015-, Masaki OSHITA (www.oshita-lab.org)
+***  Released under the MIT license http://opensource.org/licenses/mit-license.php
+**/
+
+/**
+***  スプラットの階層（TrainOptions::build_hierarchy）による最近傍探索・粗い階層を使った生成（GenerateOptions::draft_level）の計測
+***
+***  使い方: bench_hierarchy [num_queries=2000] [copies=1,4,16,64] [num_requests=50] [seed=1]
+***    サンプル動作（app_headless と同じ）を鉛直軸まわりに 360/copies 度ずつ回転した copies 個の動作から
+***    近傍マージなしでモデルを学習し（スプラット数は copies に比例）、ランダムな向き・時刻の姿勢の最近傍スプラットを
+***    線形走査と階層の探索で求めて、1回あたりの探索時間 [us]・FK 距離を計算したスプラット数・読んだ関節位置のバイト数・
+***    線形走査と同じ結果になった割合を出力する。
+***    また、最後のモデルで各階層の代表スプラットのみを使った生成の時間 [ms]・目標の許容距離に入った要求の割合・
+***    最後の姿勢と目標との距離 [m] を出力する。
+**/
+
+#include "SimpleHuman.h"
+#include "HumanBody.h"
+#include "GSModel.h"
+#include "GSModelTest.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace  std;
+
+
+typedef chrono::steady_clock  clock_type;
+
+
+int  main( int argc, char ** argv )
+{
+    int  num_queries = ( argc > 1 ) ? max( 1, atoi( argv[ 1 ] ) ) : 2000;
+    vector< int >  copies_list;
+    const char *  copies_arg = ( argc > 2 ) ? argv[ 2 ] : "1,4,16,64";
+    for ( const char * s = copies_arg; *s; )
+    {
+        copies_list.push_back( max( 1, atoi( s ) ) );
+        const char *  comma = strchr( s, ',' );
+        s = comma ? comma + 1 : s + strlen( s );
+    }
+    int  num_requests = ( argc > 3 ) ? max( 1, atoi( argv[ 3 ] ) ) : 50;
+    unsigned  seed = ( argc > 4 ) ? (unsigned) atoi( argv[ 4 ] ) : 1u;
+
+    // サンプル動作データの読み込み
+    vector< const Motion * >  sample_motions;
+    const HumanBody *  sample_body = NULL;
+    vector< Posture * >  sample_key_poses;
+    LoadSampleMotions( sample_motions, &sample_body, sample_key_poses );
+    if ( sample_motions.empty() || !sample_body )
+    {
+        cerr << "[bench_hierarchy] cannot load sample motions" << endl;
+        return  1;
+    }
+    const Motion *  motion = sample_motions[ 0 ];
+    const Skeleton *  body = sample_body->GetSkeleton();
+    printf( "[bench_hierarchy] queries=%d copies=%s requests=%d seed=%u\n", num_queries, copies_arg, num_requests, seed );
+
+    // 姿勢を鉛直軸まわりに回転
+    Posture  p( body );
+    auto  rotated_pose = [&]( float t, float angle, QPosture & q )
+    {
+        motion->GetPosture( t, p );
+        Matrix3f  yaw, ori = p.root_ori;
+        yaw.rotY( angle );
+        p.root_ori.mul( yaw, ori );
+        q.SetPosture( p );
+    };
+
+    mt19937  rng( seed );
+    uniform_real_distribution< float >  unit( 0.0f, 1.0f );
+    const float  duration = ( motion->num_frames - 1 ) * motion->interval;
+    const int  num_joints = body->num_joints;
+    printf( "copies,splats,levels,clusters,train_s,linear_us,lod_us,speedup,linear_evals,lod_evals,linear_joint_kb,lod_joint_kb,same_result\n" );
+
+    GSModel *  last = NULL;
+    for ( size_t c = 0; c < copies_list.size(); c++ )
+    {
+        // 回転した動作から学習（近傍マージなし）
+        const int  copies = copies_list[ c ];
+        TrainOptions  topt;
+        topt.sample_stride    = 1;
+        topt.occ_sigma_m      = 0.05f;
+        topt.stop_v_threshold = 0.15f;
+        topt.enable_merge     = false;
+        GSModelBuilder  builder( *sample_body, topt );
+        QPosture  q( body );
+        for ( int k = 0; k < copies; k++ )
+        {
+            builder.BeginStream( "rotated", motion->interval );
+            for ( int f = 0; f < motion->num_frames; f++ )
+            {
+                rotated_pose( f * motion->interval, 2.0f * 3.14159265f * k / copies, q );
+                builder.AddFrame( p );
+            }
+            builder.EndStream();
+        }
+        auto  t0 = clock_type::now();
+        GSModel *  model = new GSModel( builder.Build() );
+        double  train_s = chrono::duration< double >( clock_type::now() - t0 ).count();
+        const vector< GaussianSplat > &  splats = model->GetSplats();
+        const int  num_splats = splats.size();
+
+        // ランダムな向き・時刻の姿勢
+        vector< QPosture >  queries( num_queries, QPosture( body ) );
+        for ( int i = 0; i < num_queries; i++ )
+            rotated_pose( unit( rng ) * duration, 2.0f * 3.14159265f * unit( rng ), queries[ i ] );
+
+        // 線形走査（階層がない場合の FindNearestSplat と同じ）
+        FKWorkspace  ws;
+        vector< int >  linear( num_queries );
+        t0 = clock_type::now();
+        for ( int i = 0; i < num_queries; i++ )
+        {
+            float  best_d = numeric_limits< float >::infinity();
+            for ( int s = 0; s < num_splats; s++ )
+            {
+                float  d = model->FKDistance( queries[ i ], splats[ s ].mean_qpose, ws );
+                if ( d < best_d )
+                {
+                    best_d = d;
+                    linear[ i ] = s;
+                }
+            }
+        }
+        double  linear_us = chrono::duration< double, micro >( clock_type::now() - t0 ).count() / num_queries;
+
+        // 階層の探索
+        int  num_same = 0;
+        ws.nearest_evals = 0;
+        t0 = clock_type::now();
+        for ( int i = 0; i < num_queries; i++ )
+            num_same += ( model->FindNearestSplat( queries[ i ], NULL, ws ) == linear[ i ] );
+        double  lod_us = chrono::duration< double, micro >( clock_type::now() - t0 ).count() / num_queries;
+        double  lod_evals = (double) ws.nearest_evals / num_queries;
+
+        // 各階層のクラスタ数
+        int  num_levels = model->GetNumSplatLevels();
+        string  clusters;
+        for ( int k = 0; k < num_levels; k++ )
+            clusters += ( k ? "/" : "" ) + to_string( model->GetNumSplatClusters( k ) );
+        const double  joint_kb = num_joints * 3 * sizeof( float ) / 1024.0;
+        printf( "%d,%d,%d,%s,%.2f,%.2f,%.2f,%.2fx,%d,%.1f,%.1f,%.2f,%.1f%%\n",
+            copies, num_splats, num_levels, clusters.c_str(), train_s, linear_us, lod_us, linear_us / lod_us,
+            num_splats, lod_evals, num_splats * joint_kb, lod_evals * joint_kb, 100.0 * num_same / num_queries );
+
+        delete  last;
+        last = model;
+    }
+
+    // 最後のモデル（copies の最後の値、既定では最も大きいモデル）で、各階層の代表スプラットのみを使った生成（開始・目標は学習した動作のいずれかと同じ向きのランダムな時刻の姿勢）
+    const int  max_copies = copies_list.back();
+    vector< QPosture >  starts( num_requests, QPosture( body ) ), goals( num_requests, QPosture( body ) );
+    for ( int i = 0; i < num_requests; i++ )
+    {
+        float  angle = 2.0f * 3.14159265f * ( rng() % max_copies ) / max_copies;
+        rotated_pose( ( rng() % motion->num_frames ) * motion->interval, angle, starts[ i ] );
+        rotated_pose( ( rng() % motion->num_frames ) * motion->interval, angle, goals[ i ] );
+    }
+    printf( "draft_level,splats,generate_ms_mean,reached,final_dist_mean,nearest_evals_per_query\n" );
+    for ( int level = 0; level < last->GetNumSplatLevels(); level++ )
+    {
+        GenerateOptions  gopt;
+        gopt.draft_level = level;
+        vector< float >  times;
+        vector< QPosture >  poses;
+        FKWorkspace  ws;
+        double  sum_ms = 0.0, sum_dist = 0.0;
+        int  num_reached = 0;
+        for ( int i = 0; i < num_requests; i++ )
+        {
+            GenerateResult  result;
+            auto  t0 = clock_type::now();
+            last->GenerateQ( starts[ i ], goals[ i ], gopt, times, poses, &result );
+            sum_ms += chrono::duration< double, milli >( clock_type::now() - t0 ).count();
+            sum_dist += result.final_dist_goal;
+
+            // 目標の許容距離に入った要求
+            for ( size_t k = 0; k < poses.size(); k++ )
+                if ( last->FKDistance( poses[ k ], goals[ i ], ws ) <= gopt.goal_tolerance_m )
+                {
+                    num_reached++;
+                    break;
+                }
+        }
+
+        // 生成と同じ探索の1回あたりの FK 距離の計算数
+        ws.nearest_evals = 0;
+        for ( int i = 0; i < num_requests; i++ )
+            last->FindNearestSplat( starts[ i ], NULL, ws, level );
+        printf( "%d,%d,%.3f,%.1f%%,%.4f,%.1f\n", level, last->GetNumSplatClusters( level ), sum_ms / num_requests,
+            100.0 * num_reached / num_requests, sum_dist / num_requests, (double) ws.nearest_evals / num_requests );
+    }
+    delete  last;
+    return  0;
+}
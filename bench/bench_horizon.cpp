@@ -0,0 +1,99 @@
+/**
+***  キャラクタアニメーションのための人体モデルの表現・基本処理 ライブラリ・サンプルプログラム
+***  Copyright (c) 2015-, Masaki OSHITA (www.oshita-lab.org)
+***  Released under the MIT license http://opensource.org/licenses/mit-license.php
+**/
+
+/**
+***  スプラットの将来の姿勢（TrainOptions::horizon_steps）による近傍スプラットの探索回数の比較
+***
+***  使い方: bench_horizon [num_requests=200] [seed=1] [horizons=0,2,4,8]
+***    サンプル動作（app_headless と同じ）で horizon_steps を変えて学習したモデルに対して、ランダムな開始・目標姿勢の生成を行い、
+***    生成した動作の１秒あたりの近傍スプラットの探索回数・１要求あたりの生成時間 [ms]・生成した動作の長さ [s]、
+***    目標の許容距離（goal_tolerance_m）に入るまでのステップ数と到達率・最後の姿勢と目標の FK 距離 [m] を出力する。
+**/
+
+#include "SimpleHuman.h"
+#include "HumanBody.h"
+#include "GSModel.h"
+#include "bench_common.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace  std;
+
+
+typedef chrono::steady_clock  clock_type;
+
+
+int  main( int argc, char ** argv )
+{
+    int  num_requests = ( argc > 1 ) ? max( 1, atoi( argv[ 1 ] ) ) : 200;
+    unsigned  seed = ( argc > 2 ) ? (unsigned) atoi( argv[ 2 ] ) : 1u;
+    vector< int >  horizons;
+    stringstream  list( ( argc > 3 ) ? argv[ 3 ] : "0,2,4,8" );
+    string  item;
+    while ( getline( list, item, ',' ) )
+        horizons.push_back( max( 0, atoi( item.c_str() ) ) );
+
+    // サンプル動作データの読み込み
+    BenchSamples  samples;
+    if ( !LoadBenchSamples( "bench_horizon", samples ) )
+        return  1;
+    printf( "[bench_horizon] requests=%d seed=%u\n", num_requests, seed );
+
+    // ランダムな開始・目標姿勢（サンプル動作のフレーム）
+    mt19937  rng( seed );
+    vector< QPosture >  starts, goals;
+    RandomSamplePairs( samples, rng, num_requests, starts, goals );
+
+    printf( "horizon_steps,splats,queries_per_s,queries_per_step,generate_ms_mean,duration_s_mean,steps_to_goal,reached,final_dist_mean\n" );
+    for ( size_t h = 0; h < horizons.size(); h++ )
+    {
+        // 学習（サンプル動作の設定に将来の姿勢の数のみ変更）
+        TrainOptions  topt;
+        SetSampleTrainOptions( topt );
+        topt.horizon_steps    = horizons[ h ];
+        GSModel  model = GSModel::Fit( *samples.body, samples.motions, topt );
+
+        GenerateOptions  gopt;
+        FKWorkspace  ws;
+        vector< float >  times;
+        vector< QPosture >  poses;
+        double  sum_ms = 0.0, sum_seconds = 0.0, sum_steps = 0.0, sum_final = 0.0, sum_reach_steps = 0.0;
+        long long  sum_queries = 0;
+        int  num_reached = 0;
+        for ( int i = 0; i < num_requests; i++ )
+        {
+            GenerateResult  result;
+            auto  t0 = clock_type::now();
+            model.GenerateQ( starts[ i ], goals[ i ], gopt, times, poses, &result );
+            sum_ms += chrono::duration< double, milli >( clock_type::now() - t0 ).count();
+            sum_queries += result.nearest_queries;
+            sum_seconds += times.empty() ? 0.0f : times.back();
+            sum_steps += max( 1, (int) poses.size() - 1 );
+            sum_final += result.final_dist_goal;
+
+            // 目標の許容距離に入るまでのステップ数（到達した要求のみ平均）
+            for ( int k = 0; k < (int) poses.size(); k++ )
+                if ( model.FKDistance( poses[ k ], goals[ i ], ws ) <= gopt.goal_tolerance_m )
+                {
+                    sum_reach_steps += k;
+                    num_reached++;
+                    break;
+                }
+        }
+        printf( "%d,%d,%.2f,%.3f,%.3f,%.3f,%.2f,%.1f%%,%.4f\n", horizons[ h ], (int) model.GetSplats().size(),
+            sum_queries / max( 1e-6, sum_seconds ), sum_queries / sum_steps, sum_ms / num_requests, sum_seconds / num_requests,
+            sum_reach_steps / max( 1, num_reached ), 100.0 * num_reached / num_requests, sum_final / num_requests );
+    }
+    return  0;
+}
@@ -0,0 +1,206 @@
+/**
+***  キャラクタアニメーションのための人体モデルの表現・基本処理 ライブラリ・サンプルプログラム
+***  Copyright (c) 2015-, Masaki OSHITA (www.oshita-lab.org)
+***  Released under the MIT license http://opensource.org/licenses/mit-license.php
+**/
+
+/**
+***  姿勢補間のスループットと精度の計測（SLERP / NLERP / FAST_SLERP の比較）
+***
+***  使い方: bench_interp [src_bvh=motion_rikiya/I25.bvh] [frame_gap=10] [scale=0.025]
+***    src_bvh の f フレーム目と f+frame_gap フレーム目の姿勢を補間し、各方式の姿勢/秒を出力する。
+***    精度は SLERP の結果との関節位置（順運動学）の RMSE・最大誤差 [mm]（scale は BVH の長さ→m）と、
+***    倍精度の球面線形補間との関節回転の角度の最大誤差 [度] で評価する。
+**/
+
+#include "SimpleHuman.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace  std;
+using kh_vecmath::Quat4d;
+
+
+typedef chrono::steady_clock  clock_type;
+
+static const PostureInterpolationMode  modes[] = { POSTURE_INTERP_SLERP, POSTURE_INTERP_NLERP, POSTURE_INTERP_FAST_SLERP };
+static const char *  mode_names[] = { "SLERP", "NLERP", "FAST_SLERP" };
+static const int  num_modes = 3;
+
+
+// 補間の比率（フレームごとに 0.1～0.9 を巡回）
+static float  PairRatio( int f )
+{
+    return  ( ( f * 7 ) % 9 + 1 ) * 0.1f;
+}
+
+
+// 一定時間以上繰り返して１回あたりの秒数を計測（最短の試行を採用）
+template< class F >
+static double  MeasureSeconds( F func, int num_items )
+{
+    double  best = 1e30;
+    for ( int trial = 0; trial < 3; trial++ )
+    {
+        int  reps = 0;
+        auto  t0 = clock_type::now();
+        double  elapsed = 0.0;
+        do
+        {
+            func();
+            reps++;
+            elapsed = chrono::duration< double >( clock_type::now() - t0 ).count();
+        } while ( elapsed < 0.2 );
+        best = min( best, elapsed / reps );
+    }
+    return  best / num_items;
+}
+
+
+// 倍精度の球面線形補間（最短経路）との回転角の差 [度]
+static double  RotationError( const Quat4f & q0, const Quat4f & q1, float ratio, const Quat4f & q )
+{
+    Quat4d  a( q0.x, q0.y, q0.z, q0.w ), b( q1.x, q1.y, q1.z, q1.w ), r( q.x, q.y, q.z, q.w );
+    a.normalize();
+    b.normalize();
+    r.normalize();
+    if ( a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w < 0.0 )
+        b.negate();
+    a.interpolate( b, ratio );
+    double  d = fabs( a.x * r.x + a.y * r.y + a.z * r.z + a.w * r.w );
+    return  2.0 * acos( min( 1.0, d ) ) * 180.0 / M_PI;
+}
+
+
+int  main( int argc, char ** argv )
+{
+    string  src = ( argc > 1 ) ? argv[ 1 ] : "motion_rikiya/I25.bvh";
+    int  gap = ( argc > 2 ) ? atoi( argv[ 2 ] ) : 10;
+    float  scale = ( argc > 3 ) ? (float) atof( argv[ 3 ] ) : 0.025f;
+
+    SetBVHScale( scale );
+    Motion *  motion = LoadAndCoustructBVHMotion( src.c_str() );
+    if ( !motion || ( motion->num_frames <= gap ) || ( gap <= 0 ) )
+    {
+        cerr << "[bench_interp] cannot load " << src << " (or frame_gap is out of range)" << endl;
+        return  1;
+    }
+    const Skeleton *  body = motion->body;
+    int  num_pairs = motion->num_frames - gap;
+    int  num_quats = body->num_joints + 1;
+    printf( "[bench_interp] file=%s frames=%d joints=%d frame_gap=%d\n", src.c_str(), motion->num_frames, body->num_joints, gap );
+
+    // 全フレームを四元数表現に変換
+    vector< QPosture >  qframes( motion->num_frames, QPosture( body ) );
+    for ( int f = 0; f < motion->num_frames; f++ )
+        qframes[ f ].SetPosture( motion->frames[ f ] );
+
+    // 補間する回転の角度の分布（参考）
+    double  sum_angle = 0.0, max_angle = 0.0;
+    for ( int f = 0; f < num_pairs; f++ )
+        for ( int j = 0; j < body->num_joints; j++ )
+        {
+            const Quat4f &  a = qframes[ f ].joint_rotations[ j ];
+            const Quat4f &  b = qframes[ f + gap ].joint_rotations[ j ];
+            double  d = fabs( a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w );
+            double  angle = 2.0 * acos( min( 1.0, d ) ) * 180.0 / M_PI;
+            sum_angle += angle;
+            max_angle = max( max_angle, angle );
+        }
+    printf( "joint_angle_deg mean=%.2f max=%.2f\n", sum_angle / ( num_pairs * body->num_joints ), max_angle );
+
+    // スループット（四元数表現の姿勢・回転行列表現の姿勢の補間）
+    QPosture  qout( body );
+    Posture  pout( body );
+    double  q_sec[ num_modes ], p_sec[ num_modes ];
+    for ( int m = 0; m < num_modes; m++ )
+    {
+        q_sec[ m ] = MeasureSeconds( [&]()
+        {
+            for ( int f = 0; f < num_pairs; f++ )
+                PostureInterpolation( qframes[ f ], qframes[ f + gap ], PairRatio( f ), qout, modes[ m ] );
+        }, num_pairs );
+        p_sec[ m ] = MeasureSeconds( [&]()
+        {
+            for ( int f = 0; f < num_pairs; f++ )
+                PostureInterpolation( motion->frames[ f ], motion->frames[ f + gap ], PairRatio( f ), pout, modes[ m ] );
+        }, num_pairs );
+    }
+
+    // スループット（Quat4f::interpolate と interpolateFast、全関節の回転を１つずつ補間）
+    vector< Quat4f >  q0, q1, qr( num_pairs * num_quats );
+    for ( int f = 0; f < num_pairs; f++ )
+        for ( int j = 0; j < num_quats; j++ )
+        {
+            const QPosture &  a = qframes[ f ];
+            const QPosture &  b = qframes[ f + gap ];
+            Quat4f  qa = ( j < body->num_joints ) ? a.joint_rotations[ j ] : a.root_ori;
+            Quat4f  qb = ( j < body->num_joints ) ? b.joint_rotations[ j ] : b.root_ori;
+            if ( qa.x * qb.x + qa.y * qb.y + qa.z * qb.z + qa.w * qb.w < 0.0f )
+                qb.negate();
+            q0.push_back( qa );
+            q1.push_back( qb );
+        }
+    int  num_q = q0.size();
+    double  slerp_sec = MeasureSeconds( [&]()
+    {
+        for ( int i = 0; i < num_q; i++ )
+            qr[ i ].interpolate( q0[ i ], q1[ i ], PairRatio( i ) );
+    }, num_q );
+    double  fast_sec = MeasureSeconds( [&]()
+    {
+        for ( int i = 0; i < num_q; i++ )
+            qr[ i ].interpolateFast( q0[ i ], q1[ i ], PairRatio( i ) );
+    }, num_q );
+
+    // 精度（SLERP の結果との順運動学の関節位置の差、倍精度の球面線形補間との回転角の差）
+    vector< Matrix4f >  frames_ref, frames_m;
+    vector< Point3f >  pos_ref, pos_m;
+    QPosture  qref( body );
+    double  sq_err[ num_modes ] = { 0.0 }, max_err[ num_modes ] = { 0.0 }, max_rot[ num_modes ] = { 0.0 };
+    for ( int f = 0; f < num_pairs; f++ )
+    {
+        PostureInterpolation( qframes[ f ], qframes[ f + gap ], PairRatio( f ), qref, POSTURE_INTERP_SLERP );
+        ForwardKinematics( qref, frames_ref, pos_ref );
+        for ( int m = 1; m < num_modes; m++ )
+        {
+            PostureInterpolation( qframes[ f ], qframes[ f + gap ], PairRatio( f ), qout, modes[ m ] );
+            ForwardKinematics( qout, frames_m, pos_m );
+            for ( size_t j = 0; j < pos_ref.size(); j++ )
+            {
+                double  e = pos_ref[ j ].distance( pos_m[ j ] );
+                sq_err[ m ] += e * e;
+                max_err[ m ] = max( max_err[ m ], e );
+            }
+        }
+        for ( int m = 0; m < num_modes; m++ )
+        {
+            PostureInterpolation( qframes[ f ], qframes[ f + gap ], PairRatio( f ), qout, modes[ m ] );
+            for ( int j = 0; j < body->num_joints; j++ )
+            {
+                double  e = RotationError( qframes[ f ].joint_rotations[ j ], qframes[ f + gap ].joint_rotations[ j ], PairRatio( f ), qout.joint_rotations[ j ] );
+                max_rot[ m ] = max( max_rot[ m ], e );
+            }
+        }
+    }
+    int  num_points = num_pairs * pos_ref.size();
+
+    printf( "mode,qposture_ns,qposture_speedup,posture_ns,posture_speedup,fk_rmse_mm,fk_max_mm,max_rot_err_deg\n" );
+    for ( int m = 0; m < num_modes; m++ )
+        printf( "%s,%.1f,%.2fx,%.1f,%.2fx,%.4g,%.4g,%.4g\n", mode_names[ m ],
+            q_sec[ m ] * 1e9, q_sec[ 0 ] / q_sec[ m ], p_sec[ m ] * 1e9, p_sec[ 0 ] / p_sec[ m ],
+            sqrt( sq_err[ m ] / num_points ) * 1000.0, max_err[ m ] * 1000.0, max_rot[ m ] );
+    printf( "Quat4f::interpolate=%.2f ns interpolateFast=%.2f ns speedup=%.2fx\n",
+        slerp_sec * 1e9, fast_sec * 1e9, slerp_sec / fast_sec );
+
+    delete  motion->body;
+    delete  motion;
+    return  0;
+}
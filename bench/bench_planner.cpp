@@ -0,0 +1,140 @@
+/**
+***  キャラクタアニメーションのための人体モデルの表現・基本処理 ライブラリ・サンプルプログラム
+***  Copyright (c) 2015-, Masaki OSHITA (www.oshita-lab.org)
+***  Released under the MIT license http://opensource.org/licenses/mit-license.php
+**/
+
+/**
+***  遷移グラフ上の経路計画（GenerateOptions::use_planner）の有無による生成の比較
+***
+***  使い方: bench_planner [num_requests=100] [seed=1] [long_m=0.15]
+***    サンプル動作（app_headless と同じ）で学習したモデルに対して、ランダムな開始・目標姿勢の生成を両方式で行い、
+***    目標の許容距離（goal_tolerance_m）に入るまでのステップ数と到達率・強制前進のステップ数・生成時間 [ms] を出力する。
+***    開始・目標姿勢の FK 距離が long_m 以上の要求（遠い要求）は別に集計する。
+***    また、全スプラットの組の経路計画（A*）の時間をキャッシュなし・キャッシュありで計測する。
+**/
+
+#include "SimpleHuman.h"
+#include "HumanBody.h"
+#include "GSModel.h"
+#include "GSModelController.h"
+#include "bench_common.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace  std;
+
+
+typedef chrono::steady_clock  clock_type;
+
+
+int  main( int argc, char ** argv )
+{
+    int  num_requests = ( argc > 1 ) ? max( 1, atoi( argv[ 1 ] ) ) : 100;
+    unsigned  seed = ( argc > 2 ) ? (unsigned) atoi( argv[ 2 ] ) : 1u;
+    float  long_m = ( argc > 3 ) ? (float) atof( argv[ 3 ] ) : 0.15f;
+
+    // サンプル動作データの読み込み・モデルの学習
+    BenchSamples  samples;
+    if ( !LoadBenchSamples( "bench_planner", samples ) )
+        return  1;
+    GSModel  model = TrainBenchModel( samples );
+    const Skeleton *  body = model.GetHumanBody().GetSkeleton();
+    int  num_splats = model.GetSplats().size();
+    printf( "[bench_planner] splats=%d graph_edges=%d requests=%d seed=%u\n", num_splats, model.GetNumGraphEdges(), num_requests, seed );
+
+    // ランダムな開始・目標姿勢（サンプル動作のフレーム）
+    mt19937  rng( seed );
+    vector< QPosture >  starts, goals;
+    RandomSamplePairs( samples, rng, num_requests, starts, goals );
+
+    // 生成全体の比較（強制前進のステップ数は GSModelController で1ステップずつ進めて数える）
+    GenerateOptions  opts[ 2 ];
+    opts[ 1 ].use_planner = true;
+    const char *  names[ 2 ] = { "greedy", "planner" };
+    GSModelController  controller( model );
+    QPosture  pose( body );
+    FKWorkspace  ws;
+    vector< bool >  is_long( num_requests );
+    int  num_long = 0;
+    for ( int i = 0; i < num_requests; i++ )
+    {
+        is_long[ i ] = ( model.FKDistance( starts[ i ], goals[ i ], ws ) >= long_m );
+        num_long += is_long[ i ];
+    }
+    printf( "long_requests=%d (start-goal >= %.2f m)\n", num_long, long_m );
+    printf( "mode,steps_to_goal,reached,long_steps_to_goal,long_reached,force_steps_mean,plans_mean,generate_ms_mean\n" );
+    for ( int m = 0; m < 2; m++ )
+    {
+        double  sum_steps[ 2 ] = { 0.0, 0.0 }, sum_force = 0.0, sum_ms = 0.0, sum_plans = 0.0;
+        int  num_reached[ 2 ] = { 0, 0 };
+        vector< float >  times;
+        vector< QPosture >  poses;
+        for ( int i = 0; i < num_requests; i++ )
+        {
+            GenerateResult  result;
+            auto  t0 = clock_type::now();
+            model.GenerateQ( starts[ i ], goals[ i ], opts[ m ], times, poses, &result );
+            sum_ms += chrono::duration< double, milli >( clock_type::now() - t0 ).count();
+            sum_plans += result.plans;
+
+            // 目標の許容距離に入るまでのステップ数（到達した要求のみ平均）
+            for ( int k = 0; k < (int) poses.size(); k++ )
+                if ( model.FKDistance( poses[ k ], goals[ i ], ws ) <= opts[ m ].goal_tolerance_m )
+                {
+                    for ( int b = 0; b < 2; b++ )
+                        if ( ( b == 0 ) || is_long[ i ] )
+                        {
+                            sum_steps[ b ] += k;
+                            num_reached[ b ]++;
+                        }
+                    break;
+                }
+
+            controller.Begin( starts[ i ], goals[ i ], opts[ m ] );
+            int  num_rollout_steps = 0;
+            while ( !controller.IsFinished() && controller.Step( pose ) )
+                if ( controller.GetStepCount() > num_rollout_steps )
+                {
+                    num_rollout_steps = controller.GetStepCount();
+                    sum_force += controller.GetStepInfo().force_goal;
+                }
+        }
+        printf( "%s,%.2f,%.1f%%,%.2f,%.1f%%,%.2f,%.2f,%.3f\n", names[ m ],
+            sum_steps[ 0 ] / max( 1, num_reached[ 0 ] ), 100.0 * num_reached[ 0 ] / num_requests,
+            sum_steps[ 1 ] / max( 1, num_reached[ 1 ] ), 100.0 * num_reached[ 1 ] / max( 1, num_long ),
+            sum_force / num_requests, sum_plans / num_requests, sum_ms / num_requests );
+    }
+    long long  hits = 0, misses = 0;
+    model.GetPlanCacheStats( &hits, &misses );
+    printf( "plan_cache hits=%lld misses=%lld hit_rate=%.1f%%\n", hits, misses, 100.0 * hits / max( 1LL, hits + misses ) );
+
+    // 経路計画の時間（全スプラットの組、最初はキャッシュなし・2回目はキャッシュあり）
+    GSModel  cold = TrainBenchModel( samples );
+    vector< int >  path;
+    double  sec[ 2 ];
+    double  sum_len = 0.0;
+    int  num_found = 0;
+    for ( int pass = 0; pass < 2; pass++ )
+    {
+        auto  t0 = clock_type::now();
+        for ( int a = 0; a < num_splats; a++ )
+            for ( int b = 0; b < num_splats; b++ )
+                if ( cold.PlanSplatPath( a, b, path ) && ( pass == 0 ) )
+                {
+                    sum_len += path.size();
+                    num_found++;
+                }
+        sec[ pass ] = chrono::duration< double >( clock_type::now() - t0 ).count();
+    }
+    int  num_pairs = num_splats * num_splats;
+    printf( "plan_us_per_pair cold=%.2f cached=%.3f reachable=%.1f%% path_splats_mean=%.2f\n",
+        sec[ 0 ] / num_pairs * 1e6, sec[ 1 ] / num_pairs * 1e6, 100.0 * num_found / num_pairs, sum_len / max( 1, num_found ) );
+    return  0;
+}
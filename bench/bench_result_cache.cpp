@@ -0,0 +1,154 @@
+/**
+***  キャラクタアニメーションのための人体モデルの表現・基本処理 ライブラリ・サンプルプログラム
+***  Copyright (c) 2015-, Masaki OSHITA (www.oshita-lab.org)
+***  Released under the MIT license http://opensource.org/licenses/mit-license.php
+**/
+
+/**
+***  生成結果のキャッシュ（GSModel::SetResultCache）の計測
+***
+***  使い方: bench_result_cache [num_requests=400] [num_transitions=8] [noise=0.001] [cache_kb=4096] [num_threads=2] [seed=1]
+***    サンプル動作（app_headless と同じ）のフレームから num_transitions 組の開始・目標姿勢を選び、
+***    ルート位置をランダムに平行移動し、関節回転の四元数の各成分に noise 以内の乱数を加えた要求を繰り返す。
+***    キャッシュなし・ありの生成時間 [ms]、ヒット率・参照時間 [us]・メモリ使用量と、
+***    キャッシュから得た結果とその要求を実際に生成した結果の差（関節位置の FK 距離・ルート位置 [m]）を出力する。
+***    キャッシュありの生成は num_threads 個のスレッドで並行に行う。
+**/
+
+#include "SimpleHuman.h"
+#include "HumanBody.h"
+#include "GSModel.h"
+#include "bench_common.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace  std;
+
+
+typedef chrono::steady_clock  clock_type;
+
+
+int  main( int argc, char ** argv )
+{
+    int  num_requests = ( argc > 1 ) ? max( 1, atoi( argv[ 1 ] ) ) : 400;
+    int  num_transitions = ( argc > 2 ) ? max( 1, atoi( argv[ 2 ] ) ) : 8;
+    float  noise = ( argc > 3 ) ? (float) atof( argv[ 3 ] ) : 0.001f;
+    int  cache_kb = ( argc > 4 ) ? atoi( argv[ 4 ] ) : 4096;
+    int  num_threads = ( argc > 5 ) ? max( 1, atoi( argv[ 5 ] ) ) : 2;
+    unsigned  seed = ( argc > 6 ) ? (unsigned) atoi( argv[ 6 ] ) : 1u;
+
+    // サンプル動作データの読み込み・モデルの学習
+    BenchSamples  samples;
+    if ( !LoadBenchSamples( "bench_result_cache", samples ) )
+        return  1;
+    GSModel  model = TrainBenchModel( samples );
+    GSModel  cached = model;
+    GenerateCacheOptions  copt;
+    copt.max_bytes = (size_t) cache_kb * 1024;
+    cached.SetResultCache( copt );
+    const Skeleton *  body = model.GetHumanBody().GetSkeleton();
+    printf( "[bench_result_cache] splats=%d requests=%d transitions=%d noise=%g cache_kb=%d threads=%d seed=%u\n",
+        (int) model.GetSplats().size(), num_requests, num_transitions, noise, cache_kb, num_threads, seed );
+
+    // 開始・目標姿勢の組（サンプル動作のフレーム）と、それを平行移動・関節回転に乱数を加えた要求
+    mt19937  rng( seed );
+    uniform_real_distribution< float >  offset( -1.0f, 1.0f ), jitter( -noise, noise );
+    Posture  p( body );
+    vector< QPosture >  base( 2 * num_transitions, QPosture( body ) );
+    for ( int i = 0; i < 2 * num_transitions; i++ )
+    {
+        RandomSamplePose( samples, rng, base[ i ] );
+    }
+    vector< QPosture >  starts( num_requests, QPosture( body ) ), goals( num_requests, QPosture( body ) );
+    for ( int i = 0; i < num_requests; i++ )
+    {
+        int  t = rng() % num_transitions;
+        Vector3f  move( offset( rng ), 0.0f, offset( rng ) );
+        for ( int k = 0; k < 2; k++ )
+        {
+            QPosture &  q = ( k == 0 ) ? starts[ i ] : goals[ i ];
+            q = base[ 2 * t + k ];
+            q.root_pos.add( move );
+            for ( int j = 0; j < body->num_joints; j++ )
+            {
+                Quat4f &  r = q.joint_rotations[ j ];
+                r.set( r.x + jitter( rng ), r.y + jitter( rng ), r.z + jitter( rng ), r.w + jitter( rng ) );
+                r.normalize();
+            }
+        }
+    }
+
+    // キャッシュなし
+    GenerateOptions  gopt;
+    vector< vector< float > >  times[ 2 ];
+    vector< vector< QPosture > >  poses[ 2 ];
+    vector< bool >  is_hit( num_requests );
+    for ( int m = 0; m < 2; m++ )
+    {
+        times[ m ].resize( num_requests );
+        poses[ m ].resize( num_requests );
+    }
+    auto  t0 = clock_type::now();
+    for ( int i = 0; i < num_requests; i++ )
+        model.GenerateQ( starts[ i ], goals[ i ], gopt, times[ 0 ][ i ], poses[ 0 ][ i ] );
+    double  plain_ms = chrono::duration< double, milli >( clock_type::now() - t0 ).count();
+
+    // キャッシュあり（複数スレッドで並行に要求を処理）
+    atomic< int >  next( 0 );
+    auto  worker = [&]()
+    {
+        int  i;
+        while ( ( i = next.fetch_add( 1 ) ) < num_requests )
+        {
+            GenerateResult  result;
+            cached.GenerateQ( starts[ i ], goals[ i ], gopt, times[ 1 ][ i ], poses[ 1 ][ i ], &result );
+            is_hit[ i ] = result.cache_hit;
+        }
+    };
+    t0 = clock_type::now();
+    vector< thread >  threads;
+    for ( int t = 1; t < num_threads; t++ )
+        threads.push_back( thread( worker ) );
+    worker();
+    for ( size_t t = 0; t < threads.size(); t++ )
+        threads[ t ].join();
+    double  cached_ms = chrono::duration< double, milli >( clock_type::now() - t0 ).count();
+
+    // キャッシュから得た結果と実際に生成した結果の差
+    FKWorkspace  ws;
+    int  num_length_mismatch = 0, num_hits = 0;
+    float  max_fk = 0.0f, max_root = 0.0f;
+    for ( int i = 0; i < num_requests; i++ )
+    {
+        if ( !is_hit[ i ] )
+            continue;
+        num_hits++;
+        const vector< QPosture > &  a = poses[ 0 ][ i ];
+        const vector< QPosture > &  b = poses[ 1 ][ i ];
+        if ( a.size() != b.size() )
+            num_length_mismatch++;
+        for ( size_t k = 0; k < min( a.size(), b.size() ); k++ )
+        {
+            max_fk = max( max_fk, model.FKDistance( a[ k ], b[ k ], ws ) );
+            max_root = max( max_root, a[ k ].root_pos.distance( b[ k ].root_pos ) );
+        }
+    }
+
+    GenerateCacheStats  stats = cached.GetResultCacheStats();
+    printf( "generate_ms_per_request no_cache=%.3f cache=%.3f speedup=%.2fx\n",
+        plain_ms / num_requests, cached_ms / num_requests, plain_ms / cached_ms );
+    printf( "cache lookups=%lld hits=%lld hit_rate=%.1f%% entries=%d bytes=%d evictions=%lld\n",
+        stats.lookups, stats.hits, 100.0 * stats.hits / max( 1LL, stats.lookups ), (int) stats.entries, (int) stats.bytes, stats.evictions );
+    printf( "lookup_us hit_mean=%.2f hit_max=%.2f miss_mean=%.2f\n", stats.hit_us_mean, stats.hit_us_max, stats.miss_us_mean );
+    printf( "hit_vs_generated hits=%d length_mismatch=%d max_fk_diff_m=%g max_root_diff_m=%g\n",
+        num_hits, num_length_mismatch, max_fk, max_root );
+    return  0;
+}
@@ -22,6 +22,10 @@
 #include <AxisAngle4_.h>
 #include <Quat4_.h>
 
+#ifdef VM_USE_SSE
+#include <immintrin.h>
+#endif
+
 VM_BEGIN_NS
 
 template<class T>
@@ -839,6 +843,42 @@ VM_STRING_STD::string Matrix3<T>::toString() const {
 }
 #endif /* VM_INCLUDE_TOSTRING */
 
+#ifdef VM_USE_SSE
+/*
+ * SSE specialization for float.
+ * each element is summed in the same order as the generic version
+ * (no fused multiply-add).  the rows are 3 elements wide, so the last
+ * row of m2 is loaded together with m12 to stay inside the matrix.
+ * the result is written back with set() (see Matrix4<float>::mul).
+ */
+template<>
+inline void Matrix3<float>::mul(const Matrix3<float>& m1, const Matrix3<float>& m2) {
+    // alias-safe: both matrices are read before set().
+    __m128 b0 = _mm_loadu_ps(&m2.m00);                      // m00 m01 m02 (m10)
+    __m128 b1 = _mm_loadu_ps(&m2.m10);                      // m10 m11 m12 (m20)
+    __m128 b2 = _mm_loadu_ps(&m2.m12);                      // (m12) m20 m21 m22
+    b2 = _mm_shuffle_ps(b2, b2, _MM_SHUFFLE(3, 3, 2, 1));   // m20 m21 m22 (m22)
+
+    __m128 r0 = _mm_mul_ps(_mm_set1_ps(m1.m00), b0);
+    r0 = _mm_add_ps(r0, _mm_mul_ps(_mm_set1_ps(m1.m01), b1));
+    r0 = _mm_add_ps(r0, _mm_mul_ps(_mm_set1_ps(m1.m02), b2));
+    __m128 r1 = _mm_mul_ps(_mm_set1_ps(m1.m10), b0);
+    r1 = _mm_add_ps(r1, _mm_mul_ps(_mm_set1_ps(m1.m11), b1));
+    r1 = _mm_add_ps(r1, _mm_mul_ps(_mm_set1_ps(m1.m12), b2));
+    __m128 r2 = _mm_mul_ps(_mm_set1_ps(m1.m20), b0);
+    r2 = _mm_add_ps(r2, _mm_mul_ps(_mm_set1_ps(m1.m21), b1));
+    r2 = _mm_add_ps(r2, _mm_mul_ps(_mm_set1_ps(m1.m22), b2));
+
+    float r[12];
+    _mm_storeu_ps(r, r0);
+    _mm_storeu_ps(r + 4, r1);
+    _mm_storeu_ps(r + 8, r2);
+    set(r[0], r[1], r[2],
+        r[4], r[5], r[6],
+        r[8], r[9], r[10]);
+}
+#endif /* VM_USE_SSE */
+
 VM_END_NS
 
 #ifdef VM_INCLUDE_IO
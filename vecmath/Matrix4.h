@@ -23,6 +23,10 @@
 #include <Matrix4_.h>
 #include <Matrix3.h>   // not very good. use template export later
 
+#ifdef VM_USE_SSE
+#include <immintrin.h>
+#endif
+
 VM_BEGIN_NS
 
 template<class T>
@@ -1210,6 +1214,54 @@ VM_STRING_STD::string Matrix4<T>::toString() const {
 }
 #endif /* VM_INCLUDE_TOSTRING */
 
+#ifdef VM_USE_SSE
+/*
+ * SSE specializations for float.
+ * each element is summed in the same order as the generic version
+ * (no fused multiply-add).  the operands are gathered with scalar loads
+ * and the result is written back with set(), because the callers (FK)
+ * usually have just updated a few elements as scalars; a 16 byte load
+ * right after such a store stalls store forwarding.
+ */
+template<>
+inline void Matrix4<float>::mul(const Matrix4<float>& m1, const Matrix4<float>& m2) {
+    // alias-safe: both matrices are read before set().
+    // row i of the result = m1(i,0)*row0(m2) + m1(i,1)*row1(m2) + m1(i,2)*row2(m2) + m1(i,3)*row3(m2)
+    __m128 b0 = _mm_setr_ps(m2.m00, m2.m01, m2.m02, m2.m03);
+    __m128 b1 = _mm_setr_ps(m2.m10, m2.m11, m2.m12, m2.m13);
+    __m128 b2 = _mm_setr_ps(m2.m20, m2.m21, m2.m22, m2.m23);
+    __m128 b3 = _mm_setr_ps(m2.m30, m2.m31, m2.m32, m2.m33);
+    const float* a = &m1.m00;
+    float r[16];
+    for (unsigned i = 0; i < 4; i++) {
+        __m128 ri = _mm_mul_ps(_mm_set1_ps(a[4*i]), b0);
+        ri = _mm_add_ps(ri, _mm_mul_ps(_mm_set1_ps(a[4*i + 1]), b1));
+        ri = _mm_add_ps(ri, _mm_mul_ps(_mm_set1_ps(a[4*i + 2]), b2));
+        ri = _mm_add_ps(ri, _mm_mul_ps(_mm_set1_ps(a[4*i + 3]), b3));
+        _mm_storeu_ps(r + 4*i, ri);
+    }
+    set(r[0], r[1], r[2], r[3],
+        r[4], r[5], r[6], r[7],
+        r[8], r[9], r[10], r[11],
+        r[12], r[13], r[14], r[15]);
+}
+
+template<>
+inline void Matrix4<float>::transform(const Vector3<float>& normal, Vector3<float>* normalOut) const {
+    // alias-safe: normal is read before normalOut is written.
+    // result = x*column0 + y*column1 + z*column2 (upper 3x3)
+    __m128 c0 = _mm_setr_ps(m00, m10, m20, 0.0f);
+    __m128 c1 = _mm_setr_ps(m01, m11, m21, 0.0f);
+    __m128 c2 = _mm_setr_ps(m02, m12, m22, 0.0f);
+    __m128 r = _mm_mul_ps(c0, _mm_set1_ps(normal.x));
+    r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(normal.y)));
+    r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(normal.z)));
+    normalOut->x = _mm_cvtss_f32(r);
+    normalOut->y = _mm_cvtss_f32(_mm_shuffle_ps(r, r, 0x55));
+    normalOut->z = _mm_cvtss_f32(_mm_shuffle_ps(r, r, 0xaa));
+}
+#endif /* VM_USE_SSE */
+
 VM_END_NS
 
 #ifdef VM_INCLUDE_IO
@@ -21,6 +21,10 @@
 #include <Quat4_.h>
 #include <AxisAngle4_.h>
 
+#ifdef VM_USE_SSE
+#include <immintrin.h>
+#endif
+
 VM_BEGIN_NS
 
 template<class T>
@@ -154,6 +158,63 @@ void Quat4<T>::interpolate(const Quat4& q1, const Quat4& q2, T alpha) {
 }
 
 
+template<class T>
+void Quat4<T>::interpolateFastWeights(T cos_t, T alpha, T* s0, T* s1) {
+	// From D. Eberly, "A Fast and Accurate Algorithm for Computing SLERP".
+	// sin(alpha*t)/sin(t) is expanded in powers of (cos_t - 1) and the
+	// series is truncated at 8 terms; the last term is scaled by mu to
+	// minimize the maximum error over 0 <= cos_t <= 1.
+	const T mu = T(1.85298109240830);
+	const T u[8] = { T(1)/T(1*3), T(1)/T(2*5), T(1)/T(3*7), T(1)/T(4*9),
+	                 T(1)/T(5*11), T(1)/T(6*13), T(1)/T(7*15), mu/T(8*17) };
+	const T v[8] = { T(1)/T(3), T(2)/T(5), T(3)/T(7), T(4)/T(9),
+	                 T(5)/T(11), T(6)/T(13), T(7)/T(15), mu*T(8)/T(17) };
+
+	T xm1 = cos_t - 1;
+	T a0 = 1 - alpha;
+	T a1 = alpha;
+	T sq0 = a0*a0;
+	T sq1 = a1*a1;
+	T b0 = 1;
+	T b1 = 1;
+	for (int i = 7; i >= 0; i--) {
+	    b0 = 1 + (u[i]*sq0 - v[i])*xm1*b0;
+	    b1 = 1 + (u[i]*sq1 - v[i])*xm1*b1;
+	}
+	*s0 = a0*b0;
+	*s1 = a1*b1;
+}
+
+template<class T>
+void Quat4<T>::interpolateFast(const Quat4& q1, T alpha) {
+	// t is cosine (dot product)
+	T t = x*q1.x + y*q1.y + z*q1.z + w*q1.w;
+
+	// the approximation is valid for 0 <= t <= 1 only
+	if (t < 0.0) {
+	    interpolate(q1, alpha);
+	    return;
+	}
+	if (t > 1.0)
+	    t = 1.0;
+
+	T s, s1;
+	interpolateFastWeights(t, alpha, &s, &s1);
+
+	// set values
+	x = s*x + s1*q1.x;
+	y = s*y + s1*q1.y;
+	z = s*z + s1*q1.z;
+	w = s*w + s1*q1.w;
+}
+
+template<class T>
+void Quat4<T>::interpolateFast(const Quat4& q1, const Quat4& q2, T alpha) {
+    set(q1);
+    interpolateFast(q2, alpha);
+}
+
+
 template<class T>
 void Quat4<T>::setFromMat(T m00, T m01, T m02,
                           T m10, T m11, T m12,
@@ -208,6 +269,56 @@ Quat4<T> Quat4<T>::operator*(const Quat4& m1) const {
     return (Quat4(*this)).operator*=(m1);
 }
 
+#ifdef VM_USE_SSE
+/*
+ * SSE specialization for float.
+ * the same cases as setFromMat (Ken Shoemake), but the off-diagonal
+ * sums/differences are computed together and everything stays in
+ * float instead of going through double.
+ */
+template<>
+inline void Quat4<float>::set(const Matrix3<float>& m1) {
+    // d = p - q = (m21-m12, m02-m20, m10-m01), a = p + q = (m21+m12, m02+m20, m10+m01)
+    // each case picks (x, y, z, w) from d and a, then overwrites the diagonal term.
+    __m128 p = _mm_set_ps(0.0f, m1.m10, m1.m02, m1.m21);
+    __m128 q = _mm_set_ps(0.0f, m1.m01, m1.m20, m1.m12);
+    __m128 d = _mm_sub_ps(p, q);
+    __m128 a = _mm_add_ps(p, q);
+
+    float tr = m1.m00 + m1.m11 + m1.m22;
+    float s;
+    __m128 r;
+    unsigned diag;
+    if (tr >= 0.0f) {
+        // (d0, d1, d2, -) -> (x, y, z), w is the diagonal term
+        s = VmUtil<float>::sqrt(tr + 1.0f);
+        r = d;
+        diag = 3;
+    } else {
+        float maxm = VmUtil<float>::max(m1.m00, m1.m11, m1.m22);
+        if (maxm == m1.m00) {
+            // (-, a2, a1, d0) -> (x, y, z, w)
+            s = VmUtil<float>::sqrt(m1.m00 - (m1.m11 + m1.m22) + 1.0f);
+            r = _mm_shuffle_ps(a, _mm_unpacklo_ps(a, d), _MM_SHUFFLE(1, 2, 2, 0));
+            diag = 0;
+        } else if (maxm == m1.m11) {
+            // (a2, -, a0, d1)
+            s = VmUtil<float>::sqrt(m1.m11 - (m1.m22 + m1.m00) + 1.0f);
+            r = _mm_shuffle_ps(a, _mm_unpacklo_ps(a, d), _MM_SHUFFLE(3, 0, 2, 2));
+            diag = 1;
+        } else {
+            // (a1, a0, -, d2)
+            s = VmUtil<float>::sqrt(m1.m22 - (m1.m00 + m1.m11) + 1.0f);
+            r = _mm_shuffle_ps(a, _mm_unpackhi_ps(a, d), _MM_SHUFFLE(1, 0, 0, 1));
+            diag = 2;
+        }
+    }
+    r = _mm_mul_ps(r, _mm_set1_ps(0.5f/s));
+    _mm_storeu_ps(&x, r);
+    (&x)[diag] = s*0.5f;
+}
+#endif /* VM_USE_SSE */
+
 VM_END_NS
 
 #ifdef VM_INCLUDE_IO
@@ -319,6 +319,39 @@ public:
       */
     void interpolate(const Quat4& q1, const Quat4& q2, T alpha);
 
+    /**
+      * Approximates interpolate(q1, alpha) without acos/sin, using the
+      * polynomial slerp of D. Eberly ("A Fast and Accurate Algorithm for
+      * Computing SLERP"). Both quaternions must be normalized.
+      * For float, the maximum error of the rotation angle is 1.0e-3 degrees
+      * (over rotations up to 180 degrees, 6.5e-6 degrees up to 90 degrees)
+      * and the norm of the result deviates from 1 by at most 3.0e-5.
+      * If the dot product is negative, falls back to interpolate so that
+      * the same great circle arc is followed.
+      * @param q1 the other quaternion
+      * @param alpha the alpha interpolation parameter
+      */
+    void interpolateFast(const Quat4& q1, T alpha);
+
+    /**
+      * Approximates interpolate(q1, q2, alpha), see interpolateFast(q1, alpha).
+      * @param q1 the first quaternion
+      * @param q2 the second quaternion
+      * @param alpha the alpha interpolation parameter
+      */
+    void interpolateFast(const Quat4& q1, const Quat4& q2, T alpha);
+
+    /**
+      * Computes the weights of interpolateFast, the result is
+      * s0*q0 + s1*q1 where cos_t is the dot product of q0 and q1.
+      * Branch-free, so loops over arrays can be vectorized.
+      * @param cos_t the dot product of the quaternions (0 <= cos_t <= 1)
+      * @param alpha the alpha interpolation parameter
+      * @param s0 the weight of the first quaternion
+      * @param s1 the weight of the second quaternion
+      */
+    static void interpolateFastWeights(T cos_t, T alpha, T* s0, T* s1);
+
     // copy constructor and operator = is made by complier
 
     Quat4& operator*=(const Quat4& m1);
@@ -15,12 +15,28 @@
    purpose.  It is provided "AS IS" with NO WARRANTY.
 */
 #include "Matrix3.h"
+#include <cstdlib>
+#include <cstring>
 
 template<class T, class S>
 bool equals(T a, S b) {
     return fabs(a - b) < 1.0e-5;
 }
 
+/*
+ * a and b are within a few ulps (or both tiny).
+ */
+bool ulpEquals(float a, float b, int ulps = 4) {
+    if (fabs(a - b) < 1.0e-6)
+        return true;
+    int ia, ib;
+    memcpy(&ia, &a, sizeof(ia));
+    memcpy(&ib, &b, sizeof(ib));
+    if ((ia < 0) != (ib < 0))
+        return false;
+    return abs(ia - ib) <= ulps;
+}
+
 #ifdef VM_INCLUDE_NAMESPACE
 using namespace kh_vecmath;
 #endif
@@ -186,6 +202,43 @@ void f(T) {
 
 }
 
+/**
+ * Matrix3f::mul (SSE specialization when VM_USE_SSE is defined)
+ * against the scalar formula, including aliased arguments.
+ */
+void simdTest() {
+    srand(8);
+    for (unsigned n = 0; n < 1000; n++) {
+        Matrix3f a, b;
+        for (unsigned i = 0; i < 3; i++)
+            for (unsigned j = 0; j < 3; j++) {
+                a.setElement(i, j, rand()/(float)RAND_MAX*4.0f - 2.0f);
+                b.setElement(i, j, rand()/(float)RAND_MAX*4.0f - 2.0f);
+            }
+
+        Matrix3f c;
+        c.mul(a, b);
+        for (unsigned i = 0; i < 3; i++)
+            for (unsigned j = 0; j < 3; j++) {
+                float e = a.getElement(i,0)*b.getElement(0,j);
+                e += a.getElement(i,1)*b.getElement(1,j);
+                e += a.getElement(i,2)*b.getElement(2,j);
+                assert(ulpEquals(c.getElement(i,j), e));
+            }
+
+        Matrix3f d(a);
+        d.mul(d, b);
+        assert(d == c);
+        d = b;
+        d.mul(a, d);
+        assert(d == c);
+        d = a;
+        d.mul(d, d);
+        c.mul(a, a);
+        assert(d == c);
+    }
+}
+
 /**
  * test for Matrix3
  */
@@ -196,6 +249,7 @@ int main(int, char**) {
 #endif
     f(1.0);
     f(1.0f);
+    simdTest();
     return 0;
 }
 
@@ -15,12 +15,32 @@
    purpose.  It is provided "AS IS" with NO WARRANTY.
 */
 #include "Matrix4.h"
+#include <cstdlib>
+#include <cstring>
 
 template<class T, class S>
 bool equals(T a, S b) {
     return fabs(a - b) < 1.0e-5;
 }
 
+/*
+ * a and b are within a few ulps (or both tiny).
+ */
+bool ulpEquals(float a, float b, int ulps = 4) {
+    if (fabs(a - b) < 1.0e-6)
+        return true;
+    int ia, ib;
+    memcpy(&ia, &a, sizeof(ia));
+    memcpy(&ib, &b, sizeof(ib));
+    if ((ia < 0) != (ib < 0))
+        return false;
+    return abs(ia - ib) <= ulps;
+}
+
+float random(float range) {
+    return rand()/(float)RAND_MAX*2.0f*range - range;
+}
+
 #ifdef VM_INCLUDE_NAMESPACE
 using namespace kh_vecmath;
 #endif
@@ -202,6 +222,113 @@ void f(T) {
 
 }
 
+/**
+ * Matrix4f::mul, Matrix4f::transform(Vector3f*) and Quat4f::set(Matrix3f)
+ * (SSE/AVX specializations when VM_USE_SSE is defined) against the
+ * scalar formulas and the double templates.
+ */
+void simdTest() {
+    srand(9);
+    for (unsigned n = 0; n < 1000; n++) {
+        Matrix4f a, b;
+        for (unsigned i = 0; i < 4; i++)
+            for (unsigned j = 0; j < 4; j++) {
+                a.setElement(i, j, random(2.0f));
+                b.setElement(i, j, random(2.0f));
+            }
+
+        // mul
+        Matrix4f c;
+        c.mul(a, b);
+        for (unsigned i = 0; i < 4; i++)
+            for (unsigned j = 0; j < 4; j++) {
+                float e = a.getElement(i,0)*b.getElement(0,j);
+                e += a.getElement(i,1)*b.getElement(1,j);
+                e += a.getElement(i,2)*b.getElement(2,j);
+                e += a.getElement(i,3)*b.getElement(3,j);
+                assert(ulpEquals(c.getElement(i,j), e));
+            }
+        Matrix4f d(a);
+        d.mul(d, b);
+        assert(d == c);
+        d = b;
+        d.mul(a, d);
+        assert(d == c);
+
+        // transform (normal)
+        Vector3f v(random(2.0f), random(2.0f), random(2.0f));
+        Vector3f w(v);
+        a.transform(&w);
+        for (unsigned i = 0; i < 3; i++) {
+            float e = a.getElement(i,0)*v.x;
+            e += a.getElement(i,1)*v.y;
+            e += a.getElement(i,2)*v.z;
+            assert(ulpEquals(i == 0 ? w.x : i == 1 ? w.y : w.z, e));
+        }
+
+        // quaternion from rotation matrix. every 4th rotation is close to
+        // 180 degrees around x, y or z so that all the cases are used.
+        AxisAngle4d aa(random(1.0f), random(1.0f), random(1.0f), random(M_PI));
+        if (n % 4 != 0) {
+            aa.x = aa.y = aa.z = 0.1;
+            (n % 4 == 1 ? aa.x : n % 4 == 2 ? aa.y : aa.z) = 1.0;
+            aa.angle = M_PI - 0.1*random(1.0f);
+        }
+        Matrix3d md;
+        md.set(aa);
+        Matrix3f mf((float)md.m00, (float)md.m01, (float)md.m02,
+                    (float)md.m10, (float)md.m11, (float)md.m12,
+                    (float)md.m20, (float)md.m21, (float)md.m22);
+        Quat4d qd;
+        Quat4f qf;
+        qd.set(md);
+        qf.set(mf);
+        // the sign may differ when the case selection flips at a boundary.
+        float sign = (qd.x*qf.x + qd.y*qf.y + qd.z*qf.z + qd.w*qf.w < 0) ? -1.0f : 1.0f;
+        assert(equals(sign*qf.x, qd.x));
+        assert(equals(sign*qf.y, qd.y));
+        assert(equals(sign*qf.z, qd.z));
+        assert(equals(sign*qf.w, qd.w));
+    }
+}
+
+/**
+ * Quat4::interpolateFast against interpolate in double. The rotation
+ * angle error must be within the documented bound (1.0e-3 degrees).
+ */
+void interpolateFastTest() {
+    srand(37);
+    for (unsigned n = 0; n < 10000; n++) {
+        AxisAngle4d a0(random(1.0f), random(1.0f), random(1.0f), random(M_PI));
+        AxisAngle4d a1(random(1.0f), random(1.0f), random(1.0f), random(M_PI));
+        Quat4d q0, q1;
+        q0.set(a0);
+        q1.set(a1);
+        if (q0.x*q1.x + q0.y*q1.y + q0.z*q1.z + q0.w*q1.w < 0)
+            q1.negate();
+        double alpha = (n % 10 == 0) ? 0.21 : (random(0.5f) + 0.5f);
+
+        Quat4d qd;
+        qd.interpolate(q0, q1, alpha);
+        Quat4f f0((float)q0.x, (float)q0.y, (float)q0.z, (float)q0.w);
+        Quat4f f1((float)q1.x, (float)q1.y, (float)q1.z, (float)q1.w);
+        Quat4f qf;
+        qf.interpolateFast(f0, f1, (float)alpha);
+        double len = sqrt(qf.x*(double)qf.x + qf.y*(double)qf.y + qf.z*(double)qf.z + qf.w*(double)qf.w);
+        assert(fabs(len - 1.0) < 4.0e-5);
+        double d = (qd.x*qf.x + qd.y*qf.y + qd.z*qf.z + qd.w*qf.w)/len;
+        double angle = 2.0*acos(d < 1.0 ? d : 1.0)*180.0/M_PI;
+        assert(angle < 1.0e-3);
+
+        // negative dot product: same arc as interpolate
+        f1.negate();
+        qf.interpolateFast(f0, f1, (float)alpha);
+        Quat4f qs;
+        qs.interpolate(f0, f1, (float)alpha);
+        assert(qf == qs);
+    }
+}
+
 /**
  * test for Matrix3
  */
@@ -212,6 +339,8 @@ int main(int, char**) {
 #endif
     f(1.0);
     f(1.0f);
+    simdTest();
+    interpolateFastTest();
     return 0;
 }
 
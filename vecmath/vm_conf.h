@@ -73,6 +73,15 @@
  */
 //#define VM_USE_OLDIOSTREAM
 
+/*
+ * uses SSE versions of Matrix4f::mul, Matrix4f::transform(Vector3f*),
+ * Matrix3f::mul and Quat4f::set(Matrix3f) (VEX encoded when compiling
+ * for AVX).  selected at compile time by the target instruction set;
+ * the double templates are not affected.
+ * define this to always use the generic templates.
+ */
+//#define VM_NO_SIMD
+
 
 /* -----------------------------------------------------------
  *   end user customization section 
@@ -104,6 +113,11 @@
 #  endif
 #endif
 
+// SSE is used when the compiler targets SSE2 (always true on x86-64).
+#if !defined(VM_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#  define VM_USE_SSE
+#endif
+
 #ifdef VM_INCLUDE_NAMESPACE
 #  define VM_VECMATH_NS  kh_vecmath
 #  define VM_BEGIN_NS namespace kh_vecmath {